@@ -24,7 +24,9 @@
 #ifndef VEBTREES_H
 #define VEBTREES_H
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
@@ -45,9 +47,30 @@ typedef uint64_t vebkey_t;
  */
 #define vebtree_null 0xFFFFFFFFFFFFFFFF
 
+/**
+ * @brief The universe bits managed by a single bitwise tree leaf, needs to be within [6, 9].
+ * Leafs greater than 64 bits consist of multiple 64-bit words that are scanned with
+ * AVX2 / AVX-512 instructions when available (e.g. -march=native), scalar code otherwise.
+ * Override it by defining VEBTREE_LEAF_BITS before including this header.
+ */
+#ifndef VEBTREE_LEAF_BITS
+#define VEBTREE_LEAF_BITS 6
+#endif
+
+#if VEBTREE_LEAF_BITS < 6 || VEBTREE_LEAF_BITS > 9
+#error "VEBTREE_LEAF_BITS needs to be within [6, 9]"
+#endif
+
+/**
+ * @brief The amount of 64-bit words making up a bitwise tree leaf.
+ */
+#define VEBTREE_LEAF_WORDS (1 << (VEBTREE_LEAF_BITS - 6))
+
 /**
  * @brief Van Emde Boas tree structure representing a tree with its
- * local child nodes, global registry and high / low pointers.
+ * local child nodes, global registry and high / low pointers. The global
+ * is allocated right in front of the locals array, so a single reference
+ * suffices for both and each node takes 32 bytes (for 64-bit leafs).
  */
 typedef struct _VEB_TREE_NODE {
     uint8_t universe_bits;
@@ -58,18 +81,129 @@ typedef struct _VEB_TREE_NODE {
     /**< The universe bits managed by the global subtree. */
     uint8_t flags;
     /**< A collection of flags adjusting the tree's behavior. */
-    vebkey_t low;
-    /**< The low pointer representing the smallest key inserted into the tree.
-         Note that the low pointer is by definition not inserted into any subtree.
-         Moreover, the bitwise tree leafs use the low pointer as bitboards. */
-    vebkey_t high;
-    /**< The high pointer representing the greatest key inserted into the tree. */
-    struct _VEB_TREE_NODE* global;
-    /**< The pointer reference to the global subtree. */
-    struct _VEB_TREE_NODE* locals;
-    /**< The pointer reference to the local subtrees array. */
+    uint8_t table_bits;
+    /**< The log2 of the slots of the locals' hash table (sparse nodes only). */
+    uint8_t allocator;
+    /**< The slot of the VebAllocator providing the node's subtrees, 0 for malloc() / free(). */
+#ifdef VEBTREE_STATS
+    uint8_t is_root;
+    /**< Whether the node is a tree root followed by its VebTreeStats (VEBTREE_STATS builds only). */
+#endif
+    union {
+        struct {
+            vebkey_t low;
+            /**< The low pointer representing the smallest key inserted into the tree.
+                 Note that the low pointer is by definition not inserted into any subtree.
+                 Moreover, the bitwise tree leafs use the low pointer as bitboards. */
+            vebkey_t high;
+            /**< The high pointer representing the greatest key inserted into the tree. */
+            union {
+                struct _VEB_TREE_NODE* locals;
+                /**< The pointer reference to the local subtrees array, preceded by the global subtree. */
+                int64_t locals_offset;
+                /**< The locals' byte offset relative to the node (mapped trees only). */
+            };
+        };
+        uint64_t leaf[VEBTREE_LEAF_WORDS];
+        /**< The bitboard words of bitwise tree leafs, starting at the low pointer.
+             Leafs of more than 64 bits overlay the remaining node fields. */
+    };
 } VebTree;
 
+#ifdef VEBTREE_STATS
+
+/**
+ * @brief The operations tracked by trees of VEBTREE_STATS builds, indexing the VebTreeStats arrays.
+ */
+#define VEBTREE_OP_CONTAINS 0
+#define VEBTREE_OP_INSERT 1
+#define VEBTREE_OP_DELETE 2
+#define VEBTREE_OP_SUCCESSOR 3
+#define VEBTREE_OP_PREDECESSOR 4
+#define VEBTREE_NUM_OPS 5
+
+/**
+ * @brief The amount of buckets of the depth histograms, the last one collects all deeper calls.
+ */
+#define VEBTREE_STATS_MAX_DEPTH 32
+
+/**
+ * @brief Counters kept by each tree when compiling with VEBTREE_STATS defined. They are
+ * stored right behind the tree's root and updated by the operations called on the root
+ * (operations on subtrees, e.g. by the map / priority queue extensions, aren't tracked).
+ * The counters aren't synchronized, so trees read by multiple threads at once may miss
+ * increments. Builds without VEBTREE_STATS don't pay anything for the instrumentation.
+ */
+typedef struct _VEB_TREE_STATS {
+    uint64_t calls[VEBTREE_NUM_OPS];
+    /**< The amount of calls per operation. */
+    uint64_t leaf_hits[VEBTREE_NUM_OPS];
+    /**< The amount of calls per operation that recursed down to a bitwise leaf. */
+    uint64_t depth_histogram[VEBTREE_NUM_OPS][VEBTREE_STATS_MAX_DEPTH];
+    /**< The amount of calls per operation by the amount of nodes visited recursively. Lookups visit
+         a single path, so it's their recursion depth; inserts / deletes may visit a global as well. */
+    uint64_t allocations;
+    /**< The amount of subtree allocations, including the tree's initial allocations. */
+    uint64_t frees;
+    /**< The amount of subtree allocations released again (shrinking trees). */
+    uint64_t allocated_bytes;
+    /**< The bytes currently allocated by the tree, see vebtree_memory_usage(). */
+    uint64_t peak_bytes;
+    /**< The most bytes allocated by the tree at once. */
+} VebTreeStats;
+
+#endif
+
+/**
+ * @brief The maximum depth of the node paths tracked by cursors.
+ */
+#define VEBTREE_CURSOR_MAX_DEPTH 16
+
+/**
+ * @brief Stateful cursor for ordered scans over a van Emde Boas tree. It keeps
+ * the path of clusters leading to the current key, so stepping to the next /
+ * previous key only climbs up once the current leaf / cluster is exhausted.
+ * Note that cursors are invalidated by modifying the tree.
+ */
+typedef struct _VEB_TREE_CURSOR {
+    VebTree* tree;
+    /**< The tree being scanned. */
+    vebkey_t key;
+    /**< The current key or vebtree_null if the cursor reached the end. */
+    uint8_t depth;
+    /**< The amount of nodes on the current path. */
+    struct {
+        VebTree* node;
+        /**< The node on the path, NULL for the leaf clusters of leaf parents. */
+        uint64_t* leaf;
+        /**< The bitboard words of leafs (leaf nodes and leaf clusters) or NULL for other nodes. */
+        vebkey_t prefix;
+        /**< The key bits above the node's key space. */
+        vebkey_t cluster;
+        /**< The local index that the path descends into or vebtree_null for the node's low. */
+    } path[VEBTREE_CURSOR_MAX_DEPTH];
+    /**< The nodes leading from the root to the current key. */
+} VebCursor;
+
+/**
+ * @brief Memory allocator providing a tree's nodes instead of malloc() / free(),
+ * e.g. to place the tree on huge pages (see vebtrees_alloc.h for built-in ones).
+ * The allocator is referred to by all nodes of the tree, so it has to outlive them.
+ */
+typedef struct _VEB_ALLOCATOR {
+    void* (*alloc)(void* context, size_t bytes);
+    /**< Allocate the given amount of bytes aligned to 16 bytes, returning NULL on failure. */
+    void (*free)(void* context, void* memory, size_t bytes);
+    /**< Release memory returned by alloc, along with the amount of bytes requested. */
+    void* context;
+    /**< The context pointer passed to both callbacks. */
+} VebAllocator;
+
+/**
+ * @brief The maximum amount of distinct allocators used by trees of a process.
+ */
+#define VEBTREE_MAX_ALLOCATORS 255
+
 /* ===================================== *
  *          F U N C T I O N S
  * ===================================== */
@@ -80,17 +214,53 @@ typedef struct _VEB_TREE_NODE {
  * @param tree a reference pointer that is set to the
  *             newly allocated tree structure's reference.
  * @param universe_bits the universe size to be managed by the tree in bits
- * @param flags a collection of flags adjusting the tree's behavior
+ * @param flags a collection of flags adjusting the tree's behavior, e.g.
+ *              VEBTREE_FLAG_LAZY allocates subtrees on their first key insertion
+ *              (required for 32-bit / 64-bit universes) and VEBTREE_FLAG_SHRINK
+ *              releases them again once they run empty; VEBTREE_FLAG_ARENA lays
+ *              out a fully allocated tree in a single allocation instead;
+ *              VEBTREE_FLAG_COUNTS keeps per-cluster key counts for order statistics;
+ *              VEBTREE_FLAG_SPARSE keeps only the non-empty clusters in hash tables,
+ *              so the memory grows with the amount of keys (implies lazy + shrinking);
+ *              VEBTREE_FLAG_COW reference counts the subtrees for vebtree_snapshot()
  */
 void vebtree_init(VebTree** tree, uint8_t universe_bits, uint8_t flags);
 
 /**
- * @brief Free the memory allocated by the given van Emde Boas tree.
+ * @brief Create a new van Emde Boas tree structure whose nodes are allocated by
+ * the given allocator, see vebtree_init() for the other parameters. Each allocator
+ * is registered on its first use, so trees should be created on one thread at a
+ * time. The callbacks are invoked by the thread modifying / freeing the tree.
+ *
+ * @param tree a reference pointer that is set to the newly allocated tree structure
+ * @param universe_bits the universe size to be managed by the tree in bits
+ * @param flags a collection of flags adjusting the tree's behavior
+ * @param allocator the allocator providing the nodes or NULL for malloc() / free()
+ */
+void vebtree_init_with_allocator(VebTree** tree, uint8_t universe_bits, uint8_t flags,
+                                 const VebAllocator* allocator);
+
+/**
+ * @brief Free the memory allocated by the given van Emde Boas tree,
+ * including the tree structure itself.
  *
  * @param tree the tree to be freed.
  */
 void vebtree_free(VebTree* tree);
 
+/**
+ * @brief Take a consistent snapshot of a tree created with VEBTREE_FLAG_COW in O(1).
+ * The snapshot shares all subtrees with the tree, later inserts / deletes on either of
+ * them copy the shared nodes along their path first, so the memory overhead grows with
+ * the changes between the snapshots. The snapshot has to be taken on the writer's thread,
+ * afterwards it can be read and freed by vebtree_free() on other threads without locks.
+ * Meant as read-only view, modifying it copies the shared nodes as well.
+ *
+ * @param tree the tree to be snapshotted
+ * @return the snapshot, a tree of its own that needs to be freed by vebtree_free()
+ */
+VebTree* vebtree_snapshot(VebTree* tree);
+
 /**
  * @brief Inidicates whether a van Emde Boas tree contains the given key.
  *
@@ -144,6 +314,122 @@ vebkey_t vebtree_successor(VebTree* tree, vebkey_t key);
  */
 vebkey_t vebtree_predecessor(VebTree* tree, vebkey_t key);
 
+/**
+ * @brief Retrieve the greatest key less or equal to the given key.
+ *
+ * @param tree the tree to be looked up
+ * @param key the key to be looked up
+ * @return the key's floor or vebtree_null if there's none
+ */
+vebkey_t vebtree_floor(VebTree* tree, vebkey_t key);
+
+/**
+ * @brief Retrieve the smallest key greater or equal to the given key.
+ *
+ * @param tree the tree to be looked up
+ * @param key the key to be looked up
+ * @return the key's ceiling or vebtree_null if there's none
+ */
+vebkey_t vebtree_ceiling(VebTree* tree, vebkey_t key);
+
+/**
+ * @brief Retrieve all keys within [low, high] in ascending order.
+ *
+ * @param tree the tree to be looked up
+ * @param low the lower bound of the range (inclusive)
+ * @param high the upper bound of the range (inclusive)
+ * @param output the array to write the keys to
+ * @param capacity the maximum amount of keys to be written
+ * @return the amount of keys written
+ */
+size_t vebtree_range(VebTree* tree, vebkey_t low, vebkey_t high, vebkey_t output[], size_t capacity);
+
+/**
+ * @brief Retrieve the smallest key greater or equal to the given key that is not part
+ * of the tree, e.g. the next free slot of an ID allocator. Each node keeps a second
+ * tree of its full clusters, so they're skipped like empty clusters are skipped by
+ * successor searches. Trees created with VEBTREE_FLAG_COUNTS skip them by their key
+ * counts instead (O(log u)), sparse trees and mapped snapshots don't keep track of
+ * full clusters and probe the non-empty ones one by one.
+ *
+ * @param tree the tree to be looked up
+ * @param key the key to be looked up
+ * @return the next absent key or vebtree_null if all keys from the given key on are taken
+ */
+vebkey_t vebtree_next_absent(VebTree* tree, vebkey_t key);
+
+/**
+ * @brief Retrieve the greatest key less or equal to the given key that is not part
+ * of the tree. Full clusters are skipped like with vebtree_next_absent().
+ *
+ * @param tree the tree to be looked up
+ * @param key the key to be looked up
+ * @return the previous absent key or vebtree_null if all keys up to the given key are taken
+ */
+vebkey_t vebtree_prev_absent(VebTree* tree, vebkey_t key);
+
+/**
+ * @brief Insert the smallest key that is not part of the tree yet. The absent key
+ * is looked up and inserted within a single descent.
+ *
+ * @param tree the tree to allocate the key from
+ * @return the inserted key or vebtree_null if the tree's universe is full
+ */
+vebkey_t vebtree_alloc_lowest_free(VebTree* tree);
+
+/**
+ * @brief Check a batch of keys for being part of the tree. The descents of up to
+ * VEBTREE_BATCH_GROUP keys are interleaved, prefetching each key's next node while
+ * the other keys are processed, so the cache misses of large trees overlap.
+ *
+ * @param tree the tree to be looked up
+ * @param keys the keys to be looked up
+ * @param num_keys the amount of keys to be looked up
+ * @param output the array receiving whether each key is part of the tree
+ */
+void vebtree_contains_keys(VebTree* tree, const vebkey_t keys[], size_t num_keys, bool output[]);
+
+/**
+ * @brief Retrieve the successors of a batch of keys, interleaving their descents
+ * like vebtree_contains_keys().
+ *
+ * @param tree the tree to be looked up
+ * @param keys the keys to be looked up
+ * @param num_keys the amount of keys to be looked up
+ * @param output the array receiving each key's successor or vebtree_null if there's none
+ */
+void vebtree_successors(VebTree* tree, const vebkey_t keys[], size_t num_keys, vebkey_t output[]);
+
+/**
+ * @brief Retrieve the amount of keys inserted into the tree. Requires a tree
+ * created with VEBTREE_FLAG_COUNTS (unless it's a single bitwise leaf).
+ *
+ * @param tree the tree to be counted
+ * @return the amount of keys
+ */
+uint64_t vebtree_size(VebTree* tree);
+
+/**
+ * @brief Retrieve the amount of keys smaller than the given key, i.e. the key's
+ * position in ascending order if it's part of the tree. Requires a tree created
+ * with VEBTREE_FLAG_COUNTS (unless it's a single bitwise leaf).
+ *
+ * @param tree the tree to be looked up
+ * @param key the key to be ranked
+ * @return the amount of keys smaller than the key
+ */
+uint64_t vebtree_rank(VebTree* tree, vebkey_t key);
+
+/**
+ * @brief Retrieve the key at the given position in ascending order. Requires a
+ * tree created with VEBTREE_FLAG_COUNTS (unless it's a single bitwise leaf).
+ *
+ * @param tree the tree to be looked up
+ * @param rank the zero-based position of the key
+ * @return the key or vebtree_null if the rank exceeds the tree's size
+ */
+vebkey_t vebtree_select(VebTree* tree, uint64_t rank);
+
 /**
  * @brief Insert the given key into the data structure.
  *
@@ -160,6 +446,204 @@ void vebtree_insert_key(VebTree* tree, vebkey_t key);
  */
 void vebtree_delete_key(VebTree* tree, vebkey_t key);
 
+/**
+ * @brief Insert the given keys into the data structure at once.
+ * Empty trees are built bottom-up instead of descending from the root for each key:
+ * sorted keys are consumed in a single linear pass, unsorted keys are partitioned
+ * by their global address first. Duplicate keys are allowed.
+ *
+ * @param tree the tree to be inserted into
+ * @param keys the keys to be inserted
+ * @param num_keys the amount of keys to be inserted
+ */
+void vebtree_insert_keys(VebTree* tree, const vebkey_t keys[], size_t num_keys);
+
+/**
+ * @brief Insert all keys within the given range. Only the leafs at the range's
+ * bounds are modified bit by bit, the leafs in between are filled word by word
+ * and each cluster's global / low / high are updated once per cluster.
+ *
+ * @param tree the tree to be inserted into
+ * @param low the smallest key of the range
+ * @param high the greatest key of the range (inclusive)
+ */
+void vebtree_insert_range(VebTree* tree, vebkey_t low, vebkey_t high);
+
+/**
+ * @brief Delete all keys within the given range. Clusters that are covered by
+ * the range as a whole are cleared at once instead of deleting their keys.
+ *
+ * @param tree the tree to be deleted from
+ * @param low the smallest key of the range
+ * @param high the greatest key of the range (inclusive)
+ */
+void vebtree_delete_range(VebTree* tree, vebkey_t low, vebkey_t high);
+
+/**
+ * @brief Position the cursor at the smallest key greater or equal to the given key.
+ *
+ * @param cursor the cursor to be positioned
+ * @param tree the tree to be scanned
+ * @param key the key to start at
+ * @return the key the cursor is positioned at or vebtree_null if there's none
+ */
+vebkey_t vebtree_cursor_seek(VebCursor* cursor, VebTree* tree, vebkey_t key);
+
+/**
+ * @brief Position the cursor at the greatest key of the tree.
+ *
+ * @param cursor the cursor to be positioned
+ * @param tree the tree to be scanned
+ * @return the key the cursor is positioned at or vebtree_null if the tree is empty
+ */
+vebkey_t vebtree_cursor_seek_last(VebCursor* cursor, VebTree* tree);
+
+/**
+ * @brief Move the cursor to the next greater key.
+ *
+ * @param cursor the cursor to be moved
+ * @return the next key or vebtree_null if the cursor reached the end
+ */
+vebkey_t vebtree_cursor_next(VebCursor* cursor);
+
+/**
+ * @brief Move the cursor to the next smaller key.
+ *
+ * @param cursor the cursor to be moved
+ * @return the previous key or vebtree_null if the cursor reached the end
+ */
+vebkey_t vebtree_cursor_prev(VebCursor* cursor);
+
+/**
+ * @brief Indicates whether the cursor moved beyond the tree's keys.
+ *
+ * @param cursor the cursor to be checked
+ * @return true if the cursor isn't positioned at any key
+ * @return false if the cursor is positioned at a key
+ */
+bool vebtree_cursor_end(const VebCursor* cursor);
+
+/**
+ * @brief Export the keys of the tree in ascending order.
+ *
+ * @param tree the tree to be exported
+ * @param output the array to write the keys to
+ * @param capacity the maximum amount of keys to be written
+ * @return the amount of keys written
+ */
+size_t vebtree_to_array(VebTree* tree, vebkey_t output[], size_t capacity);
+
+/**
+ * @brief Insert all keys of the other tree into the tree (in-place union).
+ * Trees of the same shape are merged cluster by cluster, combining leafs
+ * word by word and skipping clusters that are empty in the other tree.
+ *
+ * @param tree the tree to be modified
+ * @param other the tree whose keys are inserted, needs the same universe bits
+ */
+void vebtree_union(VebTree* tree, VebTree* other);
+
+/**
+ * @brief Delete all keys from the tree that are not part of the other tree (in-place intersection).
+ *
+ * @param tree the tree to be modified
+ * @param other the tree to be intersected with, needs the same universe bits
+ */
+void vebtree_intersect(VebTree* tree, VebTree* other);
+
+/**
+ * @brief Delete all keys of the other tree from the tree (in-place difference).
+ *
+ * @param tree the tree to be modified
+ * @param other the tree whose keys are deleted, needs the same universe bits
+ */
+void vebtree_difference(VebTree* tree, VebTree* other);
+
+/**
+ * @brief Create a new tree containing the keys of both trees.
+ * The new tree has the universe and flags of the first tree.
+ *
+ * @param result a reference pointer that is set to the newly allocated tree
+ * @param tree_a the first tree
+ * @param tree_b the second tree, needs the same universe bits
+ */
+void vebtree_init_union(VebTree** result, VebTree* tree_a, VebTree* tree_b);
+
+/**
+ * @brief Create a new tree containing the keys that are part of both trees.
+ * The new tree has the universe and flags of the first tree.
+ *
+ * @param result a reference pointer that is set to the newly allocated tree
+ * @param tree_a the first tree
+ * @param tree_b the second tree, needs the same universe bits
+ */
+void vebtree_init_intersection(VebTree** result, VebTree* tree_a, VebTree* tree_b);
+
+/**
+ * @brief Create a new tree containing the keys of the first tree that are not part of the second tree.
+ * The new tree has the universe and flags of the first tree.
+ *
+ * @param result a reference pointer that is set to the newly allocated tree
+ * @param tree_a the first tree
+ * @param tree_b the second tree, needs the same universe bits
+ */
+void vebtree_init_difference(VebTree** result, VebTree* tree_a, VebTree* tree_b);
+
+/**
+ * @brief Sort arbitrary 64-bit keys (duplicates allowed) in ascending order.
+ * The keys are shifted by their minimum into the smallest universe covering
+ * their range and sorted by a van Emde Boas tree. Key ranges too wide for
+ * a dense tree are partitioned by their upper bits first (MSD radix).
+ *
+ * @param keys the keys to be sorted
+ * @param num_keys the amount of keys to be sorted
+ * @param output the array to write the sorted keys to (may not overlap the keys)
+ * @param flags VEBTREE_SORT_UNIQUE drops duplicate keys, VEBTREE_SORT_DEFAULT keeps them
+ * @return the amount of keys written
+ */
+size_t vebtree_sort(const vebkey_t keys[], size_t num_keys, vebkey_t output[], uint8_t flags);
+
+/**
+ * @brief Retrieve the bytes allocated by the tree, i.e. the root and all
+ * subtree blocks (including the counts of VEBTREE_FLAG_COUNTS, but excluding
+ * the values of maps). It walks all allocated nodes, so it takes O(n) time.
+ * Subtrees shared with snapshots are counted by each of the trees.
+ *
+ * @param tree the tree to be measured
+ * @return the allocated bytes
+ */
+size_t vebtree_memory_usage(VebTree* tree);
+
+/**
+ * @brief Print the tree's shape (universe, flags, allocated / non-empty nodes, bytes)
+ * as "name value" lines, e.g. for exporting them to a metrics system. Builds with
+ * VEBTREE_STATS defined also print the counters of the tree's VebTreeStats.
+ *
+ * @param tree the tree to be described
+ * @param file the file to print to, e.g. stdout
+ */
+void vebtree_stats_dump(VebTree* tree, FILE* file);
+
+#ifdef VEBTREE_STATS
+
+/**
+ * @brief Retrieve the counters of a tree (VEBTREE_STATS builds only).
+ *
+ * @param tree the tree's root as created by vebtree_init()
+ * @return the tree's counters or NULL for subtrees, maps and mapped trees
+ */
+VebTreeStats* vebtree_stats(VebTree* tree);
+
+/**
+ * @brief Reset the tree's operation counters (VEBTREE_STATS builds only),
+ * e.g. after exporting them. The allocated bytes are kept.
+ *
+ * @param tree the tree's root as created by vebtree_init()
+ */
+void vebtree_stats_reset(VebTree* tree);
+
+#endif
+
 /**
  * @brief Retrieve the amount of universe bits required
  * to represent the given maximum key value.
@@ -183,6 +667,7 @@ typedef uint64_t bitboard_t;
 
 #define leading_zeros(x) __builtin_clzll(x)
 #define trailing_zeros(x) __builtin_ctzll(x)
+#define count_bits_set(x) ((uint32_t)__builtin_popcountll(x))
 
 #define min_bit_set(bits) ((uint8_t)trailing_zeros(bits))
 #define max_bit_set(bits) ((uint8_t)(sizeof(bitboard_t) * 8 - leading_zeros(bits) - 1))
@@ -203,6 +688,8 @@ uint8_t min_bit_set(bitboard_t bits)
     return (uint8_t)idx;
 }
 
+#define count_bits_set(x) ((uint32_t)__popcnt64(x))
+
 #else /* fallback implementation for other compilers / systems */
 
 int leading_zeros(bitboard_t bits)
@@ -229,131 +716,748 @@ int trailing_zeros(bitboard_t bits)
     return count;
 }
 
+uint32_t count_bits_set(bitboard_t bits)
+{
+    uint32_t count = 0;
+    for (; bits != 0; bits &= bits - 1) count++;
+    return count;
+}
+
 #define min_bit_set(bits) ((uint8_t)trailing_zeros(bits))
 #define max_bit_set(bits) ((uint8_t)(sizeof(bitboard_t) * 8 - leading_zeros(bits) - 1))
 
 #endif
-/* TODO: use SIMD instructions to support even bigger leaf universes */
+
+#if VEBTREE_LEAF_WORDS > 1 && (defined(__AVX2__) || defined(__AVX512F__))
+#include <immintrin.h>
+#endif
 
 /* ===================================== *
  *        B I T W I S E   L E A F
  * ===================================== */
 
-#define VEBTREE_LEAF_BITS 6
-#define vebtree_new_empty_bitwise_leaf(uni_bits) (VebTree){\
-    (uni_bits), 0, 0, 0, 0, vebtree_null, NULL, NULL}
+#if VEBTREE_LEAF_WORDS == 1
+#define VEBTREE_LEAF_HIGH_INIT vebtree_null
+#else
+#define VEBTREE_LEAF_HIGH_INIT 0
+#endif
+
+/* nodes of VEBTREE_STATS builds have an additional root marker */
+#ifdef VEBTREE_STATS
+#define VEBTREE_NODE_STATS_INIT 0,
+#else
+#define VEBTREE_NODE_STATS_INIT
+#endif
 
-#define vebtree_bitwise_leaf_is_empty(tree) ((tree)->low == 0)
-#define vebtree_bitwise_leaf_contains_key(tree, key) ((((bitboard_t)1 << (key)) & (tree)->low) > 0)
-#define vebtree_bitwise_leaf_get_min(tree) (min_bit_set((tree)->low))
-#define vebtree_bitwise_leaf_get_max(tree) (max_bit_set((tree)->low))
+#define vebtree_new_empty_bitwise_leaf(uni_bits) (VebTree){\
+    (uni_bits), 0, 0, 0, 0, 0, VEBTREE_NODE_STATS_INIT {{0, VEBTREE_LEAF_HIGH_INIT, {NULL}}}}
 
 #define trailing_bits_mask(num_bits) (((bitboard_t)1 << (num_bits)) - 1)
 #define leading_bits_mask(num_bits) (((bitboard_t)0xFFFFFFFFFFFFFFFF << (num_bits)))
 
-vebkey_t vebtree_bitwise_leaf_successor(VebTree* tree, vebkey_t key)
+#define vebtree_leaf_word(key) ((key) >> 6)
+#define vebtree_leaf_bit(key) ((bitboard_t)1 << ((key) & 63))
+
+#if VEBTREE_LEAF_WORDS == 8 && defined(__AVX512F__)
+#define VEBTREE_LEAF_SIMD 512
+#elif VEBTREE_LEAF_WORDS >= 4 && defined(__AVX2__)
+#define VEBTREE_LEAF_SIMD 256
+#endif
+
+#ifdef VEBTREE_LEAF_SIMD
+
+/* bitmask with one bit per leaf word, indicating whether the word has any bits set */
+uint32_t vebtree_bitwise_leaf_nonzero_words(const bitboard_t* leaf)
 {
-    uint64_t succ_bits, min_succ;
-    succ_bits = tree->low & leading_bits_mask((uint8_t)key + 1);
-    min_succ = min_bit_set(succ_bits);
-    return (min_succ == 0 || succ_bits == 0) ? vebtree_null : min_succ;
+#if VEBTREE_LEAF_SIMD == 512
+    __m512i bits = _mm512_loadu_si512((const void*)leaf);
+    return (uint32_t)_mm512_test_epi64_mask(bits, bits);
+#else
+    uint32_t i, mask = 0; __m256i bits, zeros;
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i += 4) {
+        bits = _mm256_loadu_si256((const __m256i*)(leaf + i));
+        zeros = _mm256_cmpeq_epi64(bits, _mm256_setzero_si256());
+        mask |= (uint32_t)(~_mm256_movemask_pd(_mm256_castsi256_pd(zeros)) & 0xF) << i;
+    }
+    return mask;
+#endif
 }
 
-vebkey_t vebtree_bitwise_leaf_predecessor(VebTree* tree, vebkey_t key)
+#define vebtree_bitwise_leaf_is_empty(leaf) (vebtree_bitwise_leaf_nonzero_words(leaf) == 0)
+
+/* index of the first non-empty word >= the given word, VEBTREE_LEAF_WORDS if there's none */
+uint32_t vebtree_bitwise_leaf_next_word(const bitboard_t* leaf, uint32_t word)
 {
-    uint64_t pred_bits, max_pred;
-    pred_bits = tree->low & trailing_bits_mask((uint8_t)key);
-    max_pred = max_bit_set(pred_bits);
-    return (max_pred == 0 && (tree->low & 1) == 0) ? vebtree_null : max_pred;
+    uint32_t words = vebtree_bitwise_leaf_nonzero_words(leaf) & ((uint32_t)0xFFFFFFFF << word);
+    return words == 0 ? VEBTREE_LEAF_WORDS : min_bit_set(words);
 }
 
-void vebtree_bitwise_leaf_insert_key(VebTree* tree, vebkey_t key)
+/* index of the last non-empty word < the given word, VEBTREE_LEAF_WORDS if there's none */
+uint32_t vebtree_bitwise_leaf_prev_word(const bitboard_t* leaf, uint32_t word)
 {
-    tree->low |= (bitboard_t)1 << key;
+    uint32_t words = vebtree_bitwise_leaf_nonzero_words(leaf) & (((uint32_t)1 << word) - 1);
+    return words == 0 ? VEBTREE_LEAF_WORDS : max_bit_set(words);
 }
 
-void vebtree_bitwise_leaf_delete_key(VebTree* tree, vebkey_t key)
+#else /* scalar fallback, also used for single-word leafs */
+
+bool vebtree_bitwise_leaf_is_empty(const bitboard_t* leaf)
 {
-    tree->low &= ~((bitboard_t)1 << key);
+    uint32_t i;
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i++)
+        if (leaf[i] != 0) return false;
+    return true;
 }
 
-/* ===================================== *
- *          T R E E   F L A G S
- * ===================================== */
+uint32_t vebtree_bitwise_leaf_next_word(const bitboard_t* leaf, uint32_t word)
+{
+    while (word < VEBTREE_LEAF_WORDS && leaf[word] == 0) word++;
+    return word;
+}
 
-#define VEBTREE_FLAG_LEAF 1
-#define VEBTREE_FLAG_LAZY 2
-#define VEBTREE_DEFAULT_FLAGS 0
-/* TODO: enable lazy mode once the implementation is ready */
+uint32_t vebtree_bitwise_leaf_prev_word(const bitboard_t* leaf, uint32_t word)
+{
+    while (word > 0) if (leaf[--word] != 0) return word;
+    return VEBTREE_LEAF_WORDS;
+}
 
-#define vebtree_is_leaf(tree) ((tree)->universe_bits <= VEBTREE_LEAF_BITS)
-#define vebtree_is_lazy(tree) ((tree)->flags & VEBTREE_FLAG_LAZY)
+#endif
 
-/* ===================================== *
- *           V E B   C O R E
- * ===================================== */
+#define vebtree_bitwise_leaf_contains_key(leaf, key) \
+    (((leaf)[vebtree_leaf_word(key)] & vebtree_leaf_bit(key)) != 0)
 
-#define vebtree_new_empty_node(uni_bits, lower_bits, flags) (VebTree){\
-    (uni_bits), (lower_bits), (uni_bits) - (lower_bits), (flags),\
-    vebtree_null, vebtree_null, NULL, NULL}
+vebkey_t vebtree_bitwise_leaf_get_min(const bitboard_t* leaf)
+{
+    uint32_t word = vebtree_bitwise_leaf_next_word(leaf, 0);
+    return ((vebkey_t)word << 6) | min_bit_set(leaf[word]);
+}
 
-/* TODO: remove those makros, copy the code to the location of usage */
-#define vebtree_lower_bits(uni_bits) ((uni_bits) >> 1) /* div by 2 */
-#define vebtree_upper_bits(uni_bits) ((uni_bits) - vebtree_lower_bits(uni_bits))
+vebkey_t vebtree_bitwise_leaf_get_max(const bitboard_t* leaf)
+{
+    uint32_t word = vebtree_bitwise_leaf_prev_word(leaf, VEBTREE_LEAF_WORDS);
+    return ((vebkey_t)word << 6) | max_bit_set(leaf[word]);
+}
 
-#define vebtree_universe_maxvalue(uni_bits) ((vebkey_t)1 << (uni_bits))
-#define vebtree_local_address(key, local_bits) ((((vebkey_t)1 << (local_bits)) - 1) & (key))
-#define vebtree_global_address(key, local_bits) ((key) >> (local_bits))
+vebkey_t vebtree_bitwise_leaf_successor(const bitboard_t* leaf, vebkey_t key)
+{
+    bitboard_t succ_bits; vebkey_t word;
+
+    /* look for the successor within the key's own word */
+    word = vebtree_leaf_word(key);
+    succ_bits = (key & 63) == 63 ? 0 : leaf[word] & leading_bits_mask((key & 63) + 1);
+    if (succ_bits != 0)
+        return (word << 6) | min_bit_set(succ_bits);
+
+    /* otherwise, the successor is the minimum of the next non-empty word */
+    word = vebtree_bitwise_leaf_next_word(leaf, (uint32_t)word + 1);
+    return word == VEBTREE_LEAF_WORDS ? vebtree_null
+        : (word << 6) | min_bit_set(leaf[word]);
+}
 
-bool vebtree_is_empty(VebTree* tree)
+vebkey_t vebtree_bitwise_leaf_predecessor(const bitboard_t* leaf, vebkey_t key)
 {
-    return vebtree_is_leaf(tree)
-        ? vebtree_bitwise_leaf_is_empty(tree)
-        : (tree)->low == vebtree_null;
+    bitboard_t pred_bits; vebkey_t word;
+
+    /* look for the predecessor within the key's own word */
+    word = vebtree_leaf_word(key);
+    pred_bits = leaf[word] & trailing_bits_mask(key & 63);
+    if (pred_bits != 0)
+        return (word << 6) | max_bit_set(pred_bits);
+
+    /* otherwise, the predecessor is the maximum of the previous non-empty word */
+    word = vebtree_bitwise_leaf_prev_word(leaf, (uint32_t)word);
+    return word == VEBTREE_LEAF_WORDS ? vebtree_null
+        : (word << 6) | max_bit_set(leaf[word]);
 }
 
-vebkey_t vebtree_get_min(VebTree* tree)
+void vebtree_bitwise_leaf_insert_key(bitboard_t* leaf, vebkey_t key)
 {
-    if (vebtree_is_empty(tree))
-        return vebtree_null;
+    leaf[vebtree_leaf_word(key)] |= vebtree_leaf_bit(key);
+}
 
-    return vebtree_is_leaf(tree)
-        ? vebtree_bitwise_leaf_get_min(tree) : tree->low;
+void vebtree_bitwise_leaf_delete_key(bitboard_t* leaf, vebkey_t key)
+{
+    leaf[vebtree_leaf_word(key)] &= ~vebtree_leaf_bit(key);
 }
 
-vebkey_t vebtree_get_max(VebTree* tree)
+/* the smallest key >= the given key that isn't set, limited to the leaf's universe */
+vebkey_t vebtree_bitwise_leaf_next_absent(const bitboard_t* leaf, vebkey_t key, uint8_t uni_bits)
 {
-    if (vebtree_is_empty(tree))
-        return vebtree_null;
+    bitboard_t absent_bits; vebkey_t word, absent;
 
-    return vebtree_is_leaf(tree)
-        ? vebtree_bitwise_leaf_get_max(tree) : tree->high;
+    word = vebtree_leaf_word(key);
+    absent_bits = ~leaf[word] & leading_bits_mask(key & 63);
+    while (absent_bits == 0 && ++word < VEBTREE_LEAF_WORDS)
+        absent_bits = ~leaf[word];
+    if (absent_bits == 0) return vebtree_null;
+
+    absent = (word << 6) | min_bit_set(absent_bits);
+    return absent < ((vebkey_t)1 << uni_bits) ? absent : vebtree_null;
 }
 
-uint8_t vebtree_required_universe_bits(vebkey_t max_key)
+/* the greatest key <= the given key that isn't set */
+vebkey_t vebtree_bitwise_leaf_prev_absent(const bitboard_t* leaf, vebkey_t key)
 {
-    assert(max_key != 0 && "universe has to consist of at least 2 keys");
-    return max_bit_set(max_key) == 0 ? 64 : max_bit_set(max_key) + 1;
+    bitboard_t absent_bits; vebkey_t word;
+
+    word = vebtree_leaf_word(key);
+    absent_bits = ~leaf[word] & ((bitboard_t)0xFFFFFFFFFFFFFFFF >> (63 - (key & 63)));
+    while (absent_bits == 0 && word > 0)
+        absent_bits = ~leaf[--word];
+    return absent_bits == 0 ? vebtree_null : (word << 6) | max_bit_set(absent_bits);
 }
 
-void _init_subtrees(VebTree* tree, uint8_t flags);
-void _vebtree_init(VebTree* tree, uint8_t universe_bits, uint8_t flags, bool is_memeff_root);
+#define vebtree_bitwise_leaf_is_full(leaf, uni_bits) \
+    (vebtree_bitwise_leaf_next_absent(leaf, 0, uni_bits) == vebtree_null)
 
-void vebtree_init(VebTree** new_tree, uint8_t universe_bits, uint8_t flags)
+/* the bits of the given word within the key range [first, last] */
+#define vebtree_leaf_range_mask(word, first, last) \
+    (leading_bits_mask((word) == vebtree_leaf_word(first) ? (first) & 63 : 0)\
+    & ((bitboard_t)0xFFFFFFFFFFFFFFFF >> ((word) == vebtree_leaf_word(last) ? 63 - ((last) & 63) : 0)))
+
+/* set the keys of the range word by word, returning the amount of keys that weren't set yet */
+uint64_t vebtree_bitwise_leaf_insert_range(bitboard_t* leaf, vebkey_t first, vebkey_t last)
 {
-    assert((universe_bits > 0 && universe_bits <= 64)
-        && "invalid amount of universe bits, needs to be within [1, 64].");
+    vebkey_t word; bitboard_t mask; uint64_t inserted = 0;
 
-    /* allocate memory for the first tree */
-    *new_tree = (VebTree*)malloc(sizeof(VebTree));
-    _vebtree_init(*new_tree, universe_bits, flags, true);
+    for (word = vebtree_leaf_word(first); word <= vebtree_leaf_word(last); word++) {
+        mask = vebtree_leaf_range_mask(word, first, last);
+        inserted += count_bits_set(mask & ~leaf[word]);
+        leaf[word] |= mask;
+    }
+    return inserted;
 }
 
-void _vebtree_init(VebTree* tree, uint8_t universe_bits, uint8_t flags, bool is_memeff_root)
+/* clear the keys of the range word by word, returning the amount of keys that were set */
+uint64_t vebtree_bitwise_leaf_delete_range(bitboard_t* leaf, vebkey_t first, vebkey_t last)
 {
-    uint8_t lower_bits;
+    vebkey_t word; bitboard_t mask; uint64_t deleted = 0;
 
-    assert((universe_bits > 0 && universe_bits <= 64)
+    for (word = vebtree_leaf_word(first); word <= vebtree_leaf_word(last); word++) {
+        mask = vebtree_leaf_range_mask(word, first, last);
+        deleted += count_bits_set(mask & leaf[word]);
+        leaf[word] &= ~mask;
+    }
+    return deleted;
+}
+
+uint64_t vebtree_bitwise_leaf_size(const bitboard_t* leaf)
+{
+    uint32_t i; uint64_t size = 0;
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i++)
+        size += count_bits_set(leaf[i]);
+    return size;
+}
+
+uint64_t vebtree_bitwise_leaf_rank(const bitboard_t* leaf, vebkey_t key)
+{
+    uint32_t i; uint64_t rank = 0;
+    for (i = 0; i < vebtree_leaf_word(key); i++)
+        rank += count_bits_set(leaf[i]);
+    return rank + count_bits_set(leaf[vebtree_leaf_word(key)] & trailing_bits_mask(key & 63));
+}
+
+vebkey_t vebtree_bitwise_leaf_select(const bitboard_t* leaf, uint64_t rank)
+{
+    uint32_t i, count; bitboard_t bits;
+
+    /* skip whole words, then drop the lowest bits of the word holding the key */
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i++) {
+        count = count_bits_set(leaf[i]);
+        if (rank < count) {
+            for (bits = leaf[i]; rank > 0; rank--) bits &= bits - 1;
+            return ((vebkey_t)i << 6) | min_bit_set(bits);
+        }
+        rank -= count;
+    }
+
+    return vebtree_null;
+}
+
+/* combine the bitboards of two leafs word by word */
+void vebtree_bitwise_leaf_union(bitboard_t* leaf, const bitboard_t* other)
+{
+    uint32_t i;
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i++) leaf[i] |= other[i];
+}
+
+void vebtree_bitwise_leaf_intersect(bitboard_t* leaf, const bitboard_t* other)
+{
+    uint32_t i;
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i++) leaf[i] &= other[i];
+}
+
+void vebtree_bitwise_leaf_difference(bitboard_t* leaf, const bitboard_t* other)
+{
+    uint32_t i;
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i++) leaf[i] &= ~other[i];
+}
+
+#define vebtree_bitwise_leaf_clear(leaf) memset((leaf), 0, VEBTREE_LEAF_WORDS * sizeof(bitboard_t))
+
+/* ===================================== *
+ *          T R E E   F L A G S
+ * ===================================== */
+
+#define VEBTREE_FLAG_LEAF 1
+#define VEBTREE_FLAG_LAZY 2
+#define VEBTREE_FLAG_SHRINK 4
+#define VEBTREE_FLAG_ARENA 8
+#define VEBTREE_FLAG_MAPPED 16
+#define VEBTREE_FLAG_COUNTS 32
+#define VEBTREE_FLAG_SPARSE 64
+#define VEBTREE_FLAG_COW 128
+#define VEBTREE_DEFAULT_FLAGS 0
+
+#define VEBTREE_SORT_DEFAULT 0
+#define VEBTREE_SORT_UNIQUE 1
+
+/* lazy nodes allocate 2^upper_bits locals at once, so cap the fan-out to keep
+   a single allocation small enough for 32-bit and 64-bit universes */
+#define VEBTREE_LAZY_MAX_UPPER_BITS 16
+
+#define vebtree_is_leaf(tree) ((tree)->universe_bits <= VEBTREE_LEAF_BITS)
+#define vebtree_is_lazy(tree) ((tree)->flags & VEBTREE_FLAG_LAZY)
+#define vebtree_is_shrinking(tree) ((tree)->flags & VEBTREE_FLAG_SHRINK)
+#define vebtree_is_arena(tree) ((tree)->flags & VEBTREE_FLAG_ARENA)
+#define vebtree_is_mapped(tree) ((tree)->flags & VEBTREE_FLAG_MAPPED)
+#define vebtree_is_counting(tree) ((tree)->flags & VEBTREE_FLAG_COUNTS)
+#define vebtree_is_sparse(tree) ((tree)->flags & VEBTREE_FLAG_SPARSE)
+#define vebtree_is_cow(tree) ((tree)->flags & VEBTREE_FLAG_COW)
+#define vebtree_has_subtrees(tree) ((tree)->locals != NULL)
+
+/* the locals of leaf parents all share the same universe, so they're stored as bare
+   bitboards instead of nodes; sparse tables keep their leafs as nodes, see below */
+#define VEBTREE_LEAF_BYTES (VEBTREE_LEAF_WORDS * sizeof(bitboard_t))
+#define vebtree_local_is_leaf(lower_bits, flags) \
+    ((lower_bits) <= VEBTREE_LEAF_BITS && !((flags) & VEBTREE_FLAG_SPARSE))
+#define vebtree_has_leaf_locals(tree) vebtree_local_is_leaf((tree)->lower_bits, (tree)->flags)
+#define vebtree_local_bytes(lower_bits, flags) \
+    (vebtree_local_is_leaf(lower_bits, flags) ? VEBTREE_LEAF_BYTES : sizeof(VebTree))
+
+/* counting nodes keep a fenwick tree over their locals' key counts right behind the locals array;
+   the global only tracks which locals are non-empty, so it's created without counts */
+#define vebtree_locals_end(tree) ((uint8_t*)(tree)->locals \
+    + ((size_t)1 << (tree)->upper_bits) * vebtree_local_bytes((tree)->lower_bits, (tree)->flags))
+#define vebtree_counts(tree) ((uint64_t*)vebtree_locals_end(tree))
+#define vebtree_global_flags(flags) ((flags) & ~VEBTREE_FLAG_COUNTS)
+
+/* other nodes keep a second tree of the upper bits' universe there instead, holding the global keys
+   of their full locals (a subset of them, paths only filling locals in bulk may skip adding them),
+   so the absent key searches skip full locals like successor searches skip empty ones;
+   sparse tables and mapped snapshots don't keep it and probe their locals one by one */
+#define vebtree_tracks_full(flags) \
+    (!((flags) & (VEBTREE_FLAG_COUNTS | VEBTREE_FLAG_SPARSE | VEBTREE_FLAG_MAPPED)))
+#define vebtree_full_locals(tree) ((VebTree*)vebtree_locals_end(tree))
+
+#define vebtree_locals_bytes(upper_bits, lower_bits, flags) (((size_t)1 << (upper_bits)) \
+    * (vebtree_local_bytes(lower_bits, flags) + ((flags) & VEBTREE_FLAG_COUNTS ? sizeof(uint64_t) : 0)) \
+    + (vebtree_tracks_full(flags) ? sizeof(VebTree) : 0))
+
+/* the global sits right in front of the locals within the same allocation */
+#define vebtree_subtrees_bytes(upper_bits, lower_bits, flags) \
+    (sizeof(VebTree) + vebtree_locals_bytes(upper_bits, lower_bits, flags))
+#define vebtree_owned_global(tree) ((tree)->locals - 1)
+
+/* mapped trees (e.g. memory-mapped snapshots) refer to their subtrees by offsets
+   relative to the node instead of pointers, so read-only queries resolve them here */
+#define vebtree_locals(tree) (vebtree_is_mapped(tree) \
+    ? (VebTree*)((uint8_t*)(tree) + (tree)->locals_offset) : (tree)->locals)
+#define vebtree_global(tree) (vebtree_locals(tree) - 1)
+
+/* sparse nodes only keep their non-empty locals in an open-addressing hash table, the block
+   holds the global, the table's locals, their global keys (vebtree_null for free slots)
+   and the amount of used slots; sparse trees are never mapped, so no offsets needed */
+#define VEBTREE_SPARSE_MIN_TABLE_BITS 1
+#define vebtree_sparse_slots(tree) ((size_t)1 << (tree)->table_bits)
+#define vebtree_sparse_keys(tree) ((vebkey_t*)((tree)->locals + vebtree_sparse_slots(tree)))
+#define vebtree_sparse_used(tree) (vebtree_sparse_keys(tree)[vebtree_sparse_slots(tree)])
+#define vebtree_sparse_bytes(table_bits) (sizeof(VebTree) + sizeof(vebkey_t)\
+    + ((size_t)1 << (table_bits)) * (sizeof(VebTree) + sizeof(vebkey_t)))
+#define vebtree_sparse_hash(global_key, table_bits) \
+    ((size_t)(((global_key) * 0x9E3779B97F4A7C15ULL) >> (64 - (table_bits))))
+
+/* the local of the given global key, sparse nodes return NULL for empty locals;
+   leaf parents resolve their locals' bitboards by vebtree_leaf_cluster() instead */
+#define vebtree_cluster(tree, global_key) (vebtree_is_sparse(tree) \
+    ? _vebtree_sparse_find(tree, global_key) : &(vebtree_locals(tree)[global_key]))
+#define vebtree_leaf_cluster(tree, global_key) \
+    ((bitboard_t*)vebtree_locals(tree) + (size_t)(global_key) * VEBTREE_LEAF_WORDS)
+
+/* walk the locals array or the sparse table's slots, skipping free slots */
+#define vebtree_num_slots(tree) (vebtree_is_sparse(tree) \
+    ? vebtree_sparse_slots(tree) : (size_t)vebtree_universe_maxvalue((tree)->upper_bits))
+#define vebtree_slot_used(tree, i) (!vebtree_is_sparse(tree) || vebtree_sparse_keys(tree)[i] != vebtree_null)
+#define vebtree_block_bytes(tree) (vebtree_is_sparse(tree) ? vebtree_sparse_bytes((tree)->table_bits)\
+    : vebtree_subtrees_bytes((tree)->upper_bits, (tree)->lower_bits, (tree)->flags))
+
+/* copy-on-write blocks are preceded by the amount of nodes referring to them (the
+   parent nodes of all trees sharing the block), it's only modified in place when 1 */
+#define vebtree_block_header(flags) ((flags) & VEBTREE_FLAG_COW ? sizeof(uint64_t) : 0)
+#define vebtree_refcount(tree) ((uint64_t*)vebtree_owned_global(tree) - 1)
+
+#if defined(__GNUC__)
+#define vebtree_atomic_add(ptr, delta) __atomic_add_fetch((ptr), (uint64_t)(delta), __ATOMIC_ACQ_REL)
+#define vebtree_atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define vebtree_atomic_add(ptr, delta) \
+    ((uint64_t)_InterlockedExchangeAdd64((volatile __int64*)(ptr), (__int64)(delta)) + (uint64_t)(delta))
+#define vebtree_atomic_load(ptr) (*(volatile uint64_t*)(ptr))
+#else /* no atomics, snapshots can only be used by a single thread */
+#define vebtree_atomic_add(ptr, delta) (*(ptr) += (uint64_t)(delta))
+#define vebtree_atomic_load(ptr) (*(ptr))
+#endif
+
+/* ===================================== *
+ *      I N S T R U M E N T A T I O N
+ * ===================================== */
+
+#ifdef VEBTREE_STATS
+
+#if defined(_MSC_VER)
+#define VEBTREE_THREAD_LOCAL __declspec(thread)
+#else
+#define VEBTREE_THREAD_LOCAL __thread
+#endif
+
+/* the stats are allocated right behind the root (mapped roots don't have any) */
+#define VEBTREE_ROOT_BYTES (sizeof(VebTree) + sizeof(VebTreeStats))
+#define vebtree_has_stats(tree) ((tree)->is_root && !vebtree_is_mapped(tree))
+#define vebtree_root_bytes(tree) (vebtree_has_stats(tree) ? VEBTREE_ROOT_BYTES : sizeof(VebTree))
+#define vebtree_root_stats(tree) ((VebTreeStats*)((tree) + 1))
+
+/* the operation running on the current thread, its recursion only sees the nodes */
+typedef struct _VEB_TREE_STATS_OP {
+    VebTreeStats* stats;
+    uint32_t visits;
+    bool leaf_hit;
+} VebStatsOp;
+
+VEBTREE_THREAD_LOCAL VebStatsOp _vebtree_stats_op;
+
+#define vebtree_stats_visit() (_vebtree_stats_op.visits++)
+#define vebtree_stats_leaf_hit() (_vebtree_stats_op.leaf_hit = true)
+#define vebtree_stats_begin(tree) _vebtree_stats_begin(tree)
+#define vebtree_stats_end(tree, op) _vebtree_stats_end(tree, op)
+#define vebtree_stats_alloc(bytes) _vebtree_stats_alloc(bytes)
+#define vebtree_stats_free(bytes) _vebtree_stats_free(bytes)
+#define vebtree_stats_init_root(tree) _vebtree_stats_init_root(tree)
+
+void _vebtree_stats_begin(VebTree* tree)
+{
+    if (!vebtree_has_stats(tree)) return;
+    _vebtree_stats_op.stats = vebtree_root_stats(tree);
+    _vebtree_stats_op.visits = 0;
+    _vebtree_stats_op.leaf_hit = false;
+}
+
+void _vebtree_stats_end(VebTree* tree, int op)
+{
+    VebTreeStats* stats; uint32_t depth;
+    if (!vebtree_has_stats(tree)) return;
+
+    stats = vebtree_root_stats(tree);
+    depth = _vebtree_stats_op.visits < VEBTREE_STATS_MAX_DEPTH
+        ? _vebtree_stats_op.visits : VEBTREE_STATS_MAX_DEPTH - 1;
+    stats->calls[op]++;
+    stats->depth_histogram[op][depth]++;
+    if (_vebtree_stats_op.leaf_hit) stats->leaf_hits[op]++;
+    _vebtree_stats_op.stats = NULL;
+}
+
+void _vebtree_stats_alloc(size_t bytes)
+{
+    VebTreeStats* stats = _vebtree_stats_op.stats;
+    if (stats == NULL) return;
+
+    stats->allocations++;
+    stats->allocated_bytes += bytes;
+    if (stats->allocated_bytes > stats->peak_bytes)
+        stats->peak_bytes = stats->allocated_bytes;
+}
+
+void _vebtree_stats_free(size_t bytes)
+{
+    VebTreeStats* stats = _vebtree_stats_op.stats;
+    if (stats == NULL) return;
+
+    stats->frees++;
+    stats->allocated_bytes -= bytes;
+}
+
+void _vebtree_stats_init_root(VebTree* tree);
+
+#else
+
+#define VEBTREE_ROOT_BYTES sizeof(VebTree)
+#define vebtree_root_bytes(tree) sizeof(VebTree)
+#define vebtree_stats_visit() ((void)0)
+#define vebtree_stats_leaf_hit() ((void)0)
+#define vebtree_stats_begin(tree) ((void)0)
+#define vebtree_stats_end(tree, op) ((void)0)
+#define vebtree_stats_alloc(bytes) ((void)0)
+#define vebtree_stats_free(bytes) ((void)0)
+#define vebtree_stats_init_root(tree) ((void)0)
+
+#endif
+
+/* ===================================== *
+ *           V E B   C O R E
+ * ===================================== */
+
+#define vebtree_new_empty_node(uni_bits, lower_bits, flags) (VebTree){\
+    (uni_bits), (lower_bits), (uint8_t)((uni_bits) - (lower_bits)), (flags), 0, 0,\
+    VEBTREE_NODE_STATS_INIT {{vebtree_null, vebtree_null, {NULL}}}}
+
+/* TODO: remove those makros, copy the code to the location of usage */
+#define vebtree_lower_bits(uni_bits) ((uni_bits) >> 1) /* div by 2 */
+#define vebtree_upper_bits(uni_bits) ((uni_bits) - vebtree_lower_bits(uni_bits))
+
+#define vebtree_universe_maxvalue(uni_bits) ((vebkey_t)1 << (uni_bits))
+#define vebtree_universe_maxkey(uni_bits) ((uni_bits) >= 64 ? vebtree_null - 1\
+    : vebtree_universe_maxvalue(uni_bits) - 1)
+#define vebtree_local_address(key, local_bits) ((((vebkey_t)1 << (local_bits)) - 1) & (key))
+#define vebtree_global_address(key, local_bits) ((key) >> (local_bits))
+
+bool vebtree_is_empty(VebTree* tree)
+{
+    return vebtree_is_leaf(tree)
+        ? vebtree_bitwise_leaf_is_empty(tree->leaf)
+        : (tree)->low == vebtree_null;
+}
+
+vebkey_t vebtree_get_min(VebTree* tree)
+{
+    if (vebtree_is_empty(tree))
+        return vebtree_null;
+
+    return vebtree_is_leaf(tree)
+        ? vebtree_bitwise_leaf_get_min(tree->leaf) : tree->low;
+}
+
+vebkey_t vebtree_get_max(VebTree* tree)
+{
+    if (vebtree_is_empty(tree))
+        return vebtree_null;
+
+    return vebtree_is_leaf(tree)
+        ? vebtree_bitwise_leaf_get_max(tree->leaf) : tree->high;
+}
+
+uint8_t vebtree_required_universe_bits(vebkey_t max_key)
+{
+    assert(max_key != 0 && "universe has to consist of at least 2 keys");
+    return max_bit_set(max_key) == 0 ? 64 : max_bit_set(max_key) + 1;
+}
+
+void _init_subtrees(VebTree* tree, uint8_t flags);
+void _init_subtrees_sparse(VebTree* tree);
+VebTree* _vebtree_sparse_find(VebTree* tree, vebkey_t global_key);
+VebTree* _vebtree_sparse_insert(VebTree* tree, vebkey_t global_key);
+void _vebtree_sparse_remove(VebTree* tree, vebkey_t global_key);
+void _vebtree_cow_unshare(VebTree* tree);
+void _vebtree_clear(VebTree* tree);
+vebkey_t _vebtree_next_absent(VebTree* tree, vebkey_t key, bool claim);
+vebkey_t _vebtree_prev_absent(VebTree* tree, vebkey_t key);
+void _init_subtrees_arena(VebTree* tree, uint8_t flags, uint8_t** arena);
+void _free_subtrees(VebTree* tree);
+void _vebtree_init(VebTree* tree, uint8_t universe_bits, uint8_t flags, uint8_t allocator, bool is_memeff_root);
+void _vebtree_init_node(VebTree* tree, uint8_t universe_bits, uint8_t flags, bool is_memeff_root);
+size_t _vebtree_arena_size(uint8_t universe_bits, uint8_t lower_bits, uint8_t flags);
+
+/* whether the local of the given global key is empty, no matter whether it's a leaf cluster or a node */
+bool _vebtree_cluster_is_empty(VebTree* tree, vebkey_t global_key)
+{
+    VebTree* local;
+    if (vebtree_has_leaf_locals(tree))
+        return vebtree_bitwise_leaf_is_empty(vebtree_leaf_cluster(tree, global_key));
+
+    local = vebtree_cluster(tree, global_key);
+    return local == NULL || vebtree_is_empty(local);
+}
+
+vebkey_t _vebtree_cluster_min(VebTree* tree, vebkey_t global_key)
+{
+    VebTree* local;
+    if (vebtree_has_leaf_locals(tree))
+        return vebtree_bitwise_leaf_is_empty(vebtree_leaf_cluster(tree, global_key))
+            ? vebtree_null : vebtree_bitwise_leaf_get_min(vebtree_leaf_cluster(tree, global_key));
+
+    local = vebtree_cluster(tree, global_key);
+    return local != NULL ? vebtree_get_min(local) : vebtree_null;
+}
+
+vebkey_t _vebtree_cluster_max(VebTree* tree, vebkey_t global_key)
+{
+    VebTree* local;
+    if (vebtree_has_leaf_locals(tree))
+        return vebtree_bitwise_leaf_is_empty(vebtree_leaf_cluster(tree, global_key))
+            ? vebtree_null : vebtree_bitwise_leaf_get_max(vebtree_leaf_cluster(tree, global_key));
+
+    local = vebtree_cluster(tree, global_key);
+    return local != NULL ? vebtree_get_max(local) : vebtree_null;
+}
+
+bool _vebtree_insert_key(VebTree* tree, vebkey_t key);
+void _vebtree_delete_key(VebTree* tree, vebkey_t key);
+bool _vebtree_contains_key(VebTree* tree, vebkey_t key);
+
+/* only nodes holding both their universe's min. and max. key can be full, which rules out
+   most nodes before searching them for an absent key */
+#define vebtree_may_be_full(tree) \
+    ((tree)->low == 0 && (tree)->high == vebtree_universe_maxkey((tree)->universe_bits))
+
+bool _vebtree_is_full(VebTree* tree)
+{
+    VebTree* full;
+
+    if (vebtree_is_leaf(tree))
+        return vebtree_bitwise_leaf_is_full(tree->leaf, tree->universe_bits);
+    if (!vebtree_may_be_full(tree) || !vebtree_has_subtrees(tree))
+        return false;
+
+    /* the low is taken out of the first local, so all other locals need to be full */
+    if (vebtree_tracks_full(tree->flags)) {
+        full = vebtree_full_locals(tree);
+        if (vebtree_get_min(full) != 1 || vebtree_get_max(full) != vebtree_universe_maxkey(tree->upper_bits))
+            return false;
+    }
+    return _vebtree_next_absent(tree, 1, false) == vebtree_null;
+}
+
+bool _vebtree_cluster_is_full(VebTree* tree, vebkey_t global_key)
+{
+    return vebtree_has_leaf_locals(tree)
+        ? vebtree_bitwise_leaf_is_full(vebtree_leaf_cluster(tree, global_key), tree->lower_bits)
+        : _vebtree_is_full(&(tree->locals[global_key]));
+}
+
+/* add the local of the given global key to the full locals in case it got filled up */
+void _vebtree_mark_full(VebTree* tree, vebkey_t global_key)
+{
+    if (vebtree_tracks_full(tree->flags) && _vebtree_cluster_is_full(tree, global_key))
+        _vebtree_insert_key(vebtree_full_locals(tree), global_key);
+}
+
+/* drop the local of the given global key from the full locals after deleting keys from it */
+void _vebtree_unmark_full(VebTree* tree, vebkey_t global_key)
+{
+    VebTree* full;
+    if (!vebtree_tracks_full(tree->flags)) return;
+
+    full = vebtree_full_locals(tree);
+    if (!vebtree_is_empty(full) && _vebtree_contains_key(full, global_key))
+        _vebtree_delete_key(full, global_key);
+}
+
+void _vebtree_counts_clear(VebTree* tree)
+{
+    size_t i, num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    uint64_t* counts = vebtree_counts(tree);
+    for (i = 0; i < num_locals; i++) counts[i] = 0;
+}
+
+/* fenwick update, the 1-based entry i sums up the locals (i - lowbit(i), i] */
+void _vebtree_counts_add(VebTree* tree, vebkey_t global_key, uint64_t delta)
+{
+    vebkey_t i, num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    uint64_t* counts = vebtree_counts(tree);
+    for (i = global_key + 1; i <= num_locals; i += i & (~i + 1))
+        counts[i - 1] += delta;
+}
+
+/* amount of keys within the locals before the given local */
+uint64_t _vebtree_counts_prefix(VebTree* tree, vebkey_t global_key)
+{
+    vebkey_t i; uint64_t sum = 0; uint64_t* counts = vebtree_counts(tree);
+    for (i = global_key; i > 0; i -= i & (~i + 1))
+        sum += counts[i - 1];
+    return sum;
+}
+
+/* allocators registered by vebtree_init_with_allocator(), slot 0 stands for malloc() / free() */
+const VebAllocator* _vebtree_allocators[VEBTREE_MAX_ALLOCATORS + 1];
+
+uint8_t _vebtree_register_allocator(const VebAllocator* allocator)
+{
+    size_t slot;
+    if (allocator == NULL) return 0;
+
+    for (slot = 1; slot <= VEBTREE_MAX_ALLOCATORS && _vebtree_allocators[slot] != NULL; slot++)
+        if (_vebtree_allocators[slot] == allocator) return (uint8_t)slot;
+
+    assert(slot <= VEBTREE_MAX_ALLOCATORS && "too many distinct allocators, see VEBTREE_MAX_ALLOCATORS!");
+    _vebtree_allocators[slot] = allocator;
+    return (uint8_t)slot;
+}
+
+void* _vebtree_alloc(uint8_t allocator, size_t bytes)
+{
+    if (allocator == 0) return malloc(bytes);
+    return _vebtree_allocators[allocator]->alloc(_vebtree_allocators[allocator]->context, bytes);
+}
+
+void _vebtree_dealloc(uint8_t allocator, void* memory, size_t bytes)
+{
+    if (allocator == 0) free(memory);
+    else _vebtree_allocators[allocator]->free(_vebtree_allocators[allocator]->context, memory, bytes);
+}
+
+void vebtree_init(VebTree** new_tree, uint8_t universe_bits, uint8_t flags)
+{
+    vebtree_init_with_allocator(new_tree, universe_bits, flags, NULL);
+}
+
+void vebtree_init_with_allocator(VebTree** new_tree, uint8_t universe_bits, uint8_t flags,
+                                 const VebAllocator* allocator)
+{
+    VebTree root; uint8_t* arena; uint8_t allocator_slot;
+
+    assert((universe_bits > 0 && universe_bits <= 64)
+        && "invalid amount of universe bits, needs to be within [1, 64].");
+    assert(!((flags & VEBTREE_FLAG_SPARSE) && (flags & (VEBTREE_FLAG_ARENA | VEBTREE_FLAG_COUNTS)))
+        && "sparse trees allocate their clusters on demand, they cannot be arena or counting trees!");
+    assert(!((flags & VEBTREE_FLAG_ARENA) && (flags & (VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK)))
+        && "arena trees are fully allocated, they cannot be lazy or shrinking!");
+    assert(!((flags & VEBTREE_FLAG_COW) && (flags & (VEBTREE_FLAG_ARENA | VEBTREE_FLAG_MAPPED)))
+        && "copy-on-write trees need reference counted subtrees, they cannot be arena or mapped trees!");
+
+    /* sparse clusters only exist while holding keys */
+    if (flags & VEBTREE_FLAG_SPARSE) flags |= VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK;
+    allocator_slot = _vebtree_register_allocator(allocator);
+
+    /* allocate memory for the first tree, copy-on-write trees split their root evenly
+       as well, so copying its locals for a modified path doesn't copy the whole tree */
+    if (!(flags & VEBTREE_FLAG_ARENA)) {
+        *new_tree = (VebTree*)_vebtree_alloc(allocator_slot, VEBTREE_ROOT_BYTES);
+        assert(*new_tree != NULL && "tree allocation failed unexpectedly!");
+        _vebtree_init(*new_tree, universe_bits, flags, allocator_slot, !(flags & VEBTREE_FLAG_COW));
+        vebtree_stats_init_root(*new_tree);
+        return;
+    }
+
+    /* allocate the whole tree at once with the root at the arena's start */
+    _vebtree_init_node(&root, universe_bits, flags, true);
+    root.allocator = allocator_slot;
+    arena = (uint8_t*)_vebtree_alloc(allocator_slot,
+        VEBTREE_ROOT_BYTES + _vebtree_arena_size(universe_bits, root.lower_bits, flags));
+    assert(arena != NULL && "arena allocation failed unexpectedly!");
+
+    *new_tree = (VebTree*)arena;
+    **new_tree = root;
+    arena += VEBTREE_ROOT_BYTES;
+
+    if (!vebtree_is_leaf(*new_tree))
+        _init_subtrees_arena(*new_tree, flags, &arena);
+    vebtree_stats_init_root(*new_tree);
+}
+
+void _vebtree_init_node(VebTree* tree, uint8_t universe_bits, uint8_t flags, bool is_memeff_root)
+{
+    uint8_t lower_bits;
+
+    assert((universe_bits > 0 && universe_bits <= 64)
         && "invalid amount of universe bits, needs to be within [1, 64].");
 
     /* recursion anchor allocating a tree new leaf */
@@ -364,177 +1468,2299 @@ void _vebtree_init(VebTree* tree, uint8_t universe_bits, uint8_t flags, bool is_
 
     /* recursion case allocating a tree node */
     lower_bits = is_memeff_root ? VEBTREE_LEAF_BITS : vebtree_lower_bits(universe_bits);
+    if ((flags & VEBTREE_FLAG_LAZY) && !(flags & VEBTREE_FLAG_SPARSE)
+            && universe_bits - lower_bits > VEBTREE_LAZY_MAX_UPPER_BITS)
+        lower_bits = universe_bits - VEBTREE_LAZY_MAX_UPPER_BITS;
     *tree = vebtree_new_empty_node(universe_bits, lower_bits, flags);
+}
+
+void _vebtree_init(VebTree* tree, uint8_t universe_bits, uint8_t flags, uint8_t allocator, bool is_memeff_root)
+{
+    _vebtree_init_node(tree, universe_bits, flags, is_memeff_root);
+    tree->allocator = allocator;
 
     /* don't allocate the whole tree upfront in case of lazy allocation */
-    if (vebtree_is_lazy(tree)) return;
+    if (vebtree_is_leaf(tree) || vebtree_is_lazy(tree)) return;
 
     /* fully allocate the tree recursively */
     _init_subtrees(tree, flags);
 
-    assert(tree->global != NULL && "global tree init failed unexpectedly!");
-    assert(tree->locals != NULL && "locals tree init failed unexpectedly!");
+    assert(tree->locals != NULL && "subtrees init failed unexpectedly!");
+}
+
+/* allocate a global + locals block, returning the global */
+VebTree* _vebtree_block_alloc(size_t bytes, uint8_t flags, uint8_t allocator)
+{
+    uint8_t* block;
+
+    block = (uint8_t*)_vebtree_alloc(allocator, vebtree_block_header(flags) + bytes);
+    assert(block != NULL && "subtrees allocation failed unexpectedly!");
+    vebtree_stats_alloc(vebtree_block_header(flags) + bytes);
+    if (flags & VEBTREE_FLAG_COW) *(uint64_t*)block = 1;
+    return (VebTree*)(block + vebtree_block_header(flags));
+}
+
+void _vebtree_block_free(VebTree* global, size_t bytes, uint8_t flags, uint8_t allocator)
+{
+    _vebtree_dealloc(allocator, (uint8_t*)global - vebtree_block_header(flags), vebtree_block_header(flags) + bytes);
+    vebtree_stats_free(vebtree_block_header(flags) + bytes);
 }
 
 void _init_subtrees(VebTree* tree, uint8_t flags)
 {
-    size_t i, num_locals;
+    size_t i, num_locals; VebTree* subtrees;
+
+    if (flags & VEBTREE_FLAG_SPARSE) {
+        _init_subtrees_sparse(tree);
+        return;
+    }
 
     /* determine the sizes of global / locals */
     num_locals = vebtree_universe_maxvalue(tree->upper_bits);
 
-    /* init global recursively */
-    tree->global = (VebTree*)malloc(sizeof(VebTree));
-    _vebtree_init(tree->global, tree->upper_bits, flags, false);
+    /* allocate the global right in front of the locals */
+    subtrees = _vebtree_block_alloc(vebtree_subtrees_bytes(tree->upper_bits, tree->lower_bits, flags),
+        flags, tree->allocator);
+    tree->locals = subtrees + 1;
+
+    /* init global recursively, the full locals allocate their subtrees once the first local is full */
+    _vebtree_init(subtrees, tree->upper_bits, vebtree_global_flags(flags), tree->allocator, false);
+    if (vebtree_tracks_full(flags))
+        _vebtree_init_node(vebtree_full_locals(tree), tree->upper_bits, flags, false);
+
+    /* init locals recursively, leaf clusters just need to be cleared */
+    if (vebtree_local_is_leaf(tree->lower_bits, flags))
+        memset(tree->locals, 0, num_locals * VEBTREE_LEAF_BYTES);
+    else
+        for (i = 0; i < num_locals; i++)
+            _vebtree_init(tree->locals + i, tree->lower_bits, flags, tree->allocator, false);
+    if (flags & VEBTREE_FLAG_COUNTS) _vebtree_counts_clear(tree);
+}
 
-    /* init locals recursively */
-    tree->locals = (VebTree*)malloc(num_locals * sizeof(VebTree));
-    for (i = 0; i < num_locals; i++)
-        _vebtree_init(tree->locals + i, tree->lower_bits, flags, false);
+size_t _vebtree_arena_size(uint8_t universe_bits, uint8_t lower_bits, uint8_t flags)
+{
+    uint8_t upper_bits; size_t num_locals;
+
+    /* recursion anchor for tree leafs without any subtrees */
+    if (universe_bits <= VEBTREE_LEAF_BITS)
+        return 0;
+
+    /* the node's global + locals, followed by all their subtrees (the full locals' ones behind the global's) */
+    upper_bits = universe_bits - lower_bits;
+    num_locals = vebtree_universe_maxvalue(upper_bits);
+    return vebtree_subtrees_bytes(upper_bits, lower_bits, flags)
+        + _vebtree_arena_size(upper_bits, vebtree_lower_bits(upper_bits), vebtree_global_flags(flags))
+        * (vebtree_tracks_full(flags) ? 2 : 1)
+        + num_locals * _vebtree_arena_size(lower_bits, vebtree_lower_bits(lower_bits), flags);
 }
 
-void vebtree_free(VebTree* tree)
+void _init_subtrees_arena(VebTree* tree, uint8_t flags, uint8_t** arena)
 {
-    size_t i; vebkey_t num_locals;
+    size_t i, num_locals;
 
-    /* recursion anchor for tree leafs */
-    if (vebtree_is_leaf(tree))
+    /* place the global right in front of its locals */
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    tree->locals = (VebTree*)*arena + 1;
+    *arena += vebtree_subtrees_bytes(tree->upper_bits, tree->lower_bits, flags);
+
+    _vebtree_init_node(vebtree_owned_global(tree), tree->upper_bits, vebtree_global_flags(flags), false);
+    if (flags & VEBTREE_FLAG_COUNTS) _vebtree_counts_clear(tree);
+    if (vebtree_tracks_full(flags)) _vebtree_init_node(vebtree_full_locals(tree), tree->upper_bits, flags, false);
+
+    /* leaf clusters don't have any subtrees to lay out */
+    if (vebtree_local_is_leaf(tree->lower_bits, flags))
+        memset(tree->locals, 0, num_locals * VEBTREE_LEAF_BYTES);
+    else
+        for (i = 0; i < num_locals; i++)
+            _vebtree_init_node(tree->locals + i, tree->lower_bits, flags, false);
+
+    /* lay out the subtrees recursively behind them (depth-first) */
+    if (!vebtree_is_leaf(vebtree_owned_global(tree)))
+        _init_subtrees_arena(vebtree_owned_global(tree), vebtree_global_flags(flags), arena);
+    if (vebtree_tracks_full(flags) && !vebtree_is_leaf(vebtree_full_locals(tree)))
+        _init_subtrees_arena(vebtree_full_locals(tree), flags, arena);
+
+    if (!vebtree_local_is_leaf(tree->lower_bits, flags))
+        for (i = 0; i < num_locals; i++)
+            _init_subtrees_arena(tree->locals + i, flags, arena);
+}
+
+void _free_subtrees(VebTree* tree)
+{
+    size_t i, num_slots;
+
+    /* recursion anchor for tree leafs and lazy nodes without subtrees */
+    if (vebtree_is_leaf(tree) || !vebtree_has_subtrees(tree))
         return;
 
+    /* copy-on-write blocks are released by the last node referring to them */
+    if (vebtree_is_cow(tree) && vebtree_atomic_add(vebtree_refcount(tree), -1) > 0) {
+        tree->locals = NULL;
+        return;
+    }
+
     /* recursion case for child trees */
-    vebtree_free(tree->global);
-    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
-    for (i = 0; i < num_locals; i++)
-        vebtree_free(&(tree->locals[i]));
+    _free_subtrees(vebtree_owned_global(tree));
+    if (vebtree_tracks_full(tree->flags)) _free_subtrees(vebtree_full_locals(tree));
+    num_slots = vebtree_has_leaf_locals(tree) ? 0 : vebtree_num_slots(tree);
+    for (i = 0; i < num_slots; i++)
+        if (vebtree_slot_used(tree, i))
+            _free_subtrees(&(tree->locals[i]));
 
     /* local memory deallocation */
-    free(tree->global);
-    free(tree->locals);
-    tree->global = NULL;
+    _vebtree_block_free(vebtree_owned_global(tree), vebtree_block_bytes(tree), tree->flags, tree->allocator);
     tree->locals = NULL;
 }
 
-bool vebtree_contains_key(VebTree* tree, vebkey_t key)
+void vebtree_free(VebTree* tree)
 {
-    vebkey_t local_key, global_key;
-    assert(key != vebtree_null && "cannot check for vebtree_null, invalid key!");
+    assert(!vebtree_is_mapped(tree) && "mapped trees need to be closed by vebtree_close_mmap()!");
+
+    /* arena trees are released at once as the root sits at the arena's start */
+    if (!vebtree_is_arena(tree)) {
+        _free_subtrees(tree);
+        _vebtree_dealloc(tree->allocator, tree, VEBTREE_ROOT_BYTES);
+        return;
+    }
+    _vebtree_dealloc(tree->allocator, tree,
+        VEBTREE_ROOT_BYTES + _vebtree_arena_size(tree->universe_bits, tree->lower_bits, tree->flags));
+}
+
+bool _vebtree_contains_key(VebTree* tree, vebkey_t key)
+{
+    vebkey_t local_key, global_key; VebTree* local;
+    vebtree_stats_visit();
 
     /* base case: encountered tree leaf */
-    if (vebtree_is_leaf(tree))
-        return vebtree_bitwise_leaf_contains_key(tree, key);
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_contains_key(tree->leaf, key);
+    }
 
     /* base case: check if key is low (low is not part of any subtree) */
     if (tree->low == key || tree->high == key)
         return true;
 
-    /* base case: stop recursion when tree is empty */
-    if (vebtree_is_empty(tree))
+    /* base case: stop recursion when tree is empty or has no lazy subtrees yet */
+    if (vebtree_is_empty(tree) || !vebtree_has_subtrees(tree))
         return false;
 
-    /* local subtree exists and the key is part of it (recursion case) */
-    assert(tree->global != NULL && tree->locals != NULL);
+    /* the key is part of its local (recursion case), an empty local
+       can't contain it, so the global doesn't need to be checked */
     local_key = vebtree_local_address(key, tree->lower_bits);
     global_key = vebtree_global_address(key, tree->lower_bits);
 
-    return vebtree_contains_key(tree->global, global_key) &&
-           vebtree_contains_key(&(tree->locals[global_key]), local_key);
+    if (vebtree_has_leaf_locals(tree)) {
+        vebtree_stats_visit();
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_contains_key(vebtree_leaf_cluster(tree, global_key), local_key);
+    }
+
+    local = vebtree_cluster(tree, global_key);
+    return local != NULL && _vebtree_contains_key(local, local_key);
 }
 
-vebkey_t vebtree_successor(VebTree* tree, vebkey_t key)
+bool vebtree_contains_key(VebTree* tree, vebkey_t key)
+{
+    bool contained;
+    assert(key != vebtree_null && "cannot check for vebtree_null, invalid key!");
+
+    vebtree_stats_begin(tree);
+    contained = _vebtree_contains_key(tree, key);
+    vebtree_stats_end(tree, VEBTREE_OP_CONTAINS);
+    return contained;
+}
+
+vebkey_t _vebtree_successor(VebTree* tree, vebkey_t key)
 {
-    vebkey_t global_key, local_key, global_succ;
+    vebkey_t global_key, local_key, global_succ, local_max;
+    vebtree_stats_visit();
 
     /* base case for tree leafs */
-    if (vebtree_is_leaf(tree))
-        return vebtree_bitwise_leaf_successor(tree, key);
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_successor(tree->leaf, key);
+    }
 
     /* base case for predecessor in neighbour local -> low is the successor */
     if (tree->low != vebtree_null && key < tree->low)
         return tree->low;
 
+    /* base case for lazy nodes only holding the low key */
+    if (!vebtree_has_subtrees(tree))
+        return vebtree_null;
+
     local_key = vebtree_local_address(key, tree->lower_bits);
     global_key = vebtree_global_address(key, tree->lower_bits);
 
     /* case where a local contains the successor */
-    if (vebtree_get_max(&(tree->locals[global_key])) != vebtree_null &&
-            local_key < vebtree_get_max(&(tree->locals[global_key])))
-        return (global_key << tree->lower_bits) |
-            (vebtree_successor(&(tree->locals[global_key]), local_key));
+    local_max = _vebtree_cluster_max(tree, global_key);
+    if (local_max != vebtree_null && local_key < local_max) {
+        if (!vebtree_has_leaf_locals(tree))
+            return (global_key << tree->lower_bits)
+                | _vebtree_successor(vebtree_cluster(tree, global_key), local_key);
+        vebtree_stats_visit();
+        vebtree_stats_leaf_hit();
+        return (global_key << tree->lower_bits)
+            | vebtree_bitwise_leaf_successor(vebtree_leaf_cluster(tree, global_key), local_key);
+    }
 
     /* case where a neighbour contains the successor */
-    global_succ = vebtree_successor(tree->global, global_key);
+    global_succ = _vebtree_successor(vebtree_global(tree), global_key);
     return global_succ == vebtree_null ? vebtree_null
-        : (global_succ << tree->lower_bits) | vebtree_get_min(&(tree->locals[global_succ]));
+        : (global_succ << tree->lower_bits) | _vebtree_cluster_min(tree, global_succ);
 }
 
-vebkey_t vebtree_predecessor(VebTree* tree, vebkey_t key)
+vebkey_t vebtree_successor(VebTree* tree, vebkey_t key)
 {
-    /* TODO: implement this analog to the successor function */
-    assert(false && "this operation is currently not supported");
-    return vebtree_null;
+    vebkey_t succ;
+
+    vebtree_stats_begin(tree);
+    succ = _vebtree_successor(tree, key);
+    vebtree_stats_end(tree, VEBTREE_OP_SUCCESSOR);
+    return succ;
 }
 
-void vebtree_insert_key(VebTree* tree, vebkey_t key)
+vebkey_t _vebtree_predecessor(VebTree* tree, vebkey_t key)
 {
-    vebkey_t global_key, local_key, temp;
-    assert(key != vebtree_null && "cannot insert vebtree_null, invalid key!");
+    vebkey_t global_key, local_key, global_pred, local_min;
+    vebtree_stats_visit();
 
     /* base case for tree leafs */
-    if (vebtree_is_leaf(tree)) { vebtree_bitwise_leaf_insert_key(tree, key); return; }
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_predecessor(tree->leaf, key);
+    }
 
-    /* base case when tree is empty */
-    if (vebtree_is_empty(tree)) { tree->low = tree->high = key; return; }
+    /* base case for successor in neighbour local -> high is the predecessor */
+    if (tree->high != vebtree_null && key > tree->high)
+        return tree->high;
 
-    /* case when the key becomes the new low -> insert old low instead */
-    if (key < tree->low) { temp = tree->low; tree->low = key; key = temp; }
+    /* base case for lazy nodes only holding the low key */
+    if (!vebtree_has_subtrees(tree))
+        return vebtree_null;
 
     local_key = vebtree_local_address(key, tree->lower_bits);
     global_key = vebtree_global_address(key, tree->lower_bits);
 
-    /* insert the global key if the corresponding local is empty */
-    if (vebtree_is_empty(&(tree->locals[global_key])))
-        vebtree_insert_key(tree->global, global_key);
+    /* case where a local contains the predecessor */
+    local_min = _vebtree_cluster_min(tree, global_key);
+    if (local_min != vebtree_null && local_key > local_min) {
+        if (!vebtree_has_leaf_locals(tree))
+            return (global_key << tree->lower_bits)
+                | _vebtree_predecessor(vebtree_cluster(tree, global_key), local_key);
+        vebtree_stats_visit();
+        vebtree_stats_leaf_hit();
+        return (global_key << tree->lower_bits)
+            | vebtree_bitwise_leaf_predecessor(vebtree_leaf_cluster(tree, global_key), local_key);
+    }
 
-    /* insert the local key into local scope */
-    vebtree_insert_key(&(tree->locals[global_key]), local_key);
+    /* case where a neighbour contains the predecessor, otherwise it's the low */
+    global_pred = _vebtree_predecessor(vebtree_global(tree), global_key);
+    if (global_pred == vebtree_null)
+        return tree->low != vebtree_null && key > tree->low ? tree->low : vebtree_null;
+    return (global_pred << tree->lower_bits) | _vebtree_cluster_max(tree, global_pred);
+}
 
-    /* update the tree's high */
-    tree->high = tree->high > key ? tree->high : key;
+vebkey_t vebtree_predecessor(VebTree* tree, vebkey_t key)
+{
+    vebkey_t pred;
+
+    vebtree_stats_begin(tree);
+    pred = _vebtree_predecessor(tree, key);
+    vebtree_stats_end(tree, VEBTREE_OP_PREDECESSOR);
+    return pred;
 }
 
-void vebtree_delete_key(VebTree* tree, vebkey_t key)
+/* insert the key, returning whether it wasn't part of the tree yet (needed for the counts) */
+bool _vebtree_insert_key(VebTree* tree, vebkey_t key)
 {
-    vebkey_t global_key, local_key, global_high, global_low;
-    assert(key != vebtree_null && "cannot delete vebtree_null, invalid key!");
+    vebkey_t global_key, local_key, temp; VebTree* local; bitboard_t* leaf; bool inserted;
+    vebtree_stats_visit();
 
     /* base case for tree leafs */
-    if (vebtree_is_leaf(tree)) { vebtree_bitwise_leaf_delete_key(tree, key); return; }
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        inserted = !vebtree_bitwise_leaf_contains_key(tree->leaf, key);
+        vebtree_bitwise_leaf_insert_key(tree->leaf, key);
+        return inserted;
+    }
+
+    /* base case when tree is empty */
+    if (vebtree_is_empty(tree)) { tree->low = tree->high = key; return true; }
+
+    /* base case when the key is already the low (low is not part of any subtree) */
+    if (key == tree->low) return false;
+
+    /* case when the key becomes the new low -> insert old low instead */
+    if (key < tree->low) { temp = tree->low; tree->low = key; key = temp; }
+
+    /* lazy nodes allocate their subtrees once the first key is pushed down,
+       copy-on-write nodes copy their subtrees block if it's still shared */
+    if (!vebtree_has_subtrees(tree)) _init_subtrees(tree, tree->flags);
+    else if (vebtree_is_cow(tree)) _vebtree_cow_unshare(tree);
+
+    local_key = vebtree_local_address(key, tree->lower_bits);
+    global_key = vebtree_global_address(key, tree->lower_bits);
+
+    /* insert the global key if the corresponding local is empty, sparse
+       nodes add the local to their table once it gets its first key */
+    if (_vebtree_cluster_is_empty(tree, global_key))
+        _vebtree_insert_key(vebtree_owned_global(tree), global_key);
+
+    /* insert the local key into local scope */
+    if (vebtree_has_leaf_locals(tree)) {
+        vebtree_stats_visit();
+        vebtree_stats_leaf_hit();
+        leaf = vebtree_leaf_cluster(tree, global_key);
+        inserted = !vebtree_bitwise_leaf_contains_key(leaf, local_key);
+        vebtree_bitwise_leaf_insert_key(leaf, local_key);
+    } else {
+        local = vebtree_cluster(tree, global_key);
+        if (local == NULL) local = _vebtree_sparse_insert(tree, global_key);
+        inserted = _vebtree_insert_key(local, local_key);
+    }
+    if (inserted && vebtree_is_counting(tree))
+        _vebtree_counts_add(tree, global_key, 1);
+    if (inserted) _vebtree_mark_full(tree, global_key);
+
+    /* update the tree's high */
+    tree->high = tree->high > key ? tree->high : key;
+    return inserted;
+}
+
+void vebtree_insert_key(VebTree* tree, vebkey_t key)
+{
+    assert(key != vebtree_null && "cannot insert vebtree_null, invalid key!");
+    assert(!vebtree_is_mapped(tree) && "cannot modify a mapped tree, it's read-only!");
+
+    vebtree_stats_begin(tree);
+    _vebtree_insert_key(tree, key);
+    vebtree_stats_end(tree, VEBTREE_OP_INSERT);
+}
+
+void _vebtree_delete_key(VebTree* tree, vebkey_t key)
+{
+    vebkey_t global_key, local_key, global_high, global_low; VebTree* local; bool was_full;
+    vebtree_stats_visit();
+
+    /* base case for tree leafs */
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        vebtree_bitwise_leaf_delete_key(tree->leaf, key);
+        return;
+    }
 
     /* base case with only one element -> set low and high to null */
     if (tree->low == tree->high) { tree->low = tree->high = vebtree_null; return; }
+    if (vebtree_is_cow(tree)) _vebtree_cow_unshare(tree);
 
     /* case when deleting the low element -> new low needs to be pulled out */
     if (key == tree->low) {
-        global_low = vebtree_get_min(tree->global);
-        tree->low = key = (global_low << tree->lower_bits)
-            | vebtree_get_min(&(tree->locals[global_low]));
+        global_low = vebtree_get_min(vebtree_owned_global(tree));
+        tree->low = key = (global_low << tree->lower_bits) | _vebtree_cluster_min(tree, global_low);
     }
 
     global_key = vebtree_global_address(key, tree->lower_bits);
     local_key = vebtree_local_address(key, tree->lower_bits);
 
-    /* delete the local key recursively */
-    vebtree_delete_key(&(tree->locals[global_key]), local_key);
-
-    if (vebtree_is_empty(&(tree->locals[global_key])))
-        vebtree_delete_key(tree->global, global_key);
+    /* delete the local key recursively, sparse nodes don't
+       have locals for keys that aren't part of the tree */
+    if (vebtree_has_leaf_locals(tree)) {
+        vebtree_stats_visit();
+        vebtree_stats_leaf_hit();
+        was_full = vebtree_bitwise_leaf_is_full(vebtree_leaf_cluster(tree, global_key), tree->lower_bits);
+        vebtree_bitwise_leaf_delete_key(vebtree_leaf_cluster(tree, global_key), local_key);
+    } else {
+        local = vebtree_cluster(tree, global_key);
+        if (local == NULL) return;
+        was_full = vebtree_may_be_full(local);
+        _vebtree_delete_key(local, local_key);
+    }
+    if (vebtree_is_counting(tree))
+        _vebtree_counts_add(tree, global_key, (uint64_t)-1);
+    if (was_full) _vebtree_unmark_full(tree, global_key);
+
+    /* sparse nodes drop their empty locals from the table */
+    if (_vebtree_cluster_is_empty(tree, global_key)) {
+        _vebtree_delete_key(vebtree_owned_global(tree), global_key);
+        if (vebtree_is_sparse(tree)) _vebtree_sparse_remove(tree, global_key);
+    }
 
     /* in case the maximum was deleted -> find new maximum */
     if (key == tree->high) {
-        global_high = vebtree_get_max(tree->global);
+        global_high = vebtree_get_max(vebtree_owned_global(tree));
         tree->high = global_high == vebtree_null ? tree->low
-            : (global_high << tree->lower_bits) | vebtree_get_max(&(tree->locals[global_high]));
+            : (global_high << tree->lower_bits) | _vebtree_cluster_max(tree, global_high);
+    }
+
+    /* release the lazy subtrees again once they ran empty */
+    if (vebtree_is_shrinking(tree) && !vebtree_is_arena(tree) && vebtree_is_empty(vebtree_owned_global(tree)))
+        _free_subtrees(tree);
+}
+
+void vebtree_delete_key(VebTree* tree, vebkey_t key)
+{
+    assert(key != vebtree_null && "cannot delete vebtree_null, invalid key!");
+    assert(!vebtree_is_mapped(tree) && "cannot modify a mapped tree, it's read-only!");
+
+    vebtree_stats_begin(tree);
+    _vebtree_delete_key(tree, key);
+    vebtree_stats_end(tree, VEBTREE_OP_DELETE);
+}
+
+/* ===================================== *
+ *      S P A R S E   C L U S T E R S
+ * ===================================== */
+
+/* allocate an empty table of 2^table_bits slots behind the global (the global is left uninitialized) */
+VebTree* _vebtree_sparse_alloc(VebTree* tree, uint8_t table_bits)
+{
+    size_t i; VebTree* subtrees;
+
+    subtrees = _vebtree_block_alloc(vebtree_sparse_bytes(table_bits), tree->flags, tree->allocator);
+    tree->locals = subtrees + 1;
+    tree->table_bits = table_bits;
+
+    for (i = 0; i < vebtree_sparse_slots(tree); i++)
+        vebtree_sparse_keys(tree)[i] = vebtree_null;
+    vebtree_sparse_used(tree) = 0;
+    return subtrees;
+}
+
+void _init_subtrees_sparse(VebTree* tree)
+{
+    VebTree* global = _vebtree_sparse_alloc(tree, VEBTREE_SPARSE_MIN_TABLE_BITS);
+    _vebtree_init(global, tree->upper_bits, vebtree_global_flags(tree->flags), tree->allocator, false);
+}
+
+/* linear probing from the key's home slot, ending at the key's slot or at a free slot */
+size_t _vebtree_sparse_slot(VebTree* tree, vebkey_t global_key)
+{
+    vebkey_t* keys = vebtree_sparse_keys(tree); size_t mask = vebtree_sparse_slots(tree) - 1;
+    size_t slot = vebtree_sparse_hash(global_key, tree->table_bits);
+
+    while (keys[slot] != vebtree_null && keys[slot] != global_key)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+VebTree* _vebtree_sparse_find(VebTree* tree, vebkey_t global_key)
+{
+    size_t slot = _vebtree_sparse_slot(tree, global_key);
+    return vebtree_sparse_keys(tree)[slot] == vebtree_null ? NULL : tree->locals + slot;
+}
+
+/* move the global and the locals into a new table, the nodes don't refer
+   to their own position, so they can be copied as they are */
+void _vebtree_sparse_resize(VebTree* tree, uint8_t table_bits)
+{
+    VebTree *old_locals = tree->locals, *global; vebkey_t *old_keys = vebtree_sparse_keys(tree), used;
+    uint8_t old_bits = tree->table_bits; size_t i, slot, old_slots = (size_t)1 << old_bits;
+
+    used = vebtree_sparse_used(tree);
+    global = _vebtree_sparse_alloc(tree, table_bits);
+    *global = old_locals[-1];
+
+    for (i = 0; i < old_slots; i++) {
+        if (old_keys[i] == vebtree_null) continue;
+        slot = _vebtree_sparse_slot(tree, old_keys[i]);
+        vebtree_sparse_keys(tree)[slot] = old_keys[i];
+        tree->locals[slot] = old_locals[i];
+    }
+
+    vebtree_sparse_used(tree) = used;
+    _vebtree_block_free(old_locals - 1, vebtree_sparse_bytes(old_bits), tree->flags, tree->allocator);
+}
+
+/* add an empty local for the given global key, growing the table beyond 3/4 load */
+VebTree* _vebtree_sparse_insert(VebTree* tree, vebkey_t global_key)
+{
+    size_t slot;
+
+    if ((vebtree_sparse_used(tree) + 1) * 4 > vebtree_sparse_slots(tree) * 3)
+        _vebtree_sparse_resize(tree, tree->table_bits + 1);
+
+    slot = _vebtree_sparse_slot(tree, global_key);
+    vebtree_sparse_keys(tree)[slot] = global_key;
+    vebtree_sparse_used(tree)++;
+    _vebtree_init(tree->locals + slot, tree->lower_bits, tree->flags, tree->allocator, false);
+    return tree->locals + slot;
+}
+
+/* remove the empty local of the given global key, shrinking the table below 1/8 load; the
+   following entries of the probe sequence are shifted back, so no tombstones are needed */
+void _vebtree_sparse_remove(VebTree* tree, vebkey_t global_key)
+{
+    vebkey_t* keys = vebtree_sparse_keys(tree); size_t mask = vebtree_sparse_slots(tree) - 1;
+    size_t hole = _vebtree_sparse_slot(tree, global_key), slot, home;
+
+    _free_subtrees(tree->locals + hole);
+    for (slot = (hole + 1) & mask; keys[slot] != vebtree_null; slot = (slot + 1) & mask) {
+        /* entries can only move back as long as they don't pass their home slot */
+        home = vebtree_sparse_hash(keys[slot], tree->table_bits);
+        if (((slot - home) & mask) < ((slot - hole) & mask)) continue;
+
+        keys[hole] = keys[slot];
+        tree->locals[hole] = tree->locals[slot];
+        hole = slot;
+    }
+
+    keys[hole] = vebtree_null;
+    vebtree_sparse_used(tree)--;
+
+    if (vebtree_sparse_used(tree) > 0 && vebtree_sparse_used(tree) * 8 < vebtree_sparse_slots(tree)
+            && tree->table_bits > VEBTREE_SPARSE_MIN_TABLE_BITS)
+        _vebtree_sparse_resize(tree, tree->table_bits - 1);
+}
+
+/* ===================================== *
+ *       C O P Y   O N   W R I T E
+ * ===================================== */
+
+void _vebtree_cow_retain(VebTree* tree)
+{
+    if (!vebtree_is_leaf(tree) && vebtree_has_subtrees(tree))
+        vebtree_atomic_add(vebtree_refcount(tree), 1);
+}
+
+/* give the node a block of its own before modifying it, the copy's nodes
+   refer to the same subtrees as the shared block, so only the path is copied */
+void _vebtree_cow_unshare(VebTree* tree)
+{
+    size_t i, num_slots, bytes; VebTree *shared, *copy;
+    if (vebtree_atomic_load(vebtree_refcount(tree)) == 1) return;
+
+    shared = vebtree_owned_global(tree);
+    bytes = vebtree_block_bytes(tree);
+    copy = _vebtree_block_alloc(bytes, tree->flags, tree->allocator);
+    memcpy(copy, shared, bytes);
+
+    _vebtree_cow_retain(copy);
+    num_slots = vebtree_has_leaf_locals(tree) ? 0 : vebtree_num_slots(tree);
+    for (i = 0; i < num_slots; i++)
+        if (vebtree_slot_used(tree, i))
+            _vebtree_cow_retain(copy + 1 + i);
+    if (vebtree_tracks_full(tree->flags))
+        _vebtree_cow_retain((VebTree*)((uint8_t*)copy + ((uint8_t*)vebtree_full_locals(tree) - (uint8_t*)shared)));
+
+    /* drop the reference to the shared block, it's released in case the other owners are gone */
+    _free_subtrees(tree);
+    tree->locals = copy + 1;
+}
+
+VebTree* vebtree_snapshot(VebTree* tree)
+{
+    VebTree* snapshot;
+    assert((vebtree_is_cow(tree) || vebtree_is_leaf(tree))
+        && "only trees created with VEBTREE_FLAG_COW can be snapshotted!");
+
+    snapshot = (VebTree*)_vebtree_alloc(tree->allocator, VEBTREE_ROOT_BYTES);
+    assert(snapshot != NULL && "snapshot allocation failed unexpectedly!");
+    *snapshot = *tree;
+    _vebtree_cow_retain(snapshot);
+    vebtree_stats_init_root(snapshot);
+    return snapshot;
+}
+
+/* ===================================== *
+ *        B U L K   I N S E R T
+ * ===================================== */
+
+/* upper bound of scratch keys required to build the given empty subtree from sorted keys */
+size_t _vebtree_bulk_scratch_size(const VebTree* tree, size_t num_keys)
+{
+    VebTree global, local; size_t num_globals, num_local_keys, global_size, local_size;
+
+    if (vebtree_is_leaf(tree) || num_keys == 0)
+        return 0;
+
+    /* the global's keys are collected in scratch space while building the locals */
+    num_globals = vebtree_universe_maxvalue(tree->upper_bits);
+    num_globals = num_globals < num_keys ? num_globals : num_keys;
+    _vebtree_init_node(&global, tree->upper_bits, tree->flags, false);
+    global_size = _vebtree_bulk_scratch_size(&global, num_globals);
+
+    num_local_keys = vebtree_universe_maxvalue(tree->lower_bits);
+    num_local_keys = num_local_keys < num_keys ? num_local_keys : num_keys;
+    _vebtree_init_node(&local, tree->lower_bits, tree->flags, false);
+    local_size = _vebtree_bulk_scratch_size(&local, num_local_keys);
+
+    return num_globals + (global_size > local_size ? global_size : local_size);
+}
+
+void _vebtree_build_sorted(VebTree* tree, const vebkey_t keys[], size_t num_keys,
+                           uint8_t shift, vebkey_t scratch[])
+{
+    size_t i, j, first_sub, num_globals; vebkey_t mask, global_key;
+
+    if (num_keys == 0) return;
+
+    /* the keys are seen through the bit window [shift, shift + universe_bits) */
+    mask = tree->universe_bits >= 64 ? vebtree_null
+        : vebtree_local_address(vebtree_null, tree->universe_bits);
+    #define bulk_key(i) ((keys[i] >> shift) & mask)
+
+    /* base case for tree leafs -> set all bits at once */
+    if (vebtree_is_leaf(tree)) {
+        for (i = 0; i < num_keys; i++)
+            vebtree_bitwise_leaf_insert_key(tree->leaf, bulk_key(i));
+        return;
+    }
+
+    /* the smallest key becomes the low (not part of any subtree), the greatest the high */
+    tree->low = bulk_key(0);
+    tree->high = bulk_key(num_keys - 1);
+    for (first_sub = 1; first_sub < num_keys && bulk_key(first_sub) == tree->low; first_sub++);
+    if (first_sub == num_keys) return;
+
+    if (!vebtree_has_subtrees(tree)) _init_subtrees(tree, tree->flags);
+
+    /* build each local from the run of keys sharing its global address,
+       collecting the distinct global addresses as the global's keys */
+    for (i = first_sub, num_globals = 0; i < num_keys; i = j) {
+        global_key = vebtree_global_address(bulk_key(i), tree->lower_bits);
+        for (j = i + 1; j < num_keys
+            && vebtree_global_address(bulk_key(j), tree->lower_bits) == global_key; j++);
+
+        scratch[num_globals++] = global_key;
+        if (vebtree_has_leaf_locals(tree))
+            for (; i < j; i++)
+                vebtree_bitwise_leaf_insert_key(vebtree_leaf_cluster(tree, global_key),
+                    vebtree_local_address(bulk_key(i), tree->lower_bits));
+        else
+            _vebtree_build_sorted(&(tree->locals[global_key]),
+                keys + i, j - i, shift, scratch + num_globals);
+        _vebtree_mark_full(tree, global_key);
+    }
+
+    _vebtree_build_sorted(vebtree_owned_global(tree), scratch, num_globals, 0, scratch + num_globals);
+    #undef bulk_key
+}
+
+/* finish a node whose keys all went into the locals, the keys buffer serves as temp space */
+void _vebtree_build_from_locals(VebTree* tree, vebkey_t keys[], vebkey_t scratch[])
+{
+    size_t i, num_locals, num_globals; vebkey_t global_low, global_high;
+
+    /* collect the non-empty locals as the global's keys */
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    for (i = 0, num_globals = 0; i < num_locals; i++) {
+        if (_vebtree_cluster_is_empty(tree, i)) continue;
+        keys[num_globals++] = i;
+        _vebtree_mark_full(tree, i);
+    }
+
+    /* pull the smallest key out of the locals as it becomes the low */
+    global_low = keys[0];
+    tree->low = (global_low << tree->lower_bits) | _vebtree_cluster_min(tree, global_low);
+    if (vebtree_has_leaf_locals(tree))
+        vebtree_bitwise_leaf_delete_key(vebtree_leaf_cluster(tree, global_low),
+            vebtree_local_address(tree->low, tree->lower_bits));
+    else
+        vebtree_delete_key(&(tree->locals[global_low]), vebtree_local_address(tree->low, tree->lower_bits));
+    _vebtree_unmark_full(tree, global_low);
+    if (_vebtree_cluster_is_empty(tree, global_low)) { keys++; num_globals--; }
+
+    global_high = num_globals > 0 ? keys[num_globals - 1] : vebtree_null;
+    tree->high = global_high == vebtree_null ? tree->low
+        : (global_high << tree->lower_bits) | _vebtree_cluster_max(tree, global_high);
+    _vebtree_build_sorted(vebtree_owned_global(tree), keys, num_globals, 0, scratch);
+}
+
+void _vebtree_build_unsorted(VebTree* tree, vebkey_t keys[], vebkey_t temp[],
+                             size_t num_keys, vebkey_t scratch[])
+{
+    size_t i, start, num_locals, *offsets;
+
+    if (num_keys == 0) return;
+
+    /* base case for tree leafs -> set all bits at once */
+    if (vebtree_is_leaf(tree)) {
+        for (i = 0; i < num_keys; i++)
+            vebtree_bitwise_leaf_insert_key(tree->leaf, keys[i]);
+        return;
+    }
+
+    /* partitioning sparse keys doesn't pay off as it scans all locals */
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    if (num_keys < num_locals / 4) {
+        for (i = 0; i < num_keys; i++)
+            vebtree_insert_key(tree, keys[i]);
+        return;
+    }
+
+    if (!vebtree_has_subtrees(tree)) _init_subtrees(tree, tree->flags);
+
+    /* leaf locals are partitions themselves -> set the bits right away */
+    if (vebtree_has_leaf_locals(tree)) {
+        for (i = 0; i < num_keys; i++)
+            vebtree_bitwise_leaf_insert_key(
+                vebtree_leaf_cluster(tree, vebtree_global_address(keys[i], tree->lower_bits)),
+                vebtree_local_address(keys[i], tree->lower_bits));
+        _vebtree_build_from_locals(tree, keys, scratch);
+        return;
+    }
+
+    /* partition the keys by their global address (counting sort) */
+    offsets = (size_t*)calloc(num_locals + 1, sizeof(size_t));
+    assert(offsets != NULL && "partition offsets allocation failed unexpectedly!");
+
+    for (i = 0; i < num_keys; i++)
+        offsets[vebtree_global_address(keys[i], tree->lower_bits) + 1]++;
+    for (i = 0; i < num_locals; i++)
+        offsets[i + 1] += offsets[i];
+    for (i = 0; i < num_keys; i++)
+        temp[offsets[vebtree_global_address(keys[i], tree->lower_bits)]++]
+            = vebtree_local_address(keys[i], tree->lower_bits);
+
+    /* build each local from its partition, the keys serve as temp space */
+    for (i = 0, start = 0; i < num_locals; start = offsets[i++])
+        if (offsets[i] > start)
+            _vebtree_build_unsorted(&(tree->locals[i]), temp + start,
+                keys + start, offsets[i] - start, scratch);
+
+    free(offsets);
+    _vebtree_build_from_locals(tree, keys, scratch);
+}
+
+/* recompute the counts of a tree built bottom-up, returning its amount of keys */
+uint64_t _vebtree_rebuild_counts(VebTree* tree)
+{
+    vebkey_t i, parent, global_key, num_locals; uint64_t* counts;
+
+    if (vebtree_is_leaf(tree) || !vebtree_has_subtrees(tree) || !vebtree_is_counting(tree))
+        return vebtree_size(tree);
+
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    counts = vebtree_counts(tree);
+    _vebtree_counts_clear(tree);
+    for (global_key = vebtree_get_min(vebtree_owned_global(tree)); global_key != vebtree_null;
+            global_key = vebtree_successor(vebtree_owned_global(tree), global_key))
+        counts[global_key] = vebtree_has_leaf_locals(tree)
+            ? vebtree_bitwise_leaf_size(vebtree_leaf_cluster(tree, global_key))
+            : _vebtree_rebuild_counts(&(tree->locals[global_key]));
+
+    /* turn the per-local counts into the fenwick tree in linear time */
+    for (i = 1; i < num_locals; i++) {
+        parent = i + (i & (~i + 1));
+        if (parent <= num_locals) counts[parent - 1] += counts[i - 1];
+    }
+
+    return vebtree_size(tree);
+}
+
+void vebtree_insert_keys(VebTree* tree, const vebkey_t keys[], size_t num_keys)
+{
+    size_t i, num_scratch; vebkey_t *buffer; bool is_sorted;
+
+    /* bottom-up construction requires an empty tree with locals arrays of its own, insert one by one otherwise */
+    if (!vebtree_is_empty(tree) || num_keys == 0 || vebtree_is_sparse(tree) || vebtree_is_cow(tree)) {
+        for (i = 0; i < num_keys; i++)
+            vebtree_insert_key(tree, keys[i]);
+        return;
+    }
+
+    /* unsorted keys need to be partitioned, requiring 2 extra buffers for the keys */
+    for (i = 1; i < num_keys && keys[i - 1] <= keys[i]; i++);
+    is_sorted = i >= num_keys;
+    num_scratch = _vebtree_bulk_scratch_size(tree, num_keys);
+    buffer = (vebkey_t*)malloc((num_scratch + 2 * num_keys) * sizeof(vebkey_t));
+    assert(buffer != NULL && "bulk insert buffer allocation failed unexpectedly!");
+
+    if (is_sorted) {
+        _vebtree_build_sorted(tree, keys, num_keys, 0, buffer);
+    } else {
+        for (i = 0; i < num_keys; i++)
+            buffer[num_scratch + i] = keys[i];
+        _vebtree_build_unsorted(tree, buffer + num_scratch,
+            buffer + num_scratch + num_keys, num_keys, buffer);
+    }
+
+    if (vebtree_is_counting(tree)) _vebtree_rebuild_counts(tree);
+    free(buffer);
+}
+
+/* ===================================== *
+ *       R A N G E   U P D A T E S
+ * ===================================== */
+
+uint64_t _vebtree_insert_range(VebTree* tree, vebkey_t first, vebkey_t last);
+uint64_t _vebtree_delete_range(VebTree* tree, vebkey_t first, vebkey_t last);
+
+/* insert the local keys [first, last] into the local of the given global key (sparse nodes add it on demand) */
+uint64_t _vebtree_cluster_insert_range(VebTree* tree, vebkey_t global_key, vebkey_t first, vebkey_t last)
+{
+    VebTree* local;
+
+    if (vebtree_has_leaf_locals(tree)) {
+        vebtree_stats_visit();
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_insert_range(vebtree_leaf_cluster(tree, global_key), first, last);
+    }
+
+    local = vebtree_cluster(tree, global_key);
+    if (local == NULL) local = _vebtree_sparse_insert(tree, global_key);
+    return _vebtree_insert_range(local, first, last);
+}
+
+/* delete the local keys [first, last] from the non-empty local of the given global key */
+uint64_t _vebtree_cluster_delete_range(VebTree* tree, vebkey_t global_key, vebkey_t first, vebkey_t last)
+{
+    if (vebtree_has_leaf_locals(tree)) {
+        vebtree_stats_visit();
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_delete_range(vebtree_leaf_cluster(tree, global_key), first, last);
+    }
+
+    return _vebtree_delete_range(vebtree_cluster(tree, global_key), first, last);
+}
+
+/* insert the keys [first, last], returning the amount of keys that weren't part of the tree yet */
+uint64_t _vebtree_insert_range(VebTree* tree, vebkey_t first, vebkey_t last)
+{
+    vebkey_t global_first, global_last, global_key, temp; uint64_t inserted = 0, local_inserted;
+    vebtree_stats_visit();
+
+    /* base case for tree leafs */
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_insert_range(tree->leaf, first, last);
+    }
+
+    /* the range's first key becomes the low, an old low beyond the range is pushed down
+       (one within the range is re-inserted along with the range, so it's no new key) */
+    if (vebtree_is_empty(tree)) {
+        tree->low = tree->high = first;
+        inserted++;
+    } else if (first < tree->low) {
+        temp = tree->low; tree->low = first;
+        if (temp > last) { _vebtree_insert_key(tree, temp); inserted++; }
+    }
+    if (first == tree->low) {
+        if (first == last) return inserted;
+        first++;
+    }
+
+    if (!vebtree_has_subtrees(tree)) _init_subtrees(tree, tree->flags);
+    else if (vebtree_is_cow(tree)) _vebtree_cow_unshare(tree);
+
+    /* all clusters of the range become non-empty, so their global keys are inserted as a range as well */
+    global_first = vebtree_global_address(first, tree->lower_bits);
+    global_last = vebtree_global_address(last, tree->lower_bits);
+    _vebtree_insert_range(vebtree_owned_global(tree), global_first, global_last);
+
+    /* only the clusters at the range's bounds are filled partially */
+    for (global_key = global_first; true; global_key++) {
+        local_inserted = _vebtree_cluster_insert_range(tree, global_key,
+            global_key == global_first ? vebtree_local_address(first, tree->lower_bits) : 0,
+            global_key == global_last ? vebtree_local_address(last, tree->lower_bits)
+                : vebtree_universe_maxvalue(tree->lower_bits) - 1);
+        if (vebtree_is_counting(tree))
+            _vebtree_counts_add(tree, global_key, local_inserted);
+        inserted += local_inserted;
+
+        if (global_key == global_last) break;
+    }
+
+    /* the clusters in between the bounds are full now, the bounds only if the range filled them up */
+    if (vebtree_tracks_full(tree->flags) && global_last > global_first + 1)
+        _vebtree_insert_range(vebtree_full_locals(tree), global_first + 1, global_last - 1);
+    _vebtree_mark_full(tree, global_first);
+    if (global_last != global_first) _vebtree_mark_full(tree, global_last);
+
+    tree->high = tree->high > last ? tree->high : last;
+    return inserted;
+}
+
+void vebtree_insert_range(VebTree* tree, vebkey_t low, vebkey_t high)
+{
+    assert(low <= high && high != vebtree_null && "invalid key range!");
+    assert(!vebtree_is_mapped(tree) && "cannot modify a mapped tree, it's read-only!");
+
+    vebtree_stats_begin(tree);
+    _vebtree_insert_range(tree, low, high);
+    vebtree_stats_end(tree, VEBTREE_OP_INSERT);
+}
+
+/* drop the global key of a local that ran empty, sparse nodes drop the local as well */
+void _vebtree_drop_empty_local(VebTree* tree, vebkey_t global_key)
+{
+    if (!_vebtree_cluster_is_empty(tree, global_key)) return;
+
+    if (_vebtree_contains_key(vebtree_owned_global(tree), global_key))
+        _vebtree_delete_key(vebtree_owned_global(tree), global_key);
+    if (vebtree_is_sparse(tree) && vebtree_cluster(tree, global_key) != NULL)
+        _vebtree_sparse_remove(tree, global_key);
+}
+
+/* delete the keys [first, last], returning the amount of deleted keys (only tracked by counting trees) */
+uint64_t _vebtree_delete_range(VebTree* tree, vebkey_t first, vebkey_t last)
+{
+    vebkey_t global_first, global_last, global_key, next_key, local_key; VebTree* local;
+    uint64_t deleted = 0, local_deleted; bool low_deleted;
+    vebtree_stats_visit();
+
+    /* base case for tree leafs */
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_delete_range(tree->leaf, first, last);
     }
+
+    /* base cases for ranges without any keys and for a single key within the range */
+    if (vebtree_is_empty(tree) || last < tree->low || first > tree->high) return 0;
+    if (tree->low == tree->high) { tree->low = tree->high = vebtree_null; return 1; }
+    if (vebtree_is_cow(tree)) _vebtree_cow_unshare(tree);
+    low_deleted = first <= tree->low;
+
+    /* visit the non-empty clusters of the range, the ones in between its bounds are cleared as a whole */
+    global_first = vebtree_global_address(first, tree->lower_bits);
+    global_last = vebtree_global_address(last, tree->lower_bits);
+    global_key = _vebtree_contains_key(vebtree_owned_global(tree), global_first) ? global_first
+        : _vebtree_successor(vebtree_owned_global(tree), global_first);
+
+    for (; global_key != vebtree_null && global_key <= global_last; global_key = next_key) {
+        next_key = _vebtree_successor(vebtree_owned_global(tree), global_key);
+
+        /* leaf clusters are cleared word by word anyways */
+        if (global_key != global_first && global_key != global_last && !vebtree_has_leaf_locals(tree)) {
+            local = vebtree_cluster(tree, global_key);
+            local_deleted = vebtree_is_counting(tree) ? vebtree_size(local) : 0;
+            _vebtree_clear(local);
+        } else {
+            local_deleted = _vebtree_cluster_delete_range(tree, global_key,
+                global_key == global_first ? vebtree_local_address(first, tree->lower_bits) : 0,
+                global_key == global_last ? vebtree_local_address(last, tree->lower_bits)
+                    : vebtree_universe_maxvalue(tree->lower_bits) - 1);
+        }
+
+        if (vebtree_is_counting(tree))
+            _vebtree_counts_add(tree, global_key, (uint64_t)0 - local_deleted);
+        if (vebtree_is_sparse(tree) && _vebtree_cluster_is_empty(tree, global_key))
+            _vebtree_sparse_remove(tree, global_key);
+        deleted += local_deleted;
+    }
+
+    /* the cleared clusters' global keys are deleted as a range, the bounds only in case they ran empty */
+    if (global_last > global_first + 1) {
+        _vebtree_delete_range(vebtree_owned_global(tree), global_first + 1, global_last - 1);
+        if (vebtree_tracks_full(tree->flags))
+            _vebtree_delete_range(vebtree_full_locals(tree), global_first + 1, global_last - 1);
+    }
+    _vebtree_unmark_full(tree, global_first);
+    if (global_last != global_first) _vebtree_unmark_full(tree, global_last);
+    _vebtree_drop_empty_local(tree, global_first);
+    if (global_last != global_first) _vebtree_drop_empty_local(tree, global_last);
+
+    /* a deleted low is replaced by the smallest remaining key, pulling it out of its local */
+    if (low_deleted) {
+        global_key = vebtree_get_min(vebtree_owned_global(tree));
+        if (global_key == vebtree_null) {
+            tree->low = vebtree_null;
+        } else {
+            local_key = _vebtree_cluster_min(tree, global_key);
+            tree->low = (global_key << tree->lower_bits) | local_key;
+            _vebtree_cluster_delete_range(tree, global_key, local_key, local_key);
+            if (vebtree_is_counting(tree))
+                _vebtree_counts_add(tree, global_key, (uint64_t)-1);
+            _vebtree_unmark_full(tree, global_key);
+            _vebtree_drop_empty_local(tree, global_key);
+        }
+        deleted++;
+    }
+
+    /* in case the maximum was deleted -> find new maximum */
+    if (tree->low == vebtree_null) {
+        tree->high = vebtree_null;
+    } else if (tree->high >= first && tree->high <= last) {
+        global_key = vebtree_get_max(vebtree_owned_global(tree));
+        tree->high = global_key == vebtree_null ? tree->low
+            : (global_key << tree->lower_bits) | _vebtree_cluster_max(tree, global_key);
+    }
+
+    /* release the lazy subtrees again once they ran empty */
+    if (vebtree_is_shrinking(tree) && !vebtree_is_arena(tree) && vebtree_is_empty(vebtree_owned_global(tree)))
+        _free_subtrees(tree);
+    return deleted;
+}
+
+void vebtree_delete_range(VebTree* tree, vebkey_t low, vebkey_t high)
+{
+    assert(low <= high && high != vebtree_null && "invalid key range!");
+    assert(!vebtree_is_mapped(tree) && "cannot modify a mapped tree, it's read-only!");
+
+    vebtree_stats_begin(tree);
+    _vebtree_delete_range(tree, low, high);
+    vebtree_stats_end(tree, VEBTREE_OP_DELETE);
+}
+
+/* ===================================== *
+ *         A B S E N T   K E Y S
+ * ===================================== */
+
+/* the smallest absent local key >= the given one within the local of the given global key */
+vebkey_t _vebtree_cluster_next_absent(VebTree* tree, vebkey_t global_key, vebkey_t local_key, bool claim)
+{
+    bitboard_t* leaf;
+
+    if (!vebtree_has_leaf_locals(tree))
+        return _vebtree_next_absent(vebtree_cluster(tree, global_key), local_key, claim);
+
+    vebtree_stats_visit();
+    vebtree_stats_leaf_hit();
+    leaf = vebtree_leaf_cluster(tree, global_key);
+    local_key = vebtree_bitwise_leaf_next_absent(leaf, local_key, tree->lower_bits);
+    if (claim && local_key != vebtree_null) vebtree_bitwise_leaf_insert_key(leaf, local_key);
+    return local_key;
+}
+
+/* the greatest absent local key <= the given one within the local of the given global key */
+vebkey_t _vebtree_cluster_prev_absent(VebTree* tree, vebkey_t global_key, vebkey_t local_key)
+{
+    if (!vebtree_has_leaf_locals(tree))
+        return _vebtree_prev_absent(vebtree_cluster(tree, global_key), local_key);
+
+    vebtree_stats_visit();
+    vebtree_stats_leaf_hit();
+    return vebtree_bitwise_leaf_prev_absent(vebtree_leaf_cluster(tree, global_key), local_key);
+}
+
+/* the first local from the given one on that isn't known to be full; nodes tracking their full locals
+   look up the next local that isn't part of them, counting nodes skip the full locals by binary lifting
+   over their fenwick counts, sparse / mapped nodes probe each non-empty local up to the next empty one */
+vebkey_t _vebtree_next_open_local(VebTree* tree, vebkey_t global_key)
+{
+    vebkey_t empty_key, step, num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    uint64_t capacity, free_slots, target; uint64_t* counts;
+
+    if (global_key >= num_locals) return vebtree_null;
+    if (vebtree_tracks_full(tree->flags))
+        return _vebtree_next_absent(vebtree_full_locals(tree), global_key, false);
+
+    /* the free slots before each local never decrease -> find the last local
+       that has as many free slots before it as the given local */
+    if (vebtree_is_counting(tree) && tree->universe_bits < 64) {
+        counts = vebtree_counts(tree);
+        capacity = vebtree_universe_maxvalue(tree->lower_bits);
+        target = global_key * capacity - _vebtree_counts_prefix(tree, global_key);
+        for (global_key = 0, free_slots = 0, step = num_locals; step > 0; step >>= 1) {
+            if (global_key + step <= num_locals
+                    && free_slots + step * capacity - counts[global_key + step - 1] <= target) {
+                global_key += step;
+                free_slots += step * capacity - counts[global_key - 1];
+            }
+        }
+        return global_key < num_locals ? global_key : vebtree_null;
+    }
+
+    empty_key = _vebtree_next_absent(vebtree_global(tree), global_key, false);
+    for (; global_key < num_locals && global_key != empty_key; global_key++)
+        if (_vebtree_cluster_next_absent(tree, global_key, 0, false) != vebtree_null)
+            return global_key;
+    return empty_key;
+}
+
+/* the last local up to the given one that isn't full, see _vebtree_next_open_local() */
+vebkey_t _vebtree_prev_open_local(VebTree* tree, vebkey_t global_key)
+{
+    vebkey_t empty_key, step, num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    uint64_t capacity, free_slots, target; uint64_t* counts;
+
+    if (global_key >= num_locals) return vebtree_null;
+    if (vebtree_tracks_full(tree->flags))
+        return _vebtree_prev_absent(vebtree_full_locals(tree), global_key);
+
+    /* find the last local with less free slots before it than there are up to the given local */
+    if (vebtree_is_counting(tree) && tree->universe_bits < 64) {
+        counts = vebtree_counts(tree);
+        capacity = vebtree_universe_maxvalue(tree->lower_bits);
+        target = (global_key + 1) * capacity - _vebtree_counts_prefix(tree, global_key + 1);
+        if (target == 0) return vebtree_null;
+        for (global_key = 0, free_slots = 0, step = num_locals; step > 0; step >>= 1) {
+            if (global_key + step <= num_locals
+                    && free_slots + step * capacity - counts[global_key + step - 1] < target) {
+                global_key += step;
+                free_slots += step * capacity - counts[global_key - 1];
+            }
+        }
+        return global_key;
+    }
+
+    empty_key = _vebtree_prev_absent(vebtree_global(tree), global_key);
+    for (; global_key != vebtree_null && global_key != empty_key; global_key--)
+        if (_vebtree_cluster_prev_absent(tree, global_key,
+                vebtree_universe_maxkey(tree->lower_bits)) != vebtree_null)
+            return global_key;
+    return empty_key;
+}
+
+/* the smallest absent key >= the given key (within the universe), inserting it on the way down if claimed */
+vebkey_t _vebtree_next_absent(VebTree* tree, vebkey_t key, bool claim)
+{
+    vebkey_t global_key, local_key;
+    vebtree_stats_visit();
+
+    /* base case for tree leafs */
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        key = vebtree_bitwise_leaf_next_absent(tree->leaf, key, tree->universe_bits);
+        if (claim && key != vebtree_null) vebtree_bitwise_leaf_insert_key(tree->leaf, key);
+        return key;
+    }
+
+    /* the low is the only key that isn't part of any local */
+    if (key == tree->low) {
+        if (key == vebtree_universe_maxkey(tree->universe_bits)) return vebtree_null;
+        key++;
+    }
+
+    /* base case for keys outside of [low, high] */
+    if (vebtree_is_empty(tree) || key < tree->low || key > tree->high) {
+        if (claim) _vebtree_insert_key(tree, key);
+        return key;
+    }
+    if (claim && vebtree_is_cow(tree)) _vebtree_cow_unshare(tree);
+
+    global_key = vebtree_global_address(key, tree->lower_bits);
+    local_key = vebtree_local_address(key, tree->lower_bits);
+
+    /* look within the key's local first, then within the next local that isn't full */
+    while (!_vebtree_cluster_is_empty(tree, global_key)) {
+        local_key = _vebtree_cluster_next_absent(tree, global_key, local_key, claim);
+        if (local_key != vebtree_null) {
+            key = (global_key << tree->lower_bits) | local_key;
+            if (claim && vebtree_is_counting(tree)) _vebtree_counts_add(tree, global_key, 1);
+            if (claim) _vebtree_mark_full(tree, global_key);
+            if (claim) tree->high = tree->high > key ? tree->high : key;
+            return key;
+        }
+
+        global_key = _vebtree_next_open_local(tree, global_key + 1);
+        if (global_key == vebtree_null) return vebtree_null;
+        local_key = 0;
+    }
+
+    /* all keys of empty locals are absent */
+    key = (global_key << tree->lower_bits) | local_key;
+    if (claim) _vebtree_insert_key(tree, key);
+    return key;
+}
+
+/* the greatest absent key <= the given key (within the universe) */
+vebkey_t _vebtree_prev_absent(VebTree* tree, vebkey_t key)
+{
+    vebkey_t global_key, local_key;
+    vebtree_stats_visit();
+
+    /* base case for tree leafs */
+    if (vebtree_is_leaf(tree)) {
+        vebtree_stats_leaf_hit();
+        return vebtree_bitwise_leaf_prev_absent(tree->leaf, key);
+    }
+
+    /* base cases for keys outside of [low, high] and for the low (all keys below are absent) */
+    if (vebtree_is_empty(tree) || key < tree->low || key > tree->high) return key;
+    if (key == tree->low) return key == 0 ? vebtree_null : key - 1;
+
+    global_key = vebtree_global_address(key, tree->lower_bits);
+    local_key = vebtree_local_address(key, tree->lower_bits);
+
+    /* look within the key's local first, then within the previous local that isn't full */
+    while (!_vebtree_cluster_is_empty(tree, global_key)) {
+        local_key = _vebtree_cluster_prev_absent(tree, global_key, local_key);
+        if (local_key != vebtree_null) break;
+
+        global_key = _vebtree_prev_open_local(tree, global_key - 1);
+        if (global_key == vebtree_null) return vebtree_null;
+        local_key = vebtree_universe_maxkey(tree->lower_bits);
+    }
+
+    /* the low's slot is absent within its local, so continue below the low */
+    key = (global_key << tree->lower_bits) | local_key;
+    return key != tree->low ? key : key == 0 ? vebtree_null : key - 1;
+}
+
+vebkey_t vebtree_next_absent(VebTree* tree, vebkey_t key)
+{
+    vebkey_t absent;
+    if (key > vebtree_universe_maxkey(tree->universe_bits)) return vebtree_null;
+
+    vebtree_stats_begin(tree);
+    absent = _vebtree_next_absent(tree, key, false);
+    vebtree_stats_end(tree, VEBTREE_OP_SUCCESSOR);
+    return absent;
+}
+
+vebkey_t vebtree_prev_absent(VebTree* tree, vebkey_t key)
+{
+    vebkey_t absent;
+    if (key > vebtree_universe_maxkey(tree->universe_bits))
+        key = vebtree_universe_maxkey(tree->universe_bits);
+
+    vebtree_stats_begin(tree);
+    absent = _vebtree_prev_absent(tree, key);
+    vebtree_stats_end(tree, VEBTREE_OP_PREDECESSOR);
+    return absent;
+}
+
+vebkey_t vebtree_alloc_lowest_free(VebTree* tree)
+{
+    vebkey_t key;
+    assert(!vebtree_is_mapped(tree) && "cannot modify a mapped tree, it's read-only!");
+
+    vebtree_stats_begin(tree);
+    key = _vebtree_next_absent(tree, 0, true);
+    vebtree_stats_end(tree, VEBTREE_OP_INSERT);
+    return key;
+}
+
+/* ===================================== *
+ *             C U R S O R
+ * ===================================== */
+
+#define vebtree_cursor_top(cursor) (&((cursor)->path[(cursor)->depth - 1]))
+
+/* leaf parents have their leaf clusters pushed by the bitboard, the other locals by their node */
+#define vebtree_cursor_local(node, global_key) \
+    (vebtree_has_leaf_locals(node) ? NULL : vebtree_cluster(node, global_key))
+#define vebtree_cursor_leaf(node, global_key) \
+    (vebtree_has_leaf_locals(node) ? vebtree_leaf_cluster(node, global_key) : NULL)
+
+void _vebtree_cursor_push(VebCursor* cursor, VebTree* node, bitboard_t* leaf, vebkey_t prefix)
+{
+    assert(cursor->depth < VEBTREE_CURSOR_MAX_DEPTH && "cursor path exceeds the max. depth!");
+    cursor->path[cursor->depth].node = node;
+    cursor->path[cursor->depth].leaf = leaf != NULL ? leaf : vebtree_is_leaf(node) ? node->leaf : NULL;
+    cursor->path[cursor->depth].prefix = prefix;
+    cursor->path[cursor->depth].cluster = vebtree_null;
+    cursor->depth++;
+}
+
+/* the min. of a node is either its low or the min. bit of the leaf -> no descent needed */
+vebkey_t _vebtree_cursor_descend_min(VebCursor* cursor, VebTree* node, bitboard_t* leaf, vebkey_t prefix)
+{
+    _vebtree_cursor_push(cursor, node, leaf, prefix);
+    leaf = vebtree_cursor_top(cursor)->leaf;
+    return cursor->key = prefix | (leaf != NULL ? vebtree_bitwise_leaf_get_min(leaf) : node->low);
+}
+
+/* the max. of a node is part of its locals (except for single keys) -> descend to the leaf */
+vebkey_t _vebtree_cursor_descend_max(VebCursor* cursor, VebTree* node, bitboard_t* leaf, vebkey_t prefix)
+{
+    vebkey_t global_key;
+
+    while (true) {
+        _vebtree_cursor_push(cursor, node, leaf, prefix);
+
+        leaf = vebtree_cursor_top(cursor)->leaf;
+        if (leaf != NULL)
+            return cursor->key = prefix | vebtree_bitwise_leaf_get_max(leaf);
+        if (!vebtree_has_subtrees(node) || vebtree_is_empty(vebtree_global(node)))
+            return cursor->key = prefix | node->low;
+
+        global_key = vebtree_get_max(vebtree_global(node));
+        vebtree_cursor_top(cursor)->cluster = global_key;
+        prefix |= global_key << node->lower_bits;
+        leaf = vebtree_cursor_leaf(node, global_key);
+        node = vebtree_cursor_local(node, global_key);
+    }
+}
+
+/* climb up from an exhausted cluster until there's a next cluster to descend into */
+vebkey_t _vebtree_cursor_climb_next(VebCursor* cursor)
+{
+    vebkey_t global_key; VebTree* node;
+
+    while (cursor->depth > 0) {
+        node = vebtree_cursor_top(cursor)->node;
+        global_key = vebtree_cursor_top(cursor)->cluster;
+
+        if (!vebtree_has_subtrees(node))
+            global_key = vebtree_null;
+        else
+            global_key = global_key == vebtree_null ? vebtree_get_min(vebtree_global(node))
+                : vebtree_successor(vebtree_global(node), global_key);
+
+        if (global_key != vebtree_null) {
+            vebtree_cursor_top(cursor)->cluster = global_key;
+            return _vebtree_cursor_descend_min(cursor, vebtree_cursor_local(node, global_key),
+                vebtree_cursor_leaf(node, global_key),
+                vebtree_cursor_top(cursor)->prefix | (global_key << node->lower_bits));
+        }
+
+        cursor->depth--;
+    }
+
+    return cursor->key = vebtree_null;
+}
+
+vebkey_t vebtree_cursor_seek(VebCursor* cursor, VebTree* tree, vebkey_t key)
+{
+    VebTree* node; bitboard_t* leaf; vebkey_t prefix, global_key, local_key, local_max;
+
+    cursor->tree = tree;
+    cursor->depth = 0;
+    cursor->key = vebtree_null;
+    if (vebtree_is_empty(tree)) return vebtree_null;
+
+    /* descend along the key's path as long as the clusters contain greater keys */
+    for (node = tree, leaf = NULL, prefix = 0; true; ) {
+        _vebtree_cursor_push(cursor, node, leaf, prefix);
+
+        leaf = vebtree_cursor_top(cursor)->leaf;
+        if (leaf != NULL) {
+            local_key = vebtree_bitwise_leaf_contains_key(leaf, key)
+                ? key : vebtree_bitwise_leaf_successor(leaf, key);
+            if (local_key != vebtree_null)
+                return cursor->key = prefix | local_key;
+            cursor->depth--;
+            return _vebtree_cursor_climb_next(cursor);
+        }
+
+        if (key <= node->low)
+            return cursor->key = prefix | node->low;
+        if (!vebtree_has_subtrees(node)) {
+            cursor->depth--;
+            return _vebtree_cursor_climb_next(cursor);
+        }
+
+        global_key = vebtree_global_address(key, node->lower_bits);
+        local_key = vebtree_local_address(key, node->lower_bits);
+        local_max = _vebtree_cluster_max(node, global_key);
+        vebtree_cursor_top(cursor)->cluster = global_key;
+
+        if (local_max == vebtree_null || local_key > local_max)
+            return _vebtree_cursor_climb_next(cursor);
+
+        prefix |= global_key << node->lower_bits;
+        leaf = vebtree_cursor_leaf(node, global_key);
+        node = vebtree_cursor_local(node, global_key);
+        key = local_key;
+    }
+}
+
+vebkey_t vebtree_cursor_seek_last(VebCursor* cursor, VebTree* tree)
+{
+    cursor->tree = tree;
+    cursor->depth = 0;
+    cursor->key = vebtree_null;
+    return vebtree_is_empty(tree) ? vebtree_null
+        : _vebtree_cursor_descend_max(cursor, tree, NULL, 0);
+}
+
+vebkey_t vebtree_cursor_next(VebCursor* cursor)
+{
+    bitboard_t* leaf; vebkey_t prefix, local_key;
+    if (cursor->depth == 0) return vebtree_null;
+
+    /* scan the current leaf first, it only needs to climb up once the leaf is exhausted */
+    leaf = vebtree_cursor_top(cursor)->leaf;
+    prefix = vebtree_cursor_top(cursor)->prefix;
+    if (leaf != NULL) {
+        local_key = vebtree_bitwise_leaf_successor(leaf, cursor->key - prefix);
+        if (local_key != vebtree_null)
+            return cursor->key = prefix | local_key;
+        cursor->depth--;
+    }
+
+    return _vebtree_cursor_climb_next(cursor);
+}
+
+vebkey_t vebtree_cursor_prev(VebCursor* cursor)
+{
+    VebTree* node; bitboard_t* leaf; vebkey_t prefix, local_key, global_key;
+    if (cursor->depth == 0) return vebtree_null;
+
+    /* scan the current leaf first, a node's low is the smallest key of the node */
+    leaf = vebtree_cursor_top(cursor)->leaf;
+    prefix = vebtree_cursor_top(cursor)->prefix;
+    if (leaf != NULL) {
+        local_key = vebtree_bitwise_leaf_predecessor(leaf, cursor->key - prefix);
+        if (local_key != vebtree_null)
+            return cursor->key = prefix | local_key;
+    }
+    cursor->depth--;
+
+    /* climb up from the exhausted cluster to the previous cluster or the node's low */
+    while (cursor->depth > 0) {
+        node = vebtree_cursor_top(cursor)->node;
+        prefix = vebtree_cursor_top(cursor)->prefix;
+        global_key = vebtree_predecessor(vebtree_global(node), vebtree_cursor_top(cursor)->cluster);
+        vebtree_cursor_top(cursor)->cluster = global_key;
+
+        if (global_key == vebtree_null)
+            return cursor->key = prefix | node->low;
+        return _vebtree_cursor_descend_max(cursor, vebtree_cursor_local(node, global_key),
+            vebtree_cursor_leaf(node, global_key), prefix | (global_key << node->lower_bits));
+    }
+
+    return cursor->key = vebtree_null;
+}
+
+bool vebtree_cursor_end(const VebCursor* cursor)
+{
+    return cursor->key == vebtree_null;
+}
+
+/* emit the bits of a leaf word by word */
+size_t _vebtree_export_leaf(const bitboard_t* leaf, vebkey_t prefix, vebkey_t output[], size_t capacity)
+{
+    size_t i, count = 0; bitboard_t bits;
+
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i++)
+        for (bits = leaf[i]; bits != 0 && count < capacity; bits &= bits - 1)
+            output[count++] = prefix | (i << 6) | min_bit_set(bits);
+    return count;
+}
+
+size_t _vebtree_export(VebTree* tree, vebkey_t prefix, vebkey_t output[], size_t capacity)
+{
+    size_t count = 0; vebkey_t global_key;
+
+    /* base case for tree leafs */
+    if (vebtree_is_leaf(tree))
+        return _vebtree_export_leaf(tree->leaf, prefix, output, capacity);
+
+    if (vebtree_is_empty(tree) || capacity == 0)
+        return 0;
+
+    /* the low comes first, followed by the locals in order of the global */
+    output[count++] = prefix | tree->low;
+    if (!vebtree_has_subtrees(tree))
+        return count;
+
+    for (global_key = vebtree_get_min(vebtree_global(tree)); global_key != vebtree_null && count < capacity;
+            global_key = vebtree_successor(vebtree_global(tree), global_key))
+        count += vebtree_has_leaf_locals(tree)
+            ? _vebtree_export_leaf(vebtree_leaf_cluster(tree, global_key),
+                prefix | (global_key << tree->lower_bits), output + count, capacity - count)
+            : _vebtree_export(vebtree_cluster(tree, global_key),
+                prefix | (global_key << tree->lower_bits), output + count, capacity - count);
+
+    return count;
+}
+
+size_t vebtree_to_array(VebTree* tree, vebkey_t output[], size_t capacity)
+{
+    return _vebtree_export(tree, 0, output, capacity);
+}
+
+/* ===================================== *
+ *       R A N G E   Q U E R I E S
+ * ===================================== */
+
+vebkey_t vebtree_floor(VebTree* tree, vebkey_t key)
+{
+    return vebtree_contains_key(tree, key) ? key : vebtree_predecessor(tree, key);
+}
+
+vebkey_t vebtree_ceiling(VebTree* tree, vebkey_t key)
+{
+    return vebtree_contains_key(tree, key) ? key : vebtree_successor(tree, key);
+}
+
+size_t vebtree_range(VebTree* tree, vebkey_t low, vebkey_t high, vebkey_t output[], size_t capacity)
+{
+    size_t count = 0; vebkey_t key; VebCursor cursor;
+
+    for (key = vebtree_cursor_seek(&cursor, tree, low);
+            key != vebtree_null && key <= high && count < capacity;
+            key = vebtree_cursor_next(&cursor))
+        output[count++] = key;
+
+    return count;
+}
+
+/* ===================================== *
+ *       B A T C H E D   L O O K U P S
+ * ===================================== */
+
+/* the amount of keys whose descents are interleaved */
+#define VEBTREE_BATCH_GROUP 16
+
+/* smaller trees (up to ~35 MB fully allocated) mostly stay cached, the
+   interleaving only pays off for trees exceeding the caches */
+#define VEBTREE_BATCH_MIN_BITS 26
+
+#if defined(__GNUC__)
+#define vebtree_prefetch(addr) __builtin_prefetch(addr)
+#elif defined(_MSC_VER)
+#include <xmmintrin.h>
+#define vebtree_prefetch(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#define vebtree_prefetch(addr)
+#endif
+
+/* prefetch the local of the given global key, leaf parents only need its bitboard */
+#define vebtree_prefetch_cluster(node, global_key) vebtree_prefetch(vebtree_has_leaf_locals(node)\
+    ? (void*)vebtree_leaf_cluster(node, global_key) : (void*)&(vebtree_locals(node)[global_key]))
+
+#define VEBTREE_PROBE_DESCEND 0
+#define VEBTREE_PROBE_LOCAL 1
+#define VEBTREE_PROBE_MIN 2
+#define VEBTREE_PROBE_DONE 3
+
+typedef struct _VEB_BATCH_PROBE {
+    VebTree* node;
+    /**< The node to be processed next (already prefetched), or the parent of the local to resolve the minimum of. */
+    vebkey_t key;
+    /**< The key relative to the node, the local's global key to resolve the minimum of,
+         or the final result once the probe is done. */
+    vebkey_t prefix;
+    /**< The key bits above the node's key space. */
+    uint8_t step;
+    /**< The next step of the probe, see VEBTREE_PROBE_XXX. */
+    uint8_t num_pending;
+    /**< The amount of nodes waiting for their global's successor. */
+    struct {
+        VebTree* node;
+        /**< The node that descended into its global. */
+        vebkey_t prefix;
+        /**< The key bits above the node's key space. */
+    } pending[VEBTREE_CURSOR_MAX_DEPTH];
+    /**< The nodes resolving the local minimum of their global's successor. */
+} VebBatchProbe;
+
+/* hand the successor found within the current walk to the node waiting for it */
+void _vebtree_successor_found(VebBatchProbe* probe, vebkey_t result)
+{
+    VebTree* node; vebkey_t prefix;
+
+    /* a walk without successor means that none of the waiting nodes has one */
+    if (result == vebtree_null || probe->num_pending == 0) {
+        probe->key = result;
+        probe->step = VEBTREE_PROBE_DONE;
+        return;
+    }
+
+    node = probe->pending[--probe->num_pending].node;
+    prefix = probe->pending[probe->num_pending].prefix;
+    probe->node = node;
+    probe->key = result;
+    probe->prefix = prefix | (result << node->lower_bits);
+    probe->step = VEBTREE_PROBE_MIN;
+    vebtree_prefetch_cluster(node, result);
+}
+
+/* one step of a successor probe, stopping at the next node that isn't cached yet */
+void _vebtree_successor_step(VebBatchProbe* probe)
+{
+    VebTree* node; vebkey_t key, global_key, local_key, local_max, succ;
+
+    /* the walk's result is the minimum of the successor's local */
+    if (probe->step == VEBTREE_PROBE_MIN) {
+        _vebtree_successor_found(probe, probe->prefix | _vebtree_cluster_min(probe->node, probe->key));
+        return;
+    }
+
+    while (probe->step != VEBTREE_PROBE_DONE) {
+        node = probe->node; key = probe->key;
+
+        if (probe->step == VEBTREE_PROBE_DESCEND) {
+            if (vebtree_is_leaf(node)) {
+                succ = vebtree_bitwise_leaf_successor(node->leaf, key);
+                _vebtree_successor_found(probe, succ == vebtree_null ? succ : probe->prefix | succ);
+                return;
+            }
+
+            if (node->low != vebtree_null && key < node->low) {
+                _vebtree_successor_found(probe, probe->prefix | node->low);
+                return;
+            }
+
+            if (!vebtree_has_subtrees(node)) {
+                _vebtree_successor_found(probe, vebtree_null);
+                return;
+            }
+
+            /* the key's own local decides whether to descend into it or into the global */
+            probe->step = VEBTREE_PROBE_LOCAL;
+            vebtree_prefetch_cluster(node, vebtree_global_address(key, node->lower_bits));
+            return;
+        }
+
+        global_key = vebtree_global_address(key, node->lower_bits);
+        local_key = vebtree_local_address(key, node->lower_bits);
+        local_max = _vebtree_cluster_max(node, global_key);
+
+        /* case where the local contains the successor, its node / bitboard is cached already */
+        if (local_max != vebtree_null && local_key < local_max) {
+            probe->prefix |= global_key << node->lower_bits;
+            if (vebtree_has_leaf_locals(node)) {
+                succ = vebtree_bitwise_leaf_successor(vebtree_leaf_cluster(node, global_key), local_key);
+                _vebtree_successor_found(probe, probe->prefix | succ);
+                return;
+            }
+
+            probe->node = &(vebtree_locals(node)[global_key]);
+            probe->key = local_key;
+            probe->step = VEBTREE_PROBE_DESCEND;
+            continue;
+        }
+
+        /* case where a neighbour contains the successor -> resolve it in the global first,
+           the global sits right in front of the locals, so it's most likely cached as well */
+        probe->pending[probe->num_pending].node = node;
+        probe->pending[probe->num_pending++].prefix = probe->prefix;
+        probe->node = vebtree_global(node);
+        probe->key = global_key;
+        probe->prefix = 0;
+        probe->step = VEBTREE_PROBE_DESCEND;
+    }
+}
+
+void vebtree_contains_keys(VebTree* tree, const vebkey_t keys[], size_t num_keys, bool output[])
+{
+    VebTree *nodes[VEBTREE_BATCH_GROUP], *node; bitboard_t* leafs[VEBTREE_BATCH_GROUP];
+    vebkey_t local_keys[VEBTREE_BATCH_GROUP], key, global_key; size_t base, i, num_group, num_active;
+
+    if (tree->universe_bits < VEBTREE_BATCH_MIN_BITS || vebtree_is_sparse(tree)) {
+        for (i = 0; i < num_keys; i++)
+            output[i] = vebtree_contains_key(tree, keys[i]);
+        return;
+    }
+
+    for (base = 0; base < num_keys; base += VEBTREE_BATCH_GROUP) {
+        num_group = num_keys - base < VEBTREE_BATCH_GROUP ? num_keys - base : VEBTREE_BATCH_GROUP;
+        for (i = 0; i < num_group; i++) {
+            nodes[i] = tree;
+            leafs[i] = vebtree_is_leaf(tree) ? tree->leaf : NULL;
+            local_keys[i] = keys[base + i];
+        }
+
+        /* advance all descents of the group by one level per round, prefetching
+           their next nodes, so the group's cache misses are resolved in parallel */
+        do {
+            num_active = 0;
+            for (i = 0; i < num_group; i++) {
+                if ((node = nodes[i]) == NULL) continue;
+                key = local_keys[i];
+
+                if (leafs[i] != NULL) {
+                    output[base + i] = vebtree_bitwise_leaf_contains_key(leafs[i], key);
+                    nodes[i] = NULL;
+                    continue;
+                }
+
+                /* an empty local can't contain the key, so the global doesn't need to be checked */
+                if (node->low == key || node->high == key
+                        || node->low == vebtree_null || !vebtree_has_subtrees(node)) {
+                    output[base + i] = node->low == key || node->high == key;
+                    nodes[i] = NULL;
+                    continue;
+                }
+
+                /* leaf parents hand over the bitboard of the key's local instead of its node */
+                global_key = vebtree_global_address(key, node->lower_bits);
+                local_keys[i] = vebtree_local_address(key, node->lower_bits);
+                if (vebtree_has_leaf_locals(node)) {
+                    leafs[i] = vebtree_leaf_cluster(node, global_key);
+                    vebtree_prefetch(leafs[i]);
+                } else {
+                    nodes[i] = &(vebtree_locals(node)[global_key]);
+                    vebtree_prefetch(nodes[i]);
+                }
+                num_active++;
+            }
+        } while (num_active > 0);
+    }
+}
+
+void vebtree_successors(VebTree* tree, const vebkey_t keys[], size_t num_keys, vebkey_t output[])
+{
+    VebBatchProbe probes[VEBTREE_BATCH_GROUP]; size_t base, i, num_group, num_active;
+
+    if (tree->universe_bits < VEBTREE_BATCH_MIN_BITS || vebtree_is_sparse(tree)) {
+        for (i = 0; i < num_keys; i++)
+            output[i] = vebtree_successor(tree, keys[i]);
+        return;
+    }
+
+    for (base = 0; base < num_keys; base += VEBTREE_BATCH_GROUP) {
+        num_group = num_keys - base < VEBTREE_BATCH_GROUP ? num_keys - base : VEBTREE_BATCH_GROUP;
+        for (i = 0; i < num_group; i++) {
+            probes[i].node = tree;
+            probes[i].key = keys[base + i];
+            probes[i].prefix = 0;
+            probes[i].num_pending = 0;
+            probes[i].step = VEBTREE_PROBE_DESCEND;
+        }
+
+        /* advance all probes of the group by one step per round, see vebtree_contains_keys() */
+        do {
+            num_active = 0;
+            for (i = 0; i < num_group; i++) {
+                if (probes[i].step == VEBTREE_PROBE_DONE) continue;
+                _vebtree_successor_step(&probes[i]);
+                num_active += probes[i].step != VEBTREE_PROBE_DONE;
+            }
+        } while (num_active > 0);
+
+        for (i = 0; i < num_group; i++)
+            output[base + i] = probes[i].key;
+    }
+}
+
+/* ===================================== *
+ *     O R D E R   S T A T I S T I C S
+ * ===================================== */
+
+#define vebtree_assert_counting(tree) assert((vebtree_is_leaf(tree) || vebtree_is_counting(tree))\
+    && "order statistics require a tree created with VEBTREE_FLAG_COUNTS!")
+
+uint64_t vebtree_size(VebTree* tree)
+{
+    vebtree_assert_counting(tree);
+
+    if (vebtree_is_leaf(tree))
+        return vebtree_bitwise_leaf_size(tree->leaf);
+
+    /* the low isn't part of any local, the last fenwick entry sums up all locals */
+    if (vebtree_is_empty(tree)) return 0;
+    return vebtree_has_subtrees(tree)
+        ? 1 + vebtree_counts(tree)[vebtree_universe_maxvalue(tree->upper_bits) - 1] : 1;
+}
+
+uint64_t vebtree_rank(VebTree* tree, vebkey_t key)
+{
+    vebkey_t global_key, local_key;
+    vebtree_assert_counting(tree);
+
+    /* base case for tree leafs, keys beyond the leaf's universe are greater than all keys */
+    if (vebtree_is_leaf(tree))
+        return key >= vebtree_universe_maxvalue(tree->universe_bits)
+            ? vebtree_bitwise_leaf_size(tree->leaf) : vebtree_bitwise_leaf_rank(tree->leaf, key);
+
+    if (vebtree_is_empty(tree) || key <= tree->low) return 0;
+    if (key > tree->high) return vebtree_size(tree);
+
+    /* the low + all keys of the preceding locals + the keys within the key's own local */
+    global_key = vebtree_global_address(key, tree->lower_bits);
+    local_key = vebtree_local_address(key, tree->lower_bits);
+    return 1 + _vebtree_counts_prefix(tree, global_key) + (vebtree_has_leaf_locals(tree)
+        ? vebtree_bitwise_leaf_rank(vebtree_leaf_cluster(tree, global_key), local_key)
+        : vebtree_rank(&(tree->locals[global_key]), local_key));
+}
+
+vebkey_t vebtree_select(VebTree* tree, uint64_t rank)
+{
+    vebkey_t global_key, step, num_locals; uint64_t* counts;
+    vebtree_assert_counting(tree);
+
+    if (vebtree_is_leaf(tree))
+        return vebtree_bitwise_leaf_select(tree->leaf, rank);
+
+    if (rank >= vebtree_size(tree)) return vebtree_null;
+    if (rank == 0) return tree->low;
+    rank--;
+
+    /* descend the fenwick tree to the local holding the key (binary lifting) */
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    counts = vebtree_counts(tree);
+    for (global_key = 0, step = num_locals; step > 0; step >>= 1) {
+        if (global_key + step <= num_locals && counts[global_key + step - 1] <= rank) {
+            global_key += step;
+            rank -= counts[global_key - 1];
+        }
+    }
+
+    return (global_key << tree->lower_bits) | (vebtree_has_leaf_locals(tree)
+        ? vebtree_bitwise_leaf_select(vebtree_leaf_cluster(tree, global_key), rank)
+        : vebtree_select(&(tree->locals[global_key]), rank));
+}
+
+/* ===================================== *
+ *          S E T   A L G E B R A
+ * ===================================== */
+
+/* trees of the same universe may still be split differently, e.g. lazy vs. fully allocated;
+   sparse trees don't have locals arrays to be combined index by index and the locals
+   of copy-on-write trees may be shared, so they're combined key by key as well */
+#define vebtree_same_shape(tree, other) ((tree)->lower_bits == (other)->lower_bits\
+    && !vebtree_is_sparse(tree) && !vebtree_is_sparse(other) && !vebtree_is_cow(tree))
+
+/* the amount of keys within the local of the given global key (counting nodes only) */
+uint64_t _vebtree_cluster_size(VebTree* tree, vebkey_t global_key)
+{
+    return vebtree_has_leaf_locals(tree)
+        ? vebtree_bitwise_leaf_size(vebtree_leaf_cluster(tree, global_key))
+        : vebtree_size(&(tree->locals[global_key]));
+}
+
+void _vebtree_cluster_clear(VebTree* tree, vebkey_t global_key)
+{
+    if (vebtree_has_leaf_locals(tree))
+        vebtree_bitwise_leaf_clear(vebtree_leaf_cluster(tree, global_key));
+    else
+        _vebtree_clear(&(tree->locals[global_key]));
+}
+
+void _vebtree_clear(VebTree* tree)
+{
+    vebkey_t global_key;
+
+    if (vebtree_is_leaf(tree)) {
+        vebtree_bitwise_leaf_clear(tree->leaf);
+        return;
+    }
+
+    if (vebtree_is_empty(tree)) return;
+    tree->low = tree->high = vebtree_null;
+    if (!vebtree_has_subtrees(tree)) return;
+
+    if ((vebtree_is_shrinking(tree) || vebtree_is_cow(tree)) && !vebtree_is_arena(tree)) {
+        _free_subtrees(tree);
+        return;
+    }
+
+    for (global_key = vebtree_get_min(vebtree_owned_global(tree)); global_key != vebtree_null;
+            global_key = vebtree_successor(vebtree_owned_global(tree), global_key))
+        _vebtree_cluster_clear(tree, global_key);
+    _vebtree_clear(vebtree_owned_global(tree));
+    if (vebtree_is_counting(tree)) _vebtree_counts_clear(tree);
+    if (vebtree_tracks_full(tree->flags)) _vebtree_clear(vebtree_full_locals(tree));
+}
+
+/* restore the high after clusters were removed, releasing shrinking subtrees once they ran empty */
+void _vebtree_fix_high(VebTree* tree)
+{
+    vebkey_t global_high = vebtree_get_max(vebtree_owned_global(tree));
+    tree->high = global_high == vebtree_null ? tree->low
+        : (global_high << tree->lower_bits) | _vebtree_cluster_max(tree, global_high);
+
+    if (global_high == vebtree_null && vebtree_is_shrinking(tree) && !vebtree_is_arena(tree))
+        _free_subtrees(tree);
+}
+
+void vebtree_union(VebTree* tree, VebTree* other)
+{
+    vebkey_t key; uint64_t num_keys = 0; VebTree *other_global, *other_locals; bool was_empty;
+    assert(tree->universe_bits == other->universe_bits && "set operations require the same universe!");
+
+    /* base case for tree leafs -> combine the bitboards word by word */
+    if (vebtree_is_leaf(tree)) {
+        vebtree_bitwise_leaf_union(tree->leaf, other->leaf);
+        return;
+    }
+
+    if (vebtree_is_empty(other)) return;
+
+    /* differently split trees are merged key by key */
+    if (!vebtree_same_shape(tree, other)) {
+        for (key = vebtree_get_min(other); key != vebtree_null; key = vebtree_successor(other, key))
+            vebtree_insert_key(tree, key);
+        return;
+    }
+
+    /* merge the other's non-empty clusters, its low isn't part of any cluster */
+    was_empty = vebtree_is_empty(tree);
+    if (vebtree_has_subtrees(other) && !vebtree_is_empty(vebtree_global(other))) {
+        if (!vebtree_has_subtrees(tree)) _init_subtrees(tree, tree->flags);
+        other_global = vebtree_global(other);
+        other_locals = vebtree_locals(other);
+
+        for (key = vebtree_get_min(other_global); key != vebtree_null;
+                key = vebtree_successor(other_global, key)) {
+            if (vebtree_is_counting(tree)) num_keys = _vebtree_cluster_size(tree, key);
+            if (vebtree_has_leaf_locals(tree))
+                vebtree_bitwise_leaf_union(vebtree_leaf_cluster(tree, key), vebtree_leaf_cluster(other, key));
+            else
+                vebtree_union(&(tree->locals[key]), &(other_locals[key]));
+            if (vebtree_is_counting(tree))
+                _vebtree_counts_add(tree, key, _vebtree_cluster_size(tree, key) - num_keys);
+            _vebtree_mark_full(tree, key);
+        }
+        vebtree_union(vebtree_owned_global(tree), other_global);
+
+        if (!was_empty && other->high > tree->high)
+            tree->high = other->high;
+    }
+
+    /* finally insert the other's low, which also fixes the tree's low / high */
+    if (was_empty) {
+        tree->low = other->low;
+        tree->high = other->high;
+    } else {
+        vebtree_insert_key(tree, other->low);
+    }
+}
+
+void vebtree_intersect(VebTree* tree, VebTree* other)
+{
+    vebkey_t key, other_low; uint64_t num_keys = 0; bool keep_low;
+    assert(tree->universe_bits == other->universe_bits && "set operations require the same universe!");
+
+    /* base case for tree leafs -> combine the bitboards word by word */
+    if (vebtree_is_leaf(tree)) {
+        vebtree_bitwise_leaf_intersect(tree->leaf, other->leaf);
+        return;
+    }
+
+    if (vebtree_is_empty(tree)) return;
+    if (vebtree_is_empty(other)) { _vebtree_clear(tree); return; }
+
+    /* differently split trees are intersected key by key */
+    if (!vebtree_same_shape(tree, other)) {
+        for (key = vebtree_get_min(tree); key != vebtree_null; key = vebtree_successor(tree, key))
+            if (!vebtree_contains_key(other, key))
+                vebtree_delete_key(tree, key);
+        return;
+    }
+
+    /* the lows aren't part of any cluster, so they're checked separately */
+    keep_low = vebtree_contains_key(other, tree->low);
+    other_low = other->low != tree->low && vebtree_contains_key(tree, other->low)
+        ? other->low : vebtree_null;
+
+    /* intersect the clusters, dropping the ones that are empty in the other tree */
+    if (vebtree_has_subtrees(tree)) {
+        for (key = vebtree_get_min(vebtree_owned_global(tree)); key != vebtree_null;
+                key = vebtree_successor(vebtree_owned_global(tree), key)) {
+            if (vebtree_is_counting(tree)) num_keys = _vebtree_cluster_size(tree, key);
+            if (!vebtree_has_subtrees(other) || !vebtree_contains_key(vebtree_global(other), key))
+                _vebtree_cluster_clear(tree, key);
+            else if (vebtree_has_leaf_locals(tree))
+                vebtree_bitwise_leaf_intersect(vebtree_leaf_cluster(tree, key), vebtree_leaf_cluster(other, key));
+            else
+                vebtree_intersect(&(tree->locals[key]), &(vebtree_locals(other)[key]));
+            if (vebtree_is_counting(tree))
+                _vebtree_counts_add(tree, key, _vebtree_cluster_size(tree, key) - num_keys);
+            if (vebtree_tracks_full(tree->flags) && !_vebtree_cluster_is_full(tree, key))
+                _vebtree_unmark_full(tree, key);
+
+            if (_vebtree_cluster_is_empty(tree, key))
+                vebtree_delete_key(vebtree_owned_global(tree), key);
+        }
+        _vebtree_fix_high(tree);
+    }
+
+    if (!keep_low) vebtree_delete_key(tree, tree->low);
+    if (other_low != vebtree_null) vebtree_insert_key(tree, other_low);
+}
+
+void vebtree_difference(VebTree* tree, VebTree* other)
+{
+    vebkey_t key, other_low; uint64_t num_keys = 0; bool remove_low;
+    assert(tree->universe_bits == other->universe_bits && "set operations require the same universe!");
+
+    /* base case for tree leafs -> combine the bitboards word by word */
+    if (vebtree_is_leaf(tree)) {
+        vebtree_bitwise_leaf_difference(tree->leaf, other->leaf);
+        return;
+    }
+
+    if (vebtree_is_empty(tree) || vebtree_is_empty(other)) return;
+
+    /* differently split trees are subtracted key by key */
+    if (!vebtree_same_shape(tree, other)) {
+        for (key = vebtree_get_min(other); key != vebtree_null; key = vebtree_successor(other, key))
+            if (vebtree_contains_key(tree, key))
+                vebtree_delete_key(tree, key);
+        return;
+    }
+
+    /* the lows aren't part of any cluster, so they're checked separately */
+    remove_low = vebtree_contains_key(other, tree->low);
+    other_low = other->low != tree->low && vebtree_contains_key(tree, other->low)
+        ? other->low : vebtree_null;
+
+    /* subtract the clusters that are non-empty in both trees */
+    if (vebtree_has_subtrees(tree) && vebtree_has_subtrees(other)) {
+        for (key = vebtree_get_min(vebtree_owned_global(tree)); key != vebtree_null;
+                key = vebtree_successor(vebtree_owned_global(tree), key)) {
+            if (!vebtree_contains_key(vebtree_global(other), key)) continue;
+
+            if (vebtree_is_counting(tree)) num_keys = _vebtree_cluster_size(tree, key);
+            if (vebtree_has_leaf_locals(tree))
+                vebtree_bitwise_leaf_difference(vebtree_leaf_cluster(tree, key), vebtree_leaf_cluster(other, key));
+            else
+                vebtree_difference(&(tree->locals[key]), &(vebtree_locals(other)[key]));
+            if (vebtree_is_counting(tree))
+                _vebtree_counts_add(tree, key, _vebtree_cluster_size(tree, key) - num_keys);
+            if (vebtree_tracks_full(tree->flags) && !_vebtree_cluster_is_full(tree, key))
+                _vebtree_unmark_full(tree, key);
+            if (_vebtree_cluster_is_empty(tree, key))
+                vebtree_delete_key(vebtree_owned_global(tree), key);
+        }
+        _vebtree_fix_high(tree);
+    }
+
+    if (other_low != vebtree_null) vebtree_delete_key(tree, other_low);
+    if (remove_low) vebtree_delete_key(tree, tree->low);
+}
+
+/* mapped trees don't keep their allocation flags, so they're copied into lazy trees */
+#define vebtree_init_like(result, tree) vebtree_init(result, (tree)->universe_bits,\
+    vebtree_is_mapped(tree) ? VEBTREE_FLAG_LAZY : (tree)->flags)
+
+void vebtree_init_union(VebTree** result, VebTree* tree_a, VebTree* tree_b)
+{
+    vebtree_init_like(result, tree_a);
+    vebtree_union(*result, tree_a);
+    vebtree_union(*result, tree_b);
+}
+
+void vebtree_init_intersection(VebTree** result, VebTree* tree_a, VebTree* tree_b)
+{
+    vebtree_init_like(result, tree_a);
+    vebtree_union(*result, tree_a);
+    vebtree_intersect(*result, tree_b);
+}
+
+void vebtree_init_difference(VebTree** result, VebTree* tree_a, VebTree* tree_b)
+{
+    vebtree_init_like(result, tree_a);
+    vebtree_union(*result, tree_a);
+    vebtree_difference(*result, tree_b);
+}
+
+/* ===================================== *
+ *               S O R T
+ * ===================================== */
+
+/* trees are only used for keys covering at most 2^VEBTREE_SORT_DENSITY_BITS
+   universe values per key and up to 2^VEBTREE_SORT_MAX_TREE_BITS values overall
+   (staying mostly cache-resident), wider key ranges get partitioned by their upper bits */
+#define VEBTREE_SORT_DENSITY_BITS 5
+#define VEBTREE_SORT_MAX_TREE_BITS 20
+#define VEBTREE_SORT_RADIX_BITS 8
+#define VEBTREE_SORT_INSERTION_THRESHOLD 32
+
+size_t _vebtree_sort_small(const vebkey_t keys[], size_t num_keys, vebkey_t output[], uint8_t flags)
+{
+    size_t i, j, count; vebkey_t key;
+
+    for (i = 0; i < num_keys; i++) {
+        key = keys[i];
+        for (j = i; j > 0 && output[j - 1] > key; j--)
+            output[j] = output[j - 1];
+        output[j] = key;
+    }
+
+    if (!(flags & VEBTREE_SORT_UNIQUE) || num_keys == 0)
+        return num_keys;
+
+    for (i = 1, count = 1; i < num_keys; i++)
+        if (output[i] != output[count - 1])
+            output[count++] = output[i];
+    return count;
+}
+
+/* expand the sorted unique keys in the output by their multiplicities within the keys */
+void _vebtree_sort_expand_duplicates(const vebkey_t keys[], size_t num_keys,
+                                     vebkey_t output[], size_t num_unique, uint8_t uni_bits)
+{
+    size_t i, j, pos, num_blocks, *first, *counts; vebkey_t key;
+
+    /* index the first unique key of each 64-key block to find a key's rank quickly */
+    num_blocks = ((size_t)1 << (uni_bits > 6 ? uni_bits - 6 : 0)) + 1;
+    first = (size_t*)malloc(num_blocks * sizeof(size_t));
+    counts = (size_t*)calloc(num_unique, sizeof(size_t));
+    assert(first != NULL && counts != NULL && "duplicate counts allocation failed unexpectedly!");
+
+    for (i = 0, j = 0; i < num_blocks; i++) {
+        for (; j < num_unique && (output[j] >> 6) < i; j++);
+        first[i] = j;
+    }
+
+    for (i = 0; i < num_keys; i++) {
+        for (j = first[keys[i] >> 6]; output[j] != keys[i]; j++);
+        counts[j]++;
+    }
+
+    /* spread the keys from back to front, each copy lands at or behind its source */
+    for (i = num_unique, pos = num_keys; i-- > 0;)
+        for (key = output[i], j = 0; j < counts[i]; j++)
+            output[--pos] = key;
+
+    free(counts);
+    free(first);
+}
+
+size_t _vebtree_sort_radix(const vebkey_t keys[], size_t num_keys, vebkey_t output[],
+                           uint8_t flags, vebkey_t min, uint8_t uni_bits)
+{
+    size_t i, start, count, offsets[((size_t)1 << VEBTREE_SORT_RADIX_BITS) + 1] = { 0 };
+    vebkey_t* buckets; uint8_t shift;
+
+    buckets = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    assert(buckets != NULL && "radix buckets allocation failed unexpectedly!");
+
+    /* partition the keys by their upper bits (counting sort) */
+    shift = uni_bits - VEBTREE_SORT_RADIX_BITS;
+    for (i = 0; i < num_keys; i++)
+        offsets[((keys[i] - min) >> shift) + 1]++;
+    for (i = 0; i < ((size_t)1 << VEBTREE_SORT_RADIX_BITS); i++)
+        offsets[i + 1] += offsets[i];
+    for (i = 0; i < num_keys; i++)
+        buckets[offsets[(keys[i] - min) >> shift]++] = keys[i];
+
+    /* sort each bucket on its own, they are already in order among each other */
+    for (i = 0, start = 0, count = 0; i < ((size_t)1 << VEBTREE_SORT_RADIX_BITS); start = offsets[i++])
+        if (offsets[i] > start)
+            count += vebtree_sort(buckets + start, offsets[i] - start, output + count, flags);
+
+    free(buckets);
+    return count;
+}
+
+size_t vebtree_sort(const vebkey_t keys[], size_t num_keys, vebkey_t output[], uint8_t flags)
+{
+    size_t i, num_unique; vebkey_t min, max, *shifted; uint8_t uni_bits; VebTree* tree;
+
+    if (num_keys <= VEBTREE_SORT_INSERTION_THRESHOLD)
+        return _vebtree_sort_small(keys, num_keys, output, flags);
+
+    for (i = 1, min = max = keys[0]; i < num_keys; i++) {
+        min = keys[i] < min ? keys[i] : min;
+        max = keys[i] > max ? keys[i] : max;
+    }
+
+    if (min == max) {
+        num_unique = (flags & VEBTREE_SORT_UNIQUE) ? 1 : num_keys;
+        for (i = 0; i < num_unique; i++)
+            output[i] = min;
+        return num_unique;
+    }
+
+    /* sparse keys would waste lots of memory on mostly empty subtrees */
+    uni_bits = vebtree_required_universe_bits(max - min);
+    if (uni_bits > VEBTREE_SORT_MAX_TREE_BITS
+            || uni_bits > vebtree_required_universe_bits(num_keys) + VEBTREE_SORT_DENSITY_BITS)
+        return _vebtree_sort_radix(keys, num_keys, output, flags, min, uni_bits);
+
+    /* shift the keys into the smallest universe and sort them by a tree */
+    shifted = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    assert(shifted != NULL && "shifted keys allocation failed unexpectedly!");
+    for (i = 0; i < num_keys; i++)
+        shifted[i] = keys[i] - min;
+
+    vebtree_init(&tree, uni_bits, VEBTREE_FLAG_ARENA);
+    vebtree_insert_keys(tree, shifted, num_keys);
+    num_unique = vebtree_to_array(tree, output, num_keys);
+    vebtree_free(tree);
+
+    if (num_unique < num_keys && !(flags & VEBTREE_SORT_UNIQUE)) {
+        _vebtree_sort_expand_duplicates(shifted, num_keys, output, num_unique, uni_bits);
+        num_unique = num_keys;
+    }
+
+    for (i = 0; i < num_unique; i++)
+        output[i] += min;
+
+    free(shifted);
+    return num_unique;
+}
+
+/* ===================================== *
+ *        M E M O R Y   U S A G E
+ * ===================================== */
+
+typedef struct _VEB_TREE_USAGE {
+    size_t bytes;
+    /**< The bytes of all subtree blocks. */
+    size_t blocks;
+    /**< The amount of subtree blocks (global + locals). */
+    size_t nodes;
+    /**< The amount of nodes, including the root. */
+    size_t nonempty_nodes;
+    /**< The amount of nodes holding at least one key. */
+} VebTreeUsage;
+
+/* sum up the subtree blocks below the given node (mapped trees resolve their offsets) */
+void _vebtree_usage(VebTree* tree, VebTreeUsage* usage)
+{
+    size_t i, num_slots; VebTree* locals;
+
+    usage->nodes++;
+    if (!vebtree_is_empty(tree)) usage->nonempty_nodes++;
+    if (vebtree_is_leaf(tree) || !vebtree_has_subtrees(tree))
+        return;
+
+    num_slots = vebtree_has_leaf_locals(tree) ? 0 : vebtree_num_slots(tree);
+    locals = vebtree_locals(tree);
+    usage->bytes += vebtree_block_header(tree->flags) + vebtree_block_bytes(tree);
+    usage->blocks++;
+
+    _vebtree_usage(vebtree_global(tree), usage);
+    if (vebtree_tracks_full(tree->flags)) _vebtree_usage(vebtree_full_locals(tree), usage);
+    for (i = 0; i < num_slots; i++)
+        if (vebtree_slot_used(tree, i))
+            _vebtree_usage(locals + i, usage);
+}
+
+size_t vebtree_memory_usage(VebTree* tree)
+{
+    VebTreeUsage usage = { 0, 0, 0, 0 };
+    _vebtree_usage(tree, &usage);
+    return vebtree_root_bytes(tree) + usage.bytes;
+}
+
+#ifdef VEBTREE_STATS
+
+void _vebtree_stats_init_root(VebTree* tree)
+{
+    VebTreeStats* stats = vebtree_root_stats(tree);
+    VebTreeUsage usage = { 0, 0, 0, 0 };
+
+    tree->is_root = 1;
+    memset(stats, 0, sizeof(VebTreeStats));
+
+    /* arena trees are allocated at once, others allocate each block on its own */
+    _vebtree_usage(tree, &usage);
+    stats->allocations = vebtree_is_arena(tree) ? 1 : 1 + usage.blocks;
+    stats->allocated_bytes = stats->peak_bytes = VEBTREE_ROOT_BYTES + usage.bytes;
+}
+
+VebTreeStats* vebtree_stats(VebTree* tree)
+{
+    return vebtree_has_stats(tree) ? vebtree_root_stats(tree) : NULL;
+}
+
+void vebtree_stats_reset(VebTree* tree)
+{
+    VebTreeStats* stats = vebtree_stats(tree); uint64_t allocated_bytes;
+    assert(stats != NULL && "only tree roots keep stats!");
+
+    allocated_bytes = stats->allocated_bytes;
+    memset(stats, 0, sizeof(VebTreeStats));
+    stats->allocated_bytes = stats->peak_bytes = allocated_bytes;
+}
+
+#endif
+
+void vebtree_stats_dump(VebTree* tree, FILE* file)
+{
+    VebTreeUsage usage = { 0, 0, 0, 0 };
+#ifdef VEBTREE_STATS
+    const char* op_names[VEBTREE_NUM_OPS] = { "contains", "insert", "delete", "successor", "predecessor" };
+    VebTreeStats* stats = vebtree_stats(tree); int op, depth;
+#endif
+
+    _vebtree_usage(tree, &usage);
+    fprintf(file, "universe_bits %u\n", tree->universe_bits);
+    fprintf(file, "flags %u\n", tree->flags);
+    fprintf(file, "memory_bytes %llu\n", (unsigned long long)(vebtree_root_bytes(tree) + usage.bytes));
+    fprintf(file, "allocated_nodes %llu\n", (unsigned long long)usage.nodes);
+    fprintf(file, "nonempty_nodes %llu\n", (unsigned long long)usage.nonempty_nodes);
+
+#ifdef VEBTREE_STATS
+    if (stats == NULL) return;
+
+    fprintf(file, "allocations %llu\n", (unsigned long long)stats->allocations);
+    fprintf(file, "frees %llu\n", (unsigned long long)stats->frees);
+    fprintf(file, "allocated_bytes %llu\n", (unsigned long long)stats->allocated_bytes);
+    fprintf(file, "peak_bytes %llu\n", (unsigned long long)stats->peak_bytes);
+
+    for (op = 0; op < VEBTREE_NUM_OPS; op++) {
+        fprintf(file, "%s_calls %llu\n", op_names[op], (unsigned long long)stats->calls[op]);
+        fprintf(file, "%s_leaf_hits %llu\n", op_names[op], (unsigned long long)stats->leaf_hits[op]);
+        for (depth = 0; depth < VEBTREE_STATS_MAX_DEPTH; depth++)
+            if (stats->depth_histogram[op][depth] > 0)
+                fprintf(file, "%s_depth_%d %llu\n", op_names[op], depth,
+                        (unsigned long long)stats->depth_histogram[op][depth]);
+    }
+#endif
 }
 
 #endif /* DOXYGEN_SKIP */
@@ -0,0 +1,420 @@
+/* MIT License
+ *
+ * Copyright (c) 2022 Marco Tröster
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef VEBTREES_HPP
+#define VEBTREES_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+ * @brief Van Emde Boas trees for a universe fixed at compile time, following the
+ * semantics of vebtrees.h (64-bit keys, null keys for missing successors etc.).
+ * Each tree level is a type of its own with constexpr global / local splits, so the
+ * recursion is resolved by the compiler into straight-line code and the bitwise
+ * leafs are inlined into their parents. Subtrees are allocated lazily on their
+ * first key (like VEBTREE_FLAG_LAZY), nodes split off at most 2^16 locals.
+ */
+namespace veb {
+
+/**
+ * @brief Representing a 64-bit integer key managed by van Emde Boas trees.
+ */
+using key_type = std::uint64_t;
+
+/**
+ * @brief This constant is used to represent null keys, same as vebtree_null.
+ */
+constexpr key_type null = 0xFFFFFFFFFFFFFFFFULL;
+
+#ifndef DOXYGEN_SKIP
+namespace detail {
+
+/* ===================================== *
+ *        B I T S C A N   O P S
+ * ===================================== */
+
+constexpr unsigned leaf_bits = 6;
+constexpr unsigned max_upper_bits = 16;
+
+#if defined(__GNUC__)
+inline unsigned lowest_bit(std::uint64_t bits) { return (unsigned)__builtin_ctzll(bits); }
+inline unsigned highest_bit(std::uint64_t bits) { return 63u - (unsigned)__builtin_clzll(bits); }
+#elif defined(_MSC_VER)
+inline unsigned lowest_bit(std::uint64_t bits) { unsigned long idx; _BitScanForward64(&idx, bits); return idx; }
+inline unsigned highest_bit(std::uint64_t bits) { unsigned long idx; _BitScanReverse64(&idx, bits); return idx; }
+#else
+inline unsigned lowest_bit(std::uint64_t bits) { unsigned idx = 0; while (!(bits & 1)) { bits >>= 1; idx++; } return idx; }
+inline unsigned highest_bit(std::uint64_t bits) { unsigned idx = 63; while (!(bits >> idx)) idx--; return idx; }
+#endif
+
+/* ===================================== *
+ *          T R E E   N O D E S
+ * ===================================== */
+
+template <unsigned Bits, bool IsLeaf = (Bits <= leaf_bits)>
+class node;
+
+/* bitwise leaf covering up to 64 keys with a single bitboard */
+template <unsigned Bits>
+class node<Bits, true> {
+public:
+    bool empty() const { return bits == 0; }
+    key_type min() const { return bits == 0 ? null : lowest_bit(bits); }
+    key_type max() const { return bits == 0 ? null : highest_bit(bits); }
+    bool contains(key_type key) const { return (bits >> key) & 1; }
+
+    key_type successor(key_type key) const
+    {
+        std::uint64_t succ_bits = key == 63 ? 0 : bits & (~(std::uint64_t)0 << (key + 1));
+        return succ_bits == 0 ? null : lowest_bit(succ_bits);
+    }
+
+    key_type predecessor(key_type key) const
+    {
+        std::uint64_t pred_bits = bits & (((std::uint64_t)1 << key) - 1);
+        return pred_bits == 0 ? null : highest_bit(pred_bits);
+    }
+
+    bool insert(key_type key)
+    {
+        std::uint64_t old_bits = bits;
+        bits |= (std::uint64_t)1 << key;
+        return bits != old_bits;
+    }
+
+    bool erase(key_type key)
+    {
+        std::uint64_t old_bits = bits;
+        bits &= ~((std::uint64_t)1 << key);
+        return bits != old_bits;
+    }
+
+    void clear() { bits = 0; }
+
+private:
+    std::uint64_t bits = 0;
+};
+
+/* inner node, the low is not part of any subtree and the global sits inline */
+template <unsigned Bits>
+class node<Bits, false> {
+public:
+    /* nodes of up to two leaf universes keep leafs as locals, others split
+       in halves with at most 2^16 locals (same cap as lazy trees in vebtrees.h) */
+    static constexpr unsigned upper_bits = Bits <= 2 * leaf_bits ? Bits - leaf_bits
+        : ((Bits + 1) / 2 < max_upper_bits ? (Bits + 1) / 2 : max_upper_bits);
+    static constexpr unsigned lower_bits = Bits - upper_bits;
+    static constexpr std::size_t num_locals = (std::size_t)1 << upper_bits;
+
+    using global_type = node<upper_bits>;
+    using local_type = node<lower_bits>;
+
+    bool empty() const { return low == null; }
+    key_type min() const { return low; }
+    key_type max() const { return high; }
+
+    bool contains(key_type key) const
+    {
+        if (key == low || key == high) return true;
+        if (!locals) return false;
+        return locals[global_address(key)].contains(local_address(key));
+    }
+
+    key_type successor(key_type key) const
+    {
+        key_type global_key, local_max, global_succ;
+
+        if (low != null && key < low) return low;
+        if (!locals) return null;
+
+        /* case where the key's own local contains the successor */
+        global_key = global_address(key);
+        local_max = locals[global_key].max();
+        if (local_max != null && local_address(key) < local_max)
+            return (global_key << lower_bits) | locals[global_key].successor(local_address(key));
+
+        /* case where a neighbour contains the successor */
+        global_succ = global.successor(global_key);
+        return global_succ == null ? null : (global_succ << lower_bits) | locals[global_succ].min();
+    }
+
+    key_type predecessor(key_type key) const
+    {
+        key_type global_key, local_min, global_pred;
+
+        if (high != null && key > high) return high;
+        if (!locals) return null;
+
+        /* case where the key's own local contains the predecessor */
+        global_key = global_address(key);
+        local_min = locals[global_key].min();
+        if (local_min != null && local_address(key) > local_min)
+            return (global_key << lower_bits) | locals[global_key].predecessor(local_address(key));
+
+        /* case where a neighbour contains the predecessor, otherwise it's the low */
+        global_pred = global.predecessor(global_key);
+        if (global_pred == null)
+            return low != null && key > low ? low : null;
+        return (global_pred << lower_bits) | locals[global_pred].max();
+    }
+
+    bool insert(key_type key)
+    {
+        key_type global_key; bool inserted;
+
+        if (low == null) { low = high = key; return true; }
+        if (key == low) return false;
+        if (key < low) std::swap(key, low);
+
+        /* the locals are allocated once the first key is pushed down */
+        if (!locals) locals.reset(new local_type[num_locals]());
+
+        global_key = global_address(key);
+        if (locals[global_key].empty())
+            global.insert(global_key);
+
+        inserted = locals[global_key].insert(local_address(key));
+        if (key > high) high = key;
+        return inserted;
+    }
+
+    bool erase(key_type key)
+    {
+        key_type global_key, global_low, global_high;
+
+        if (low == null || key < low || key > high) return false;
+        if (low == high) { low = high = null; return true; }
+
+        /* deleting the low -> pull the new low out of the first local */
+        if (key == low) {
+            global_low = global.min();
+            low = key = (global_low << lower_bits) | locals[global_low].min();
+        }
+
+        global_key = global_address(key);
+        if (!locals[global_key].erase(local_address(key)))
+            return false;
+
+        if (locals[global_key].empty())
+            global.erase(global_key);
+
+        /* in case the maximum was deleted -> find the new maximum */
+        if (key == high) {
+            global_high = global.max();
+            high = global_high == null ? low : (global_high << lower_bits) | locals[global_high].max();
+        }
+
+        return true;
+    }
+
+    void clear()
+    {
+        low = high = null;
+        global.clear();
+        locals.reset();
+    }
+
+private:
+    static key_type global_address(key_type key) { return key >> lower_bits; }
+    static key_type local_address(key_type key) { return key & (((key_type)1 << lower_bits) - 1); }
+
+    key_type low = null;
+    key_type high = null;
+    global_type global;
+    std::unique_ptr<local_type[]> locals;
+};
+
+} /* namespace detail */
+#endif /* DOXYGEN_SKIP */
+
+/* ===================================== *
+ *              V E B   S E T
+ * ===================================== */
+
+/**
+ * @brief Ordered set of the keys within [0, 2^UniverseBits) with the interface of std::set.
+ * Lookups, successor / predecessor, inserts and deletes run in O(log log u). The set is
+ * movable but not copyable, iterators are invalidated by erasing the key they point to.
+ *
+ * @tparam UniverseBits the universe size managed by the set in bits, within [1, 64]
+ */
+template <unsigned UniverseBits>
+class set {
+    static_assert(UniverseBits >= 1 && UniverseBits <= 64,
+        "invalid amount of universe bits, needs to be within [1, 64]");
+
+public:
+    using key_type = veb::key_type;
+    using value_type = veb::key_type;
+    using size_type = std::size_t;
+
+    /**
+     * @brief Bidirectional iterator over the keys in ascending order.
+     */
+    class iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = veb::key_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const veb::key_type*;
+        using reference = veb::key_type; /* by value, the key is no stored element */
+
+        iterator() = default;
+        reference operator*() const { return key; }
+        pointer operator->() const { return &key; }
+
+        iterator& operator++() { key = owner->successor(key); return *this; }
+        iterator& operator--() { key = key == null ? owner->max() : owner->predecessor(key); return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+        iterator operator--(int) { iterator old = *this; --*this; return old; }
+
+        bool operator==(const iterator& other) const { return key == other.key; }
+        bool operator!=(const iterator& other) const { return key != other.key; }
+
+    private:
+        friend class set;
+        iterator(const set* owner, key_type key) : owner(owner), key(key) {}
+
+        const set* owner = nullptr;
+        key_type key = null;
+    };
+
+    using const_iterator = iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = reverse_iterator;
+
+    /**
+     * @brief The greatest key that can be inserted, 2^64-1 is reserved for null.
+     */
+    static constexpr key_type max_key = UniverseBits == 64 ? null - 1
+        : ((key_type)1 << (UniverseBits % 64)) - 1;
+
+    set() = default;
+    set(const set&) = delete;
+    set& operator=(const set&) = delete;
+
+    /**
+     * @brief Take over the other set's keys, leaving the other set empty.
+     */
+    set(set&& other) noexcept : root(std::move(other.root)), num_keys(other.num_keys)
+    {
+        other.reset_moved_from();
+    }
+
+    set& operator=(set&& other) noexcept
+    {
+        if (this != &other) {
+            root = std::move(other.root);
+            num_keys = other.num_keys;
+            other.reset_moved_from();
+        }
+        return *this;
+    }
+
+    bool empty() const { return num_keys == 0; }
+    size_type size() const { return num_keys; }
+    static constexpr size_type max_size() { return (size_type)max_key + (UniverseBits < 64); }
+
+    /**
+     * @brief Retrieve the smallest / greatest key, null if the set is empty.
+     */
+    key_type min() const { return root.min(); }
+    key_type max() const { return root.max(); }
+
+    /**
+     * @brief Retrieve the next greater / smaller key, null if there's none.
+     */
+    key_type successor(key_type key) const { return key >= max_key ? null : root.successor(key); }
+    key_type predecessor(key_type key) const
+    {
+        return key == 0 ? null : key > max_key ? max() : root.predecessor(key);
+    }
+
+    bool contains(key_type key) const { return key <= max_key && root.contains(key); }
+    size_type count(key_type key) const { return contains(key) ? 1 : 0; }
+
+    std::pair<iterator, bool> insert(key_type key)
+    {
+        bool inserted;
+        assert(key <= max_key && "key out of the set's universe!");
+        inserted = root.insert(key);
+        num_keys += inserted;
+        return std::make_pair(iterator(this, key), inserted);
+    }
+
+    size_type erase(key_type key)
+    {
+        bool erased = key <= max_key && root.erase(key);
+        num_keys -= erased;
+        return erased ? 1 : 0;
+    }
+
+    iterator erase(iterator pos)
+    {
+        iterator next = std::next(pos);
+        erase(*pos);
+        return next;
+    }
+
+    void clear() { root.clear(); num_keys = 0; }
+
+    iterator find(key_type key) const { return iterator(this, contains(key) ? key : null); }
+
+    /**
+     * @brief Retrieve the first key not less than / greater than the given key.
+     */
+    iterator lower_bound(key_type key) const { return iterator(this, key == 0 ? min() : successor(key - 1)); }
+    iterator upper_bound(key_type key) const { return iterator(this, successor(key)); }
+
+    iterator begin() const { return iterator(this, min()); }
+    iterator end() const { return iterator(this, null); }
+    iterator cbegin() const { return begin(); }
+    iterator cend() const { return end(); }
+    reverse_iterator rbegin() const { return reverse_iterator(end()); }
+    reverse_iterator rend() const { return reverse_iterator(begin()); }
+
+private:
+    void reset_moved_from()
+    {
+        /* the moved-from root still holds the low / high keys while its subtrees are gone */
+        root.clear();
+        num_keys = 0;
+    }
+
+    detail::node<UniverseBits> root;
+    size_type num_keys = 0;
+};
+
+} /* namespace veb */
+
+#endif /* VEBTREES_HPP */
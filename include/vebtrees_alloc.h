@@ -0,0 +1,267 @@
+/* MIT License
+ *
+ * Copyright (c) 2022 Marco Tröster
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VEBTREES_ALLOC_H
+#define VEBTREES_ALLOC_H
+
+#include <string.h>
+#include <sys/mman.h>
+#include "vebtrees.h"
+
+/* ===================================== *
+ *      T Y P E S   /  S T R U C T S
+ * ===================================== */
+
+/**
+ * @brief The size of the huge pages backing a VebHugePageAllocator (x86-64 / ARM64 default).
+ */
+#define VEBTREE_HUGEPAGE_SIZE ((size_t)1 << 21)
+
+/**
+ * @brief The amount of distinct block sizes a VebHugePageAllocator keeps free lists for.
+ */
+#define VEBTREE_HUGEPAGE_FREE_LISTS 32
+
+/**
+ * @brief Bump allocator handing out a buffer front to back. Freed memory is only taken
+ * back when it was the latest allocation, so it suits trees that are built once and
+ * freed as a whole. The VebBumpAllocator must not be moved while trees refer to it.
+ */
+typedef struct _VEB_BUMP_ALLOCATOR {
+    VebAllocator allocator;
+    /**< The callbacks to be passed to vebtree_init_with_allocator(). */
+    uint8_t* buffer;
+    /**< The memory handed out by the allocator. */
+    size_t capacity;
+    /**< The size of the buffer in bytes. */
+    size_t used;
+    /**< The bytes at the buffer's start that are handed out already. */
+} VebBumpAllocator;
+
+/**
+ * @brief Allocator placing the nodes into an anonymous mapping that is advised to be
+ * backed by transparent huge pages (MADV_HUGEPAGE), so lookups walking many nodes
+ * miss the TLB less often. The mapping reserves address space for the given capacity,
+ * physical memory is only taken once it's touched. Freed blocks are reused through
+ * free lists per block size, so lazy / shrinking trees don't grow the mapping forever.
+ * The VebHugePageAllocator must not be moved while trees refer to it.
+ */
+typedef struct _VEB_HUGEPAGE_ALLOCATOR {
+    VebAllocator allocator;
+    /**< The callbacks to be passed to vebtree_init_with_allocator(). */
+    VebBumpAllocator arena;
+    /**< The huge page aligned part of the mapping, handed out front to back. */
+    void* mapping;
+    /**< The start of the mapping. */
+    size_t mapping_bytes;
+    /**< The size of the mapping in bytes. */
+    bool first_touch;
+    /**< Whether each huge page is touched by the allocating thread right away. */
+    size_t touched;
+    /**< The bytes of the arena touched so far (first-touch policy only). */
+    struct {
+        size_t bytes;
+        /**< The block size of the list, 0 for unused lists. */
+        void* head;
+        /**< The first free block, each free block starts with a pointer to the next one. */
+    } free_lists[VEBTREE_HUGEPAGE_FREE_LISTS];
+    /**< The freed blocks by block size. */
+} VebHugePageAllocator;
+
+/* ===================================== *
+ *          F U N C T I O N S
+ * ===================================== */
+
+/**
+ * @brief Initialize a bump allocator handing out the given buffer.
+ *
+ * @param bump the allocator to be initialized
+ * @param buffer the memory to be handed out, aligned to 16 bytes
+ * @param capacity the size of the buffer in bytes
+ */
+void vebtree_bump_allocator_init(VebBumpAllocator* bump, void* buffer, size_t capacity);
+
+/**
+ * @brief Take back all memory handed out by the bump allocator at once. The trees
+ * allocated from it must not be used or freed anymore afterwards.
+ *
+ * @param bump the allocator to be reset
+ */
+void vebtree_bump_allocator_reset(VebBumpAllocator* bump);
+
+/**
+ * @brief Initialize a huge page allocator reserving address space for the given capacity.
+ * With the first-touch policy, each huge page is touched by the thread allocating its first
+ * block, so the kernel backs it right away on that thread's NUMA node. Building a tree on a
+ * thread pinned to the node that queries it places the tree there without libnuma.
+ *
+ * @param allocator the allocator to be initialized
+ * @param capacity the maximum amount of bytes handed out by the allocator
+ * @param first_touch whether to touch each huge page on its first allocation
+ * @return a boolean whether the address space could be reserved
+ */
+bool vebtree_hugepage_allocator_init(VebHugePageAllocator* allocator, size_t capacity, bool first_touch);
+
+/**
+ * @brief Unmap the memory of a huge page allocator. The trees allocated from it
+ * must not be used or freed anymore afterwards.
+ *
+ * @param allocator the allocator to be destroyed
+ */
+void vebtree_hugepage_allocator_destroy(VebHugePageAllocator* allocator);
+
+#ifndef DOXYGEN_SKIP
+
+/* ===================================== *
+ *      B U M P   A L L O C A T O R
+ * ===================================== */
+
+#define vebtree_alloc_aligned(bytes) (((bytes) + 15) & ~(size_t)15)
+
+void* _vebtree_bump_alloc(void* context, size_t bytes)
+{
+    VebBumpAllocator* bump = (VebBumpAllocator*)context; void* memory;
+
+    bytes = vebtree_alloc_aligned(bytes);
+    if (bytes > bump->capacity - bump->used) return NULL;
+
+    memory = bump->buffer + bump->used;
+    bump->used += bytes;
+    return memory;
+}
+
+void _vebtree_bump_free(void* context, void* memory, size_t bytes)
+{
+    VebBumpAllocator* bump = (VebBumpAllocator*)context;
+
+    /* only the latest allocation can be taken back */
+    bytes = vebtree_alloc_aligned(bytes);
+    if ((uint8_t*)memory + bytes == bump->buffer + bump->used)
+        bump->used -= bytes;
+}
+
+void vebtree_bump_allocator_init(VebBumpAllocator* bump, void* buffer, size_t capacity)
+{
+    bump->allocator.alloc = _vebtree_bump_alloc;
+    bump->allocator.free = _vebtree_bump_free;
+    bump->allocator.context = bump;
+    bump->buffer = (uint8_t*)buffer;
+    bump->capacity = capacity;
+    bump->used = 0;
+}
+
+void vebtree_bump_allocator_reset(VebBumpAllocator* bump)
+{
+    bump->used = 0;
+}
+
+/* ===================================== *
+ *   H U G E   P A G E   A L L O C A T O R
+ * ===================================== */
+
+/* the free list of the given block size, claiming an unused list if there's none yet */
+void** _vebtree_hugepage_free_list(VebHugePageAllocator* allocator, size_t bytes, bool claim)
+{
+    size_t i;
+
+    for (i = 0; i < VEBTREE_HUGEPAGE_FREE_LISTS; i++) {
+        if (allocator->free_lists[i].bytes == bytes)
+            return &(allocator->free_lists[i].head);
+        if (allocator->free_lists[i].bytes == 0) {
+            if (!claim) return NULL;
+            allocator->free_lists[i].bytes = bytes;
+            return &(allocator->free_lists[i].head);
+        }
+    }
+    return NULL;
+}
+
+void* _vebtree_hugepage_alloc(void* context, size_t bytes)
+{
+    VebHugePageAllocator* allocator = (VebHugePageAllocator*)context;
+    void **free_list, *memory;
+
+    /* reuse a freed block of the same size first */
+    bytes = vebtree_alloc_aligned(bytes);
+    free_list = _vebtree_hugepage_free_list(allocator, bytes, false);
+    if (free_list != NULL && *free_list != NULL) {
+        memory = *free_list;
+        *free_list = *(void**)memory;
+        return memory;
+    }
+
+    memory = _vebtree_bump_alloc(&(allocator->arena), bytes);
+    if (memory == NULL || !allocator->first_touch) return memory;
+
+    /* first-touch policy: back the new huge pages on the allocating thread's NUMA node */
+    for (; allocator->touched < allocator->arena.used; allocator->touched += VEBTREE_HUGEPAGE_SIZE)
+        allocator->arena.buffer[allocator->touched] = 0;
+    return memory;
+}
+
+void _vebtree_hugepage_free(void* context, void* memory, size_t bytes)
+{
+    VebHugePageAllocator* allocator = (VebHugePageAllocator*)context; void** free_list;
+
+    /* blocks of sizes without a free list stay unused until the allocator is destroyed */
+    bytes = vebtree_alloc_aligned(bytes);
+    free_list = _vebtree_hugepage_free_list(allocator, bytes, true);
+    if (free_list == NULL) return;
+
+    *(void**)memory = *free_list;
+    *free_list = memory;
+}
+
+bool vebtree_hugepage_allocator_init(VebHugePageAllocator* allocator, size_t capacity, bool first_touch)
+{
+    uint8_t* arena;
+
+    /* reserve an extra huge page to align the arena's start to the huge pages */
+    memset(allocator, 0, sizeof(VebHugePageAllocator));
+    allocator->mapping_bytes = capacity + VEBTREE_HUGEPAGE_SIZE;
+    allocator->mapping = mmap(NULL, allocator->mapping_bytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (allocator->mapping == MAP_FAILED) return false;
+
+    arena = (uint8_t*)(((uintptr_t)allocator->mapping + VEBTREE_HUGEPAGE_SIZE - 1)
+        & ~(uintptr_t)(VEBTREE_HUGEPAGE_SIZE - 1));
+#ifdef MADV_HUGEPAGE
+    madvise(arena, capacity, MADV_HUGEPAGE);
+#endif
+
+    vebtree_bump_allocator_init(&(allocator->arena), arena, capacity);
+    allocator->allocator.alloc = _vebtree_hugepage_alloc;
+    allocator->allocator.free = _vebtree_hugepage_free;
+    allocator->allocator.context = allocator;
+    allocator->first_touch = first_touch;
+    return true;
+}
+
+void vebtree_hugepage_allocator_destroy(VebHugePageAllocator* allocator)
+{
+    munmap(allocator->mapping, allocator->mapping_bytes);
+    allocator->mapping = NULL;
+}
+
+#endif /* DOXYGEN_SKIP */
+#endif /* VEBTREES_ALLOC_H */
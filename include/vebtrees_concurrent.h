@@ -0,0 +1,981 @@
+/* MIT License
+ *
+ * Copyright (c) 2022 Marco Tröster
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VEBTREES_CONCURRENT_H
+#define VEBTREES_CONCURRENT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <string.h>
+#include "vebtrees.h"
+
+/* ===================================== *
+ *      T Y P E S   /  S T R U C T S
+ * ===================================== */
+
+/**
+ * @brief The maximum amount of shard bits, i.e. up to 2^16 shards per tree.
+ */
+#define VEBTREE_SHARDED_MAX_SHARD_BITS 16
+
+/**
+ * @brief A single shard of a sharded tree, guarded by its own reader-writer lock.
+ */
+typedef struct _VEB_TREE_SHARD {
+    pthread_rwlock_t lock;
+    /**< The lock guarding all accesses to the shard's tree. */
+    VebTree* tree;
+    /**< The tree managing the lower key bits of the shard's keys. */
+} VebShard;
+
+/**
+ * @brief Thread-safe van Emde Boas tree front-end splitting the key space
+ * by its upper shard bits into independently locked trees. Operations on
+ * keys of different shards run in parallel, and a bitmap of non-empty shards
+ * lets min / max / successor / predecessor skip over empty shards.
+ */
+typedef struct _VEB_SHARDED_TREE {
+    uint8_t universe_bits;
+    /**< The universe bits defining the key space managed by the tree. */
+    uint8_t shard_bits;
+    /**< The upper key bits selecting the shard of a key. */
+    uint8_t lower_bits;
+    /**< The universe bits managed by each shard's tree. */
+    uint8_t flags;
+    /**< The flags that the shards' trees were created with. */
+    size_t num_shards;
+    /**< The amount of shards, i.e. 2^shard_bits. */
+    VebShard* shards;
+    /**< The shards array. */
+    _Atomic uint64_t* nonempty;
+    /**< The bitmap of shards that contain at least one key. */
+} VebShardedTree;
+
+/* ===================================== *
+ *          F U N C T I O N S
+ * ===================================== */
+
+/**
+ * @brief Create a new thread-safe sharded van Emde Boas tree.
+ *
+ * @param tree a reference pointer that is set to the
+ *             newly allocated tree structure's reference.
+ * @param universe_bits the universe size to be managed by the tree in bits
+ * @param shard_bits the upper key bits selecting a key's shard, i.e. the tree
+ *                   consists of 2^shard_bits shards (should be a few times the
+ *                   amount of threads accessing the tree concurrently)
+ * @param flags a collection of flags that each shard's tree is created with
+ */
+void vebtree_sharded_init(VebShardedTree** tree, uint8_t universe_bits, uint8_t shard_bits, uint8_t flags);
+
+/**
+ * @brief Free the given tree structure and all its shards.
+ * Note that no other thread is allowed to access the tree anymore.
+ *
+ * @param tree the tree to be freed
+ */
+void vebtree_sharded_free(VebShardedTree* tree);
+
+/**
+ * @brief Look up whether the given key is inserted.
+ *
+ * @param tree the tree to be looked up
+ * @param key the key to be looked up
+ * @return a boolean whether the key is inserted
+ */
+bool vebtree_sharded_contains_key(VebShardedTree* tree, vebkey_t key);
+
+/**
+ * @brief Look up whether the tree contains any keys.
+ * Note that the result is only a snapshot in presence of concurrent writers.
+ *
+ * @param tree the tree to be looked up
+ * @return a boolean whether the tree is empty
+ */
+bool vebtree_sharded_is_empty(VebShardedTree* tree);
+
+/**
+ * @brief Retrieve the smallest key inserted into the tree.
+ *
+ * @param tree the tree to be looked up
+ * @return the smallest key or vebtree_null if the tree is empty
+ */
+vebkey_t vebtree_sharded_get_min(VebShardedTree* tree);
+
+/**
+ * @brief Retrieve the greatest key inserted into the tree.
+ *
+ * @param tree the tree to be looked up
+ * @return the greatest key or vebtree_null if the tree is empty
+ */
+vebkey_t vebtree_sharded_get_max(VebShardedTree* tree);
+
+/**
+ * @brief Retrieve the successor of the given key, crossing shards if required.
+ * Note that the shards are locked one after another, so a concurrently
+ * inserted key in a skipped shard may not be observed.
+ *
+ * @param tree the tree to be looked up
+ * @param key the key to be looked up
+ * @return the key's successor or vebtree_null if there's none
+ */
+vebkey_t vebtree_sharded_successor(VebShardedTree* tree, vebkey_t key);
+
+/**
+ * @brief Retrieve the predecessor of the given key, crossing shards if required.
+ * Note that the shards are locked one after another, so a concurrently
+ * inserted key in a skipped shard may not be observed.
+ *
+ * @param tree the tree to be looked up
+ * @param key the key to be looked up
+ * @return the key's predecessor or vebtree_null if there's none
+ */
+vebkey_t vebtree_sharded_predecessor(VebShardedTree* tree, vebkey_t key);
+
+/**
+ * @brief Insert the given key into the tree.
+ *
+ * @param tree the tree to be modified
+ * @param key the key to be inserted
+ */
+void vebtree_sharded_insert_key(VebShardedTree* tree, vebkey_t key);
+
+/**
+ * @brief Delete the given key from the tree. Keys that aren't part of the tree
+ * are ignored, so concurrent callers don't need to check for them upfront.
+ *
+ * @param tree the tree to be modified
+ * @param key the key to be deleted
+ */
+void vebtree_sharded_delete_key(VebShardedTree* tree, vebkey_t key);
+
+/**
+ * @brief Create a new van Emde Boas tree structure like vebtree_init(), but spread
+ * the allocation of fully allocated trees across a pool of worker threads.
+ * Lazy trees are created as usual since they don't allocate any subtrees upfront.
+ *
+ * @param tree a reference pointer that is set to the
+ *             newly allocated tree structure's reference.
+ * @param universe_bits the universe size to be managed by the tree in bits
+ * @param flags a collection of flags adjusting the tree's behavior (see vebtree_init())
+ * @param num_threads the amount of worker threads, 0 for one per online processor
+ */
+void vebtree_init_parallel(VebTree** tree, uint8_t universe_bits, uint8_t flags, size_t num_threads);
+
+/**
+ * @brief Free the given tree structure like vebtree_free(),
+ * but spread the deallocation across a pool of worker threads.
+ *
+ * @param tree the tree to be freed
+ * @param num_threads the amount of worker threads, 0 for one per online processor
+ */
+void vebtree_free_parallel(VebTree* tree, size_t num_threads);
+
+/**
+ * @brief Insert the given keys like vebtree_insert_keys(), but build the root's
+ * local subtrees on a pool of worker threads. The keys are partitioned in parallel
+ * by the root's global address first, so each worker owns a disjoint range of locals.
+ *
+ * @param tree the tree to be inserted into
+ * @param keys the keys to be inserted
+ * @param num_keys the amount of keys to be inserted
+ * @param num_threads the amount of worker threads, 0 for one per online processor
+ */
+void vebtree_insert_keys_parallel(VebTree* tree, const vebkey_t keys[], size_t num_keys, size_t num_threads);
+
+/**
+ * @brief Sort arbitrary 64-bit keys like vebtree_sort(), but split the keys into
+ * buckets by their upper bits (relative to the min. key) and sort each bucket
+ * by vebtree_sort() on a pool of worker threads.
+ *
+ * @param keys the keys to be sorted
+ * @param num_keys the amount of keys to be sorted
+ * @param output the array to write the sorted keys to (may not overlap the keys)
+ * @param flags VEBTREE_SORT_UNIQUE drops duplicate keys, VEBTREE_SORT_DEFAULT keeps them
+ * @param num_threads the amount of worker threads, 0 for one per online processor
+ * @return the amount of keys written
+ */
+size_t vebtree_sort_parallel(const vebkey_t keys[], size_t num_keys, vebkey_t output[],
+                             uint8_t flags, size_t num_threads);
+
+#ifndef DOXYGEN_SKIP
+
+/* ===================================== *
+ *         S H A R D   I N D E X
+ * ===================================== */
+
+#define vebtree_sharded_shard_of(tree, key) ((key) >> (tree)->lower_bits)
+#define vebtree_sharded_local_key(tree, key) vebtree_local_address(key, (tree)->lower_bits)
+#define vebtree_sharded_compose(tree, shard, local_key) \
+    (((vebkey_t)(shard) << (tree)->lower_bits) | (local_key))
+#define vebtree_sharded_bitmap_words(num_shards) (((num_shards) + 63) >> 6)
+
+/* find the first non-empty shard >= shard, returns num_shards if there's none */
+size_t _vebtree_sharded_next_shard(VebShardedTree* tree, size_t shard)
+{
+    size_t word, num_words; uint64_t bits;
+    if (shard >= tree->num_shards) return tree->num_shards;
+
+    num_words = vebtree_sharded_bitmap_words(tree->num_shards);
+    word = shard >> 6;
+    bits = atomic_load(&tree->nonempty[word]) & leading_bits_mask(shard & 63);
+
+    while (bits == 0) {
+        if (++word == num_words) return tree->num_shards;
+        bits = atomic_load(&tree->nonempty[word]);
+    }
+
+    return (word << 6) + min_bit_set(bits);
+}
+
+/* find the last non-empty shard < shard, returns num_shards if there's none */
+size_t _vebtree_sharded_prev_shard(VebShardedTree* tree, size_t shard)
+{
+    size_t word; uint64_t bits;
+    if (shard == 0) return tree->num_shards;
+
+    shard--;
+    word = shard >> 6;
+    bits = atomic_load(&tree->nonempty[word]) & (0xFFFFFFFFFFFFFFFF >> (63 - (shard & 63)));
+
+    while (bits == 0) {
+        if (word-- == 0) return tree->num_shards;
+        bits = atomic_load(&tree->nonempty[word]);
+    }
+
+    return (word << 6) + max_bit_set(bits);
+}
+
+/* ===================================== *
+ *       S H A R D E D   T R E E
+ * ===================================== */
+
+void vebtree_sharded_init(VebShardedTree** new_tree, uint8_t universe_bits, uint8_t shard_bits, uint8_t flags)
+{
+    size_t i, num_words; VebShardedTree* tree;
+
+    assert((universe_bits > 0 && universe_bits <= 64)
+        && "invalid amount of universe bits, needs to be within [1, 64].");
+    assert(shard_bits > 0 && shard_bits < universe_bits && shard_bits <= VEBTREE_SHARDED_MAX_SHARD_BITS
+        && "invalid amount of shard bits, needs to be within [1, min(universe bits - 1, 16)].");
+
+    tree = (VebShardedTree*)malloc(sizeof(VebShardedTree));
+    assert(tree != NULL && "sharded tree allocation failed unexpectedly!");
+
+    tree->universe_bits = universe_bits;
+    tree->shard_bits = shard_bits;
+    tree->lower_bits = universe_bits - shard_bits;
+    tree->flags = flags;
+    tree->num_shards = (size_t)1 << shard_bits;
+
+    tree->shards = (VebShard*)malloc(sizeof(VebShard) * tree->num_shards);
+    assert(tree->shards != NULL && "shards allocation failed unexpectedly!");
+
+    num_words = vebtree_sharded_bitmap_words(tree->num_shards);
+    tree->nonempty = (_Atomic uint64_t*)malloc(sizeof(uint64_t) * num_words);
+    assert(tree->nonempty != NULL && "shard bitmap allocation failed unexpectedly!");
+
+    for (i = 0; i < num_words; i++)
+        atomic_init(&tree->nonempty[i], 0);
+
+    for (i = 0; i < tree->num_shards; i++) {
+        pthread_rwlock_init(&tree->shards[i].lock, NULL);
+        vebtree_init(&tree->shards[i].tree, tree->lower_bits, flags);
+    }
+
+    *new_tree = tree;
+}
+
+void vebtree_sharded_free(VebShardedTree* tree)
+{
+    size_t i;
+
+    for (i = 0; i < tree->num_shards; i++) {
+        pthread_rwlock_destroy(&tree->shards[i].lock);
+        vebtree_free(tree->shards[i].tree);
+    }
+
+    free((void*)tree->nonempty);
+    free(tree->shards);
+    free(tree);
+}
+
+bool vebtree_sharded_contains_key(VebShardedTree* tree, vebkey_t key)
+{
+    size_t shard; bool contains;
+
+    shard = vebtree_sharded_shard_of(tree, key);
+    if (shard >= tree->num_shards) return false;
+
+    pthread_rwlock_rdlock(&tree->shards[shard].lock);
+    contains = vebtree_contains_key(tree->shards[shard].tree, vebtree_sharded_local_key(tree, key));
+    pthread_rwlock_unlock(&tree->shards[shard].lock);
+    return contains;
+}
+
+bool vebtree_sharded_is_empty(VebShardedTree* tree)
+{
+    return _vebtree_sharded_next_shard(tree, 0) == tree->num_shards;
+}
+
+/* retrieve the min of the first non-empty shard >= shard, skipping
+   shards that were emptied concurrently after reading the bitmap */
+vebkey_t _vebtree_sharded_min_from(VebShardedTree* tree, size_t shard)
+{
+    vebkey_t min;
+
+    for (shard = _vebtree_sharded_next_shard(tree, shard); shard < tree->num_shards;
+            shard = _vebtree_sharded_next_shard(tree, shard + 1)) {
+        pthread_rwlock_rdlock(&tree->shards[shard].lock);
+        min = vebtree_get_min(tree->shards[shard].tree);
+        pthread_rwlock_unlock(&tree->shards[shard].lock);
+        if (min != vebtree_null) return vebtree_sharded_compose(tree, shard, min);
+    }
+
+    return vebtree_null;
+}
+
+/* retrieve the max of the last non-empty shard < shard, skipping
+   shards that were emptied concurrently after reading the bitmap */
+vebkey_t _vebtree_sharded_max_before(VebShardedTree* tree, size_t shard)
+{
+    vebkey_t max;
+
+    for (shard = _vebtree_sharded_prev_shard(tree, shard); shard < tree->num_shards;
+            shard = _vebtree_sharded_prev_shard(tree, shard)) {
+        pthread_rwlock_rdlock(&tree->shards[shard].lock);
+        max = vebtree_get_max(tree->shards[shard].tree);
+        pthread_rwlock_unlock(&tree->shards[shard].lock);
+        if (max != vebtree_null) return vebtree_sharded_compose(tree, shard, max);
+    }
+
+    return vebtree_null;
+}
+
+vebkey_t vebtree_sharded_get_min(VebShardedTree* tree)
+{
+    return _vebtree_sharded_min_from(tree, 0);
+}
+
+vebkey_t vebtree_sharded_get_max(VebShardedTree* tree)
+{
+    return _vebtree_sharded_max_before(tree, tree->num_shards);
+}
+
+vebkey_t vebtree_sharded_successor(VebShardedTree* tree, vebkey_t key)
+{
+    size_t shard; vebkey_t succ;
+
+    shard = vebtree_sharded_shard_of(tree, key);
+    if (shard >= tree->num_shards) return vebtree_null;
+
+    /* look for the successor within the key's own shard first */
+    pthread_rwlock_rdlock(&tree->shards[shard].lock);
+    succ = vebtree_successor(tree->shards[shard].tree, vebtree_sharded_local_key(tree, key));
+    pthread_rwlock_unlock(&tree->shards[shard].lock);
+    if (succ != vebtree_null) return vebtree_sharded_compose(tree, shard, succ);
+
+    /* otherwise it's the min of the next non-empty shard */
+    return _vebtree_sharded_min_from(tree, shard + 1);
+}
+
+vebkey_t vebtree_sharded_predecessor(VebShardedTree* tree, vebkey_t key)
+{
+    size_t shard; vebkey_t pred;
+
+    shard = vebtree_sharded_shard_of(tree, key);
+    if (shard >= tree->num_shards) return vebtree_sharded_get_max(tree);
+
+    /* look for the predecessor within the key's own shard first */
+    pthread_rwlock_rdlock(&tree->shards[shard].lock);
+    pred = vebtree_predecessor(tree->shards[shard].tree, vebtree_sharded_local_key(tree, key));
+    pthread_rwlock_unlock(&tree->shards[shard].lock);
+    if (pred != vebtree_null) return vebtree_sharded_compose(tree, shard, pred);
+
+    /* otherwise it's the max of the previous non-empty shard */
+    return _vebtree_sharded_max_before(tree, shard);
+}
+
+void vebtree_sharded_insert_key(VebShardedTree* tree, vebkey_t key)
+{
+    size_t shard;
+
+    shard = vebtree_sharded_shard_of(tree, key);
+    assert(shard < tree->num_shards && "key exceeds the tree's universe!");
+
+    /* mark the shard as non-empty while still holding its write lock,
+       so readers never skip a shard that already contains keys */
+    pthread_rwlock_wrlock(&tree->shards[shard].lock);
+    vebtree_insert_key(tree->shards[shard].tree, vebtree_sharded_local_key(tree, key));
+    atomic_fetch_or(&tree->nonempty[shard >> 6], (uint64_t)1 << (shard & 63));
+    pthread_rwlock_unlock(&tree->shards[shard].lock);
+}
+
+void vebtree_sharded_delete_key(VebShardedTree* tree, vebkey_t key)
+{
+    size_t shard; vebkey_t local_key;
+
+    shard = vebtree_sharded_shard_of(tree, key);
+    if (shard >= tree->num_shards) return;
+    local_key = vebtree_sharded_local_key(tree, key);
+
+    /* the deletion assumes the key to be present, so check it under the same write lock */
+    pthread_rwlock_wrlock(&tree->shards[shard].lock);
+    if (!vebtree_contains_key(tree->shards[shard].tree, local_key)) {
+        pthread_rwlock_unlock(&tree->shards[shard].lock);
+        return;
+    }
+    vebtree_delete_key(tree->shards[shard].tree, local_key);
+    if (vebtree_is_empty(tree->shards[shard].tree))
+        atomic_fetch_and(&tree->nonempty[shard >> 6], ~((uint64_t)1 << (shard & 63)));
+    pthread_rwlock_unlock(&tree->shards[shard].lock);
+}
+
+/* ===================================== *
+ *        P A R A L L E L   F O R
+ * ===================================== */
+
+/* subtrees below this size are built / freed by a single thread */
+#define VEBTREE_PARALLEL_MIN_BITS 16
+
+typedef void (*vebtree_parallel_func)(void* context, size_t begin, size_t end);
+
+typedef struct _VEB_TREE_PARALLEL_TASK {
+    vebtree_parallel_func func;
+    void* context;
+    size_t begin;
+    size_t end;
+} VebParallelTask;
+
+size_t _vebtree_num_workers(size_t num_threads)
+{
+    long num_procs;
+    if (num_threads > 0) return num_threads;
+    num_procs = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_procs > 0 ? (size_t)num_procs : 1;
+}
+
+void* _vebtree_parallel_worker(void* task_ptr)
+{
+    VebParallelTask* task = (VebParallelTask*)task_ptr;
+    task->func(task->context, task->begin, task->end);
+    return NULL;
+}
+
+/* run func on contiguous chunks of [0, num_items), the calling thread takes the first chunk */
+void _vebtree_parallel_for(size_t num_items, size_t num_threads, vebtree_parallel_func func, void* context)
+{
+    size_t t; VebParallelTask* tasks; pthread_t* threads;
+
+    num_threads = num_threads < num_items ? num_threads : num_items;
+    if (num_threads <= 1) {
+        if (num_items > 0) func(context, 0, num_items);
+        return;
+    }
+
+    tasks = (VebParallelTask*)malloc(num_threads * sizeof(VebParallelTask));
+    threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    assert(tasks != NULL && threads != NULL && "worker pool allocation failed unexpectedly!");
+
+    for (t = 0; t < num_threads; t++) {
+        tasks[t].func = func;
+        tasks[t].context = context;
+        tasks[t].begin = num_items * t / num_threads;
+        tasks[t].end = num_items * (t + 1) / num_threads;
+    }
+
+    for (t = 1; t < num_threads; t++)
+        pthread_create(&threads[t], NULL, _vebtree_parallel_worker, &tasks[t]);
+    _vebtree_parallel_worker(&tasks[0]);
+    for (t = 1; t < num_threads; t++)
+        pthread_join(threads[t], NULL);
+
+    free(threads);
+    free(tasks);
+}
+
+/* ===================================== *
+ *     P A R A L L E L   I N I T / F R E E
+ * ===================================== */
+
+typedef struct _VEB_TREE_PARALLEL_SUBTREES {
+    VebTree* tree;
+    uint8_t flags;
+    uint8_t* arena;
+    /**< The start of the locals' subtrees for arena trees, NULL otherwise. */
+    size_t local_arena_size;
+} VebParallelSubtrees;
+
+void _vebtree_init_locals_range(void* context, size_t begin, size_t end)
+{
+    size_t i; uint8_t* arena; VebParallelSubtrees* sub = (VebParallelSubtrees*)context;
+
+    /* leaf clusters don't have any subtrees, they just need to be cleared */
+    if (vebtree_local_is_leaf(sub->tree->lower_bits, sub->flags)) {
+        memset(vebtree_leaf_cluster(sub->tree, begin), 0, (end - begin) * VEBTREE_LEAF_BYTES);
+        return;
+    }
+
+    if (sub->arena == NULL) {
+        for (i = begin; i < end; i++)
+            _vebtree_init(sub->tree->locals + i, sub->tree->lower_bits, sub->flags, sub->tree->allocator, false);
+        return;
+    }
+
+    /* each local's subtrees sit at a fixed offset within the arena */
+    for (i = begin; i < end; i++) {
+        _vebtree_init_node(sub->tree->locals + i, sub->tree->lower_bits, sub->flags, false);
+        arena = sub->arena + i * sub->local_arena_size;
+        _init_subtrees_arena(sub->tree->locals + i, sub->flags, &arena);
+    }
+}
+
+void _vebtree_free_locals_range(void* context, size_t begin, size_t end)
+{
+    size_t i; VebParallelSubtrees* sub = (VebParallelSubtrees*)context;
+    for (i = begin; i < end; i++)
+        _free_subtrees(sub->tree->locals + i);
+}
+
+/* same layout as _init_subtrees_arena(), but with the locals' subtrees built in parallel */
+void _init_subtrees_arena_parallel(VebTree* tree, uint8_t flags, uint8_t* arena, size_t num_threads)
+{
+    size_t num_locals, global_arena_size; VebParallelSubtrees sub;
+
+    if (tree->universe_bits < VEBTREE_PARALLEL_MIN_BITS) {
+        _init_subtrees_arena(tree, flags, &arena);
+        return;
+    }
+
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    tree->locals = (VebTree*)arena + 1;
+    arena += vebtree_subtrees_bytes(tree->upper_bits, tree->lower_bits, flags);
+    if (flags & VEBTREE_FLAG_COUNTS) _vebtree_counts_clear(tree);
+
+    _vebtree_init_node(vebtree_owned_global(tree), tree->upper_bits, vebtree_global_flags(flags), false);
+    global_arena_size = _vebtree_arena_size(tree->upper_bits,
+        vebtree_owned_global(tree)->lower_bits, vebtree_global_flags(flags));
+    if (!vebtree_is_leaf(vebtree_owned_global(tree)))
+        _init_subtrees_arena_parallel(vebtree_owned_global(tree), vebtree_global_flags(flags), arena, num_threads);
+
+    /* the full locals' subtrees follow the global's ones */
+    if (vebtree_tracks_full(flags)) {
+        arena += global_arena_size;
+        _vebtree_init_node(vebtree_full_locals(tree), tree->upper_bits, flags, false);
+        if (!vebtree_is_leaf(vebtree_full_locals(tree)))
+            _init_subtrees_arena_parallel(vebtree_full_locals(tree), flags, arena, num_threads);
+    }
+
+    sub.tree = tree; sub.flags = flags;
+    sub.arena = arena + global_arena_size;
+    sub.local_arena_size = _vebtree_arena_size(tree->lower_bits,
+        vebtree_lower_bits(tree->lower_bits), flags);
+    _vebtree_parallel_for(num_locals, num_threads, _vebtree_init_locals_range, &sub);
+}
+
+void _init_subtrees_parallel(VebTree* tree, uint8_t flags, size_t num_threads)
+{
+    size_t num_locals; VebParallelSubtrees sub;
+
+    if (tree->universe_bits < VEBTREE_PARALLEL_MIN_BITS) {
+        _init_subtrees(tree, flags);
+        return;
+    }
+
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    tree->locals = (VebTree*)malloc(vebtree_subtrees_bytes(tree->upper_bits, tree->lower_bits, flags));
+    assert(tree->locals != NULL && "subtree allocation failed unexpectedly!");
+    tree->locals++;
+    if (flags & VEBTREE_FLAG_COUNTS) _vebtree_counts_clear(tree);
+
+    _vebtree_init_node(vebtree_owned_global(tree), tree->upper_bits, vebtree_global_flags(flags), false);
+    if (!vebtree_is_leaf(vebtree_owned_global(tree)))
+        _init_subtrees_parallel(vebtree_owned_global(tree), vebtree_global_flags(flags), num_threads);
+    if (vebtree_tracks_full(flags))
+        _vebtree_init_node(vebtree_full_locals(tree), tree->upper_bits, flags, false);
+
+    sub.tree = tree; sub.flags = flags; sub.arena = NULL;
+    _vebtree_parallel_for(num_locals, num_threads, _vebtree_init_locals_range, &sub);
+}
+
+void _free_subtrees_parallel(VebTree* tree, size_t num_threads)
+{
+    VebParallelSubtrees sub;
+
+    if (vebtree_is_leaf(tree) || !vebtree_has_subtrees(tree))
+        return;
+
+    /* custom allocators aren't necessarily thread-safe, so their trees are freed sequentially */
+    if (tree->universe_bits < VEBTREE_PARALLEL_MIN_BITS || vebtree_is_sparse(tree)
+            || vebtree_is_cow(tree) || tree->allocator != 0) {
+        _free_subtrees(tree);
+        return;
+    }
+
+    /* leaf clusters are released along with the block */
+    _free_subtrees_parallel(vebtree_owned_global(tree), num_threads);
+    if (vebtree_tracks_full(tree->flags)) _free_subtrees_parallel(vebtree_full_locals(tree), num_threads);
+    sub.tree = tree;
+    if (!vebtree_has_leaf_locals(tree))
+        _vebtree_parallel_for(vebtree_universe_maxvalue(tree->upper_bits),
+            num_threads, _vebtree_free_locals_range, &sub);
+
+    free(vebtree_owned_global(tree));
+    tree->locals = NULL;
+}
+
+void vebtree_init_parallel(VebTree** new_tree, uint8_t universe_bits, uint8_t flags, size_t num_threads)
+{
+    VebTree root; uint8_t* arena;
+
+    num_threads = _vebtree_num_workers(num_threads);
+    if ((flags & (VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SPARSE | VEBTREE_FLAG_COW)) || num_threads == 1 || universe_bits < VEBTREE_PARALLEL_MIN_BITS) {
+        vebtree_init(new_tree, universe_bits, flags);
+        return;
+    }
+
+    _vebtree_init_node(&root, universe_bits, flags, true);
+
+    if (!(flags & VEBTREE_FLAG_ARENA)) {
+        *new_tree = (VebTree*)malloc(VEBTREE_ROOT_BYTES);
+        assert(*new_tree != NULL && "tree allocation failed unexpectedly!");
+        **new_tree = root;
+        _init_subtrees_parallel(*new_tree, flags, num_threads);
+        vebtree_stats_init_root(*new_tree);
+        return;
+    }
+
+    arena = (uint8_t*)malloc(VEBTREE_ROOT_BYTES + _vebtree_arena_size(universe_bits, root.lower_bits, flags));
+    assert(arena != NULL && "arena allocation failed unexpectedly!");
+
+    *new_tree = (VebTree*)arena;
+    **new_tree = root;
+    _init_subtrees_arena_parallel(*new_tree, flags, arena + VEBTREE_ROOT_BYTES, num_threads);
+    vebtree_stats_init_root(*new_tree);
+}
+
+void vebtree_free_parallel(VebTree* tree, size_t num_threads)
+{
+    if (vebtree_is_arena(tree) || tree->allocator != 0) {
+        vebtree_free(tree);
+        return;
+    }
+
+    _free_subtrees_parallel(tree, _vebtree_num_workers(num_threads));
+    free(tree);
+}
+
+/* ===================================== *
+ *     P A R A L L E L   B U L K   I N S E R T
+ * ===================================== */
+
+typedef struct _VEB_TREE_PARALLEL_BUILD {
+    VebTree* tree;
+    const vebkey_t* keys;
+    /**< The keys to be inserted. */
+    vebkey_t* buckets;
+    /**< The keys partitioned into one bucket per worker, each covering a range of locals. */
+    vebkey_t* temp;
+    /**< Temp space of the same size as the keys. */
+    size_t num_keys;
+    /**< The amount of keys to be inserted. */
+    size_t num_workers;
+    /**< The amount of workers, i.e. key chunks and buckets. */
+    size_t* offsets;
+    /**< The write offset of each worker's key chunk in each bucket (num_workers x num_workers). */
+    size_t* bucket_ends;
+    /**< The end offset of each bucket. */
+} VebParallelBuild;
+
+#define vebtree_parallel_bucket(build, global_key) \
+    ((size_t)((global_key) * (build)->num_workers >> (build)->tree->upper_bits))
+#define vebtree_parallel_bucket_start(build, bucket) \
+    ((((vebkey_t)(bucket) << (build)->tree->upper_bits) + (build)->num_workers - 1) / (build)->num_workers)
+#define vebtree_parallel_chunk_start(build, worker) ((build)->num_keys * (worker) / (build)->num_workers)
+
+void _vebtree_count_buckets(void* context, size_t begin, size_t end)
+{
+    size_t w, i, *counts; VebParallelBuild* build = (VebParallelBuild*)context;
+
+    for (w = begin; w < end; w++) {
+        counts = build->offsets + w * build->num_workers;
+        for (i = vebtree_parallel_chunk_start(build, w); i < vebtree_parallel_chunk_start(build, w + 1); i++)
+            counts[vebtree_parallel_bucket(build, vebtree_global_address(build->keys[i], build->tree->lower_bits))]++;
+    }
+}
+
+void _vebtree_scatter_buckets(void* context, size_t begin, size_t end)
+{
+    size_t w, i, *offsets; vebkey_t key; VebParallelBuild* build = (VebParallelBuild*)context;
+
+    for (w = begin; w < end; w++) {
+        offsets = build->offsets + w * build->num_workers;
+        for (i = vebtree_parallel_chunk_start(build, w); i < vebtree_parallel_chunk_start(build, w + 1); i++) {
+            key = build->keys[i];
+            build->buckets[offsets[vebtree_parallel_bucket(build,
+                vebtree_global_address(key, build->tree->lower_bits))]++] = key;
+        }
+    }
+}
+
+void _vebtree_build_bucket(VebParallelBuild* build, size_t bucket)
+{
+    size_t i, start, end, first_local, num_locals, *offsets;
+    vebkey_t *keys, *temp, *scratch = NULL; VebTree *tree = build->tree, local;
+
+    start = bucket == 0 ? 0 : build->bucket_ends[bucket - 1];
+    end = build->bucket_ends[bucket];
+    keys = build->buckets + start;
+    temp = build->temp + start;
+    first_local = vebtree_parallel_bucket_start(build, bucket);
+    num_locals = vebtree_parallel_bucket_start(build, bucket + 1) - first_local;
+
+    /* leaf locals -> set all bits right away */
+    if (vebtree_has_leaf_locals(tree)) {
+        for (i = 0; i < end - start; i++)
+            vebtree_bitwise_leaf_insert_key(
+                vebtree_leaf_cluster(tree, vebtree_global_address(keys[i], tree->lower_bits)),
+                vebtree_local_address(keys[i], tree->lower_bits));
+        return;
+    }
+
+    /* partition the bucket's keys by their local (counting sort) */
+    offsets = (size_t*)calloc(num_locals + 1, sizeof(size_t));
+    assert(offsets != NULL && "partition offsets allocation failed unexpectedly!");
+
+    for (i = 0; i < end - start; i++)
+        offsets[vebtree_global_address(keys[i], tree->lower_bits) - first_local + 1]++;
+    for (i = 0; i < num_locals; i++)
+        offsets[i + 1] += offsets[i];
+    for (i = 0; i < end - start; i++)
+        temp[offsets[vebtree_global_address(keys[i], tree->lower_bits) - first_local]++]
+            = vebtree_local_address(keys[i], tree->lower_bits);
+
+    _vebtree_init_node(&local, tree->lower_bits, tree->flags, false);
+    i = _vebtree_bulk_scratch_size(&local, end - start);
+    if (i > 0) {
+        scratch = (vebkey_t*)malloc(i * sizeof(vebkey_t));
+        assert(scratch != NULL && "bulk insert scratch allocation failed unexpectedly!");
+    }
+
+    /* build each local from its partition, the keys serve as temp space */
+    for (i = 0, start = 0; i < num_locals; start = offsets[i++])
+        if (offsets[i] > start)
+            _vebtree_build_unsorted(&(tree->locals[first_local + i]), temp + start,
+                keys + start, offsets[i] - start, scratch);
+
+    free(scratch);
+    free(offsets);
+}
+
+void _vebtree_build_buckets(void* context, size_t begin, size_t end)
+{
+    size_t b;
+    for (b = begin; b < end; b++)
+        _vebtree_build_bucket((VebParallelBuild*)context, b);
+}
+
+void vebtree_insert_keys_parallel(VebTree* tree, const vebkey_t keys[], size_t num_keys, size_t num_threads)
+{
+    size_t i, w, b, num_locals, num_scratch, pos; vebkey_t* buffer; VebParallelBuild build;
+
+    /* small / sparse key sets, non-empty, sparse and copy-on-write trees are handled by the single-threaded bulk insert */
+    num_threads = _vebtree_num_workers(num_threads);
+    num_locals = vebtree_is_leaf(tree) ? 0 : vebtree_universe_maxvalue(tree->upper_bits);
+    if (num_threads == 1 || vebtree_is_leaf(tree) || !vebtree_is_empty(tree) || vebtree_is_sparse(tree) || vebtree_is_cow(tree)
+            || num_keys < num_locals / 4 || tree->universe_bits < VEBTREE_PARALLEL_MIN_BITS) {
+        vebtree_insert_keys(tree, keys, num_keys);
+        return;
+    }
+
+    if (!vebtree_has_subtrees(tree)) _init_subtrees(tree, tree->flags);
+
+    num_scratch = _vebtree_bulk_scratch_size(tree, num_keys);
+    buffer = (vebkey_t*)malloc((2 * num_keys + num_scratch) * sizeof(vebkey_t));
+    assert(buffer != NULL && "bulk insert buffer allocation failed unexpectedly!");
+
+    build.tree = tree; build.keys = keys; build.num_keys = num_keys;
+    build.buckets = buffer; build.temp = buffer + num_keys;
+    build.num_workers = num_threads < num_locals ? num_threads : num_locals;
+    build.offsets = (size_t*)calloc(build.num_workers * build.num_workers, sizeof(size_t));
+    build.bucket_ends = (size_t*)malloc(build.num_workers * sizeof(size_t));
+    assert(build.offsets != NULL && build.bucket_ends != NULL
+        && "partition offsets allocation failed unexpectedly!");
+
+    /* partition the keys into one bucket per worker, each covering a range of the root's locals
+       (parallel counting sort: count per key chunk, then scatter at the chunk's bucket offsets) */
+    _vebtree_parallel_for(build.num_workers, build.num_workers, _vebtree_count_buckets, &build);
+    for (b = 0, pos = 0; b < build.num_workers; b++) {
+        for (w = 0; w < build.num_workers; w++) {
+            i = build.offsets[w * build.num_workers + b];
+            build.offsets[w * build.num_workers + b] = pos;
+            pos += i;
+        }
+        build.bucket_ends[b] = pos;
+    }
+    _vebtree_parallel_for(build.num_workers, build.num_workers, _vebtree_scatter_buckets, &build);
+
+    /* build the locals of each bucket in parallel, then finish the root by building its global */
+    _vebtree_parallel_for(build.num_workers, build.num_workers, _vebtree_build_buckets, &build);
+    free(build.offsets);
+    free(build.bucket_ends);
+    _vebtree_build_from_locals(tree, buffer, buffer + 2 * num_keys);
+    if (vebtree_is_counting(tree)) _vebtree_rebuild_counts(tree);
+    free(buffer);
+}
+
+/* ===================================== *
+ *       P A R A L L E L   S O R T
+ * ===================================== */
+
+/* buckets per worker, balancing skewed key distributions */
+#define VEBTREE_PARALLEL_SORT_BUCKETS_PER_WORKER 4
+
+typedef struct _VEB_TREE_PARALLEL_SORT {
+    const vebkey_t* keys;
+    /**< The keys to be sorted. */
+    vebkey_t* buckets;
+    /**< The keys partitioned into buckets by their upper bits. */
+    vebkey_t* output;
+    /**< The sorted keys, each bucket written at its offset within the buckets. */
+    size_t num_keys;
+    /**< The amount of keys to be sorted. */
+    size_t num_chunks;
+    /**< The amount of key chunks that are partitioned in parallel. */
+    size_t num_buckets;
+    /**< The amount of buckets. */
+    vebkey_t min;
+    /**< The smallest key. */
+    uint8_t shift;
+    /**< The bits right of the bucket index within a key (relative to the min. key). */
+    uint8_t flags;
+    /**< The sort flags. */
+    size_t* offsets;
+    /**< The write offset of each key chunk in each bucket (num_chunks x num_buckets). */
+    size_t* bucket_ends;
+    /**< The end offset of each bucket. */
+    size_t* num_sorted;
+    /**< The amount of keys written for each bucket. */
+} VebParallelSort;
+
+#define vebtree_sort_bucket(sort, key) ((size_t)(((key) - (sort)->min) >> (sort)->shift))
+#define vebtree_sort_chunk_start(sort, chunk) ((sort)->num_keys * (chunk) / (sort)->num_chunks)
+
+void _vebtree_sort_count_buckets(void* context, size_t begin, size_t end)
+{
+    size_t c, i, *counts; VebParallelSort* sort = (VebParallelSort*)context;
+
+    for (c = begin; c < end; c++) {
+        counts = sort->offsets + c * sort->num_buckets;
+        for (i = vebtree_sort_chunk_start(sort, c); i < vebtree_sort_chunk_start(sort, c + 1); i++)
+            counts[vebtree_sort_bucket(sort, sort->keys[i])]++;
+    }
+}
+
+void _vebtree_sort_scatter_buckets(void* context, size_t begin, size_t end)
+{
+    size_t c, i, *offsets; VebParallelSort* sort = (VebParallelSort*)context;
+
+    for (c = begin; c < end; c++) {
+        offsets = sort->offsets + c * sort->num_buckets;
+        for (i = vebtree_sort_chunk_start(sort, c); i < vebtree_sort_chunk_start(sort, c + 1); i++)
+            sort->buckets[offsets[vebtree_sort_bucket(sort, sort->keys[i])]++] = sort->keys[i];
+    }
+}
+
+void _vebtree_sort_buckets(void* context, size_t begin, size_t end)
+{
+    size_t b, start; VebParallelSort* sort = (VebParallelSort*)context;
+
+    for (b = begin; b < end; b++) {
+        start = b == 0 ? 0 : sort->bucket_ends[b - 1];
+        sort->num_sorted[b] = vebtree_sort(sort->buckets + start,
+            sort->bucket_ends[b] - start, sort->output + start, sort->flags);
+    }
+}
+
+size_t vebtree_sort_parallel(const vebkey_t keys[], size_t num_keys, vebkey_t output[],
+                             uint8_t flags, size_t num_threads)
+{
+    size_t i, b, c, pos, count; vebkey_t max; uint8_t uni_bits, bucket_bits; VebParallelSort sort;
+
+    num_threads = _vebtree_num_workers(num_threads);
+    if (num_threads == 1 || num_keys < ((size_t)1 << VEBTREE_PARALLEL_MIN_BITS))
+        return vebtree_sort(keys, num_keys, output, flags);
+
+    for (i = 1, sort.min = max = keys[0]; i < num_keys; i++) {
+        sort.min = keys[i] < sort.min ? keys[i] : sort.min;
+        max = keys[i] > max ? keys[i] : max;
+    }
+
+    if (sort.min == max)
+        return vebtree_sort(keys, num_keys, output, flags);
+
+    /* split the key range into a power of 2 buckets by the upper bits */
+    uni_bits = vebtree_required_universe_bits(max - sort.min);
+    bucket_bits = vebtree_required_universe_bits(num_threads * VEBTREE_PARALLEL_SORT_BUCKETS_PER_WORKER - 1);
+    bucket_bits = bucket_bits < uni_bits ? bucket_bits : uni_bits;
+
+    sort.keys = keys; sort.output = output; sort.num_keys = num_keys; sort.flags = flags;
+    sort.num_chunks = num_threads;
+    sort.num_buckets = (size_t)1 << bucket_bits;
+    sort.shift = uni_bits - bucket_bits;
+    sort.buckets = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    sort.offsets = (size_t*)calloc(sort.num_chunks * sort.num_buckets, sizeof(size_t));
+    sort.bucket_ends = (size_t*)malloc(sort.num_buckets * sizeof(size_t));
+    sort.num_sorted = (size_t*)malloc(sort.num_buckets * sizeof(size_t));
+    assert(sort.buckets != NULL && sort.offsets != NULL && sort.bucket_ends != NULL
+        && sort.num_sorted != NULL && "parallel sort buffers allocation failed unexpectedly!");
+
+    /* partition the keys into the buckets (parallel counting sort) */
+    _vebtree_parallel_for(sort.num_chunks, num_threads, _vebtree_sort_count_buckets, &sort);
+    for (b = 0, pos = 0; b < sort.num_buckets; b++) {
+        for (c = 0; c < sort.num_chunks; c++) {
+            count = sort.offsets[c * sort.num_buckets + b];
+            sort.offsets[c * sort.num_buckets + b] = pos;
+            pos += count;
+        }
+        sort.bucket_ends[b] = pos;
+    }
+    _vebtree_parallel_for(sort.num_chunks, num_threads, _vebtree_sort_scatter_buckets, &sort);
+
+    /* sort the buckets in parallel, they are already in order among each other */
+    _vebtree_parallel_for(sort.num_buckets, num_threads, _vebtree_sort_buckets, &sort);
+
+    /* close the gaps of dropped duplicates */
+    for (b = 0, pos = 0; b < sort.num_buckets; b++) {
+        i = b == 0 ? 0 : sort.bucket_ends[b - 1];
+        if (pos != i) memmove(output + pos, output + i, sort.num_sorted[b] * sizeof(vebkey_t));
+        pos += sort.num_sorted[b];
+    }
+
+    free(sort.num_sorted);
+    free(sort.bucket_ends);
+    free(sort.offsets);
+    free(sort.buckets);
+    return pos;
+}
+
+#endif /* DOXYGEN_SKIP */
+#endif /* VEBTREES_CONCURRENT_H */
@@ -0,0 +1,588 @@
+/* MIT License
+ *
+ * Copyright (c) 2022 Marco Tröster
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VEBTREES_MAP_H
+#define VEBTREES_MAP_H
+
+#include <string.h>
+#include "vebtrees.h"
+
+/* ===================================== *
+ *      T Y P E S   /  S T R U C T S
+ * ===================================== */
+
+/**
+ * @brief Ordered map from keys to fixed-size values on top of a van Emde Boas tree.
+ * The values are stored within the tree's subtree allocations, right behind the
+ * locals array: nodes with bitwise leafs as locals keep one value slot per key of
+ * their universe next to the leafs' bitboards, all other nodes keep the values of
+ * their locals' lows. So a lookup resolves the value along the key's own path.
+ */
+typedef struct _VEB_MAP {
+    VebTree* tree;
+    /**< The tree holding the map's keys, it must only be modified by the vebmap functions. */
+    size_t value_size;
+    /**< The size of each value in bytes. */
+    uint8_t* root_values;
+    /**< The value of the root's low, or all values in case the root is a bitwise leaf. */
+} VebMap;
+
+/**
+ * @brief Multiset on top of a van Emde Boas map, keeping a counter per present key as its value.
+ * Successor / predecessor / min / max queries run on the map's tree in O(log log u).
+ */
+typedef struct _VEB_MULTISET {
+    VebMap* map;
+    /**< The map from each present key to its number of occurrences (uint32_t). */
+    uint64_t size;
+    /**< The number of keys including duplicates. */
+} VebMultiset;
+
+/* ===================================== *
+ *          F U N C T I O N S
+ * ===================================== */
+
+/**
+ * @brief Create a new van Emde Boas map.
+ *
+ * @param map a reference pointer that is set to the newly allocated map
+ * @param universe_bits the universe size to be managed by the map in bits
+ * @param value_size the size of each value in bytes
+ * @param flags a collection of flags adjusting the tree's behavior, supports
+ *              VEBTREE_FLAG_LAZY and VEBTREE_FLAG_SHRINK (see vebtree_init())
+ */
+void vebmap_init(VebMap** map, uint8_t universe_bits, size_t value_size, uint8_t flags);
+
+/**
+ * @brief Free the memory allocated by the given map, including the map itself.
+ *
+ * @param map the map to be freed
+ */
+void vebmap_free(VebMap* map);
+
+/**
+ * @brief Look up the value of the given key.
+ *
+ * @param map the map to be looked up
+ * @param key the key to be looked up
+ * @return a pointer to the key's value (valid until the map is modified) or NULL if the key isn't present
+ */
+void* vebmap_get(VebMap* map, vebkey_t key);
+
+/**
+ * @brief Insert the given key with its value, overwriting the value if the key is already present.
+ *
+ * @param map the map to be inserted into
+ * @param key the key to be inserted
+ * @param value the value to be copied into the map (value_size bytes)
+ */
+void vebmap_put(VebMap* map, vebkey_t key, const void* value);
+
+/**
+ * @brief Delete the given key and its value from the map.
+ *
+ * @param map the map to be deleted from
+ * @param key the key to be deleted
+ * @return a boolean whether the key was present
+ */
+bool vebmap_erase(VebMap* map, vebkey_t key);
+
+/**
+ * @brief Retrieve the key's successor together with its value in a single lookup.
+ *
+ * @param map the map to be looked up
+ * @param key the key to be looked up
+ * @param value set to a pointer to the successor's value (valid until the map is modified)
+ * @return the key's successor or vebtree_null if there's none
+ */
+vebkey_t vebmap_successor_entry(VebMap* map, vebkey_t key, void** value);
+
+/**
+ * @brief Retrieve the key's predecessor together with its value.
+ *
+ * @param map the map to be looked up
+ * @param key the key to be looked up
+ * @param value set to a pointer to the predecessor's value (valid until the map is modified)
+ * @return the key's predecessor or vebtree_null if there's none
+ */
+vebkey_t vebmap_predecessor_entry(VebMap* map, vebkey_t key, void** value);
+
+/**
+ * @brief Create a new multiset.
+ *
+ * @param multiset a reference pointer that is set to the newly allocated multiset
+ * @param universe_bits the universe size to be managed by the multiset in bits
+ * @param flags a collection of flags adjusting the tree's behavior, supports
+ *              VEBTREE_FLAG_LAZY and VEBTREE_FLAG_SHRINK (see vebtree_init())
+ */
+void vebmultiset_init(VebMultiset** multiset, uint8_t universe_bits, uint8_t flags);
+
+/**
+ * @brief Free the memory allocated by the given multiset, including the multiset itself.
+ *
+ * @param multiset the multiset to be freed
+ */
+void vebmultiset_free(VebMultiset* multiset);
+
+/**
+ * @brief Insert another occurrence of the given key.
+ *
+ * @param multiset the multiset to be inserted into
+ * @param key the key to be inserted
+ */
+void vebmultiset_insert_key(VebMultiset* multiset, vebkey_t key);
+
+/**
+ * @brief Delete a single occurrence of the given key, the key is removed once its count drops to 0.
+ *
+ * @param multiset the multiset to be deleted from
+ * @param key the key to be deleted
+ * @return a boolean whether the key was present
+ */
+bool vebmultiset_delete_key(VebMultiset* multiset, vebkey_t key);
+
+/**
+ * @brief Retrieve the number of occurrences of the given key.
+ *
+ * @param multiset the multiset to be looked up
+ * @param key the key to be counted
+ * @return the key's number of occurrences, 0 if it's not present
+ */
+uint32_t vebmultiset_count(VebMultiset* multiset, vebkey_t key);
+
+/**
+ * @brief Export all keys in ascending order, repeating each key by its number of occurrences.
+ *
+ * @param multiset the multiset to be exported
+ * @param output the array to write the keys to
+ * @param capacity the maximum amount of keys to be written
+ * @return the amount of keys written
+ */
+size_t vebmultiset_to_array(VebMultiset* multiset, vebkey_t output[], size_t capacity);
+
+#ifndef DOXYGEN_SKIP
+
+/* ===================================== *
+ *           M A P   C O R E
+ * ===================================== */
+
+#define vebmap_is_leaf_parent(tree) vebtree_has_leaf_locals(tree)
+#define vebmap_values(tree) ((uint8_t*)(tree)->locals\
+    + vebtree_locals_bytes((tree)->upper_bits, (tree)->lower_bits, (tree)->flags))
+
+/* leaf parents keep a slot per key of their universe, other nodes one slot per local's low */
+size_t _vebmap_values_bytes(const VebTree* tree, size_t value_size)
+{
+    return vebmap_is_leaf_parent(tree)
+        ? vebtree_universe_maxvalue(tree->universe_bits) * value_size
+        : vebtree_universe_maxvalue(tree->upper_bits) * value_size;
+}
+
+void _vebmap_init_subtrees(VebTree* tree, size_t value_size)
+{
+    size_t i, num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+
+    /* the values are placed right behind the global + locals within the same allocation */
+    tree->locals = _vebtree_block_alloc(vebtree_subtrees_bytes(tree->upper_bits, tree->lower_bits, tree->flags)
+        + _vebmap_values_bytes(tree, value_size), tree->flags, tree->allocator) + 1;
+
+    /* the global only indexes the non-empty locals, so it's an ordinary tree; maps don't
+       look up absent keys, so the full locals stay empty without allocating any subtrees */
+    _vebtree_init(vebtree_owned_global(tree), tree->upper_bits, vebtree_global_flags(tree->flags), tree->allocator, false);
+    if (vebtree_tracks_full(tree->flags))
+        _vebtree_init_node(vebtree_full_locals(tree), tree->upper_bits, tree->flags, false);
+
+    /* leaf parents keep bare bitboards, their values are indexed by the node's keys */
+    if (vebmap_is_leaf_parent(tree)) {
+        memset(tree->locals, 0, num_locals * VEBTREE_LEAF_BYTES);
+        return;
+    }
+
+    for (i = 0; i < num_locals; i++) {
+        _vebtree_init_node(tree->locals + i, tree->lower_bits, tree->flags, false);
+        if (!vebtree_is_lazy(tree))
+            _vebmap_init_subtrees(tree->locals + i, value_size);
+    }
+}
+
+void vebmap_init(VebMap** new_map, uint8_t universe_bits, size_t value_size, uint8_t flags)
+{
+    VebMap* map;
+
+    assert(value_size > 0 && "values need to consist of at least 1 byte!");
+    assert(!(flags & ~(VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK))
+        && "maps only support lazy / shrinking allocation!");
+
+    map = (VebMap*)malloc(sizeof(VebMap));
+    assert(map != NULL && "map allocation failed unexpectedly!");
+    map->tree = (VebTree*)malloc(sizeof(VebTree));
+    assert(map->tree != NULL && "tree allocation failed unexpectedly!");
+    map->value_size = value_size;
+
+    _vebtree_init_node(map->tree, universe_bits, flags, true);
+    map->root_values = (uint8_t*)malloc(vebtree_is_leaf(map->tree)
+        ? vebtree_universe_maxvalue(universe_bits) * value_size : value_size);
+    assert(map->root_values != NULL && "root values allocation failed unexpectedly!");
+
+    if (!vebtree_is_leaf(map->tree) && !vebtree_is_lazy(map->tree))
+        _vebmap_init_subtrees(map->tree, value_size);
+    *new_map = map;
+}
+
+void vebmap_free(VebMap* map)
+{
+    /* the values are released together with the locals */
+    vebtree_free(map->tree);
+    free(map->root_values);
+    free(map);
+}
+
+/* the value slot of the given key, the node's low value sits in the slot passed by its parent */
+uint8_t* _vebmap_value(VebTree* tree, uint8_t* low_value, vebkey_t key, size_t value_size)
+{
+    vebkey_t global_key, local_key;
+
+    if (key == tree->low) return low_value;
+    if (vebtree_is_empty(tree) || !vebtree_has_subtrees(tree)) return NULL;
+
+    global_key = vebtree_global_address(key, tree->lower_bits);
+    local_key = vebtree_local_address(key, tree->lower_bits);
+
+    /* base case for leaf parents -> the slots are indexed by the node's keys */
+    if (vebmap_is_leaf_parent(tree))
+        return vebtree_bitwise_leaf_contains_key(vebtree_leaf_cluster(tree, global_key), local_key)
+            ? vebmap_values(tree) + key * value_size : NULL;
+
+    return _vebmap_value(&(tree->locals[global_key]),
+        vebmap_values(tree) + global_key * value_size, local_key, value_size);
+}
+
+/* the value slot of the given local's min (the low of non-leaf locals) */
+uint8_t* _vebmap_local_min_value(VebTree* tree, vebkey_t global_key, vebkey_t local_min, size_t value_size)
+{
+    return vebmap_is_leaf_parent(tree)
+        ? vebmap_values(tree) + ((global_key << tree->lower_bits) | local_min) * value_size
+        : vebmap_values(tree) + global_key * value_size;
+}
+
+void _vebmap_put(VebTree* tree, uint8_t* low_value, vebkey_t key, const uint8_t* value, size_t value_size)
+{
+    vebkey_t global_key, local_key, temp; const uint8_t* new_low_value = NULL;
+
+    /* base case when tree is empty or the key is already the low */
+    if (vebtree_is_empty(tree)) { tree->low = tree->high = key; memcpy(low_value, value, value_size); return; }
+    if (key == tree->low) { memcpy(low_value, value, value_size); return; }
+
+    /* case when the key becomes the new low -> push the old low down with its value,
+       the new low's value is written once the old value got copied */
+    if (key < tree->low) {
+        temp = tree->low; tree->low = key; key = temp;
+        new_low_value = value; value = low_value;
+    }
+
+    if (!vebtree_has_subtrees(tree)) _vebmap_init_subtrees(tree, value_size);
+
+    global_key = vebtree_global_address(key, tree->lower_bits);
+    local_key = vebtree_local_address(key, tree->lower_bits);
+
+    if (_vebtree_cluster_is_empty(tree, global_key))
+        vebtree_insert_key(vebtree_owned_global(tree), global_key);
+
+    if (vebmap_is_leaf_parent(tree)) {
+        vebtree_bitwise_leaf_insert_key(vebtree_leaf_cluster(tree, global_key), local_key);
+        memcpy(vebmap_values(tree) + key * value_size, value, value_size);
+    } else {
+        _vebmap_put(&(tree->locals[global_key]), vebmap_values(tree) + global_key * value_size, local_key, value, value_size);
+    }
+
+    tree->high = tree->high > key ? tree->high : key;
+    if (new_low_value != NULL) memcpy(low_value, new_low_value, value_size);
+}
+
+void _vebmap_erase(VebTree* tree, uint8_t* low_value, vebkey_t key, size_t value_size)
+{
+    vebkey_t global_key, local_key, global_low, local_min, global_high;
+
+    /* base case with only one element -> set low and high to null */
+    if (tree->low == tree->high) { tree->low = tree->high = vebtree_null; return; }
+
+    /* case when deleting the low element -> new low needs to be pulled out with its value */
+    if (key == tree->low) {
+        global_low = vebtree_get_min(vebtree_owned_global(tree));
+        local_min = _vebtree_cluster_min(tree, global_low);
+        memcpy(low_value, _vebmap_local_min_value(tree, global_low, local_min, value_size), value_size);
+        tree->low = key = (global_low << tree->lower_bits) | local_min;
+    }
+
+    global_key = vebtree_global_address(key, tree->lower_bits);
+    local_key = vebtree_local_address(key, tree->lower_bits);
+
+    /* delete the local key recursively (leaf slots just become unused) */
+    if (vebmap_is_leaf_parent(tree))
+        vebtree_bitwise_leaf_delete_key(vebtree_leaf_cluster(tree, global_key), local_key);
+    else
+        _vebmap_erase(&(tree->locals[global_key]),
+            vebmap_values(tree) + global_key * value_size, local_key, value_size);
+
+    if (_vebtree_cluster_is_empty(tree, global_key))
+        vebtree_delete_key(vebtree_owned_global(tree), global_key);
+
+    /* in case the maximum was deleted -> find new maximum */
+    if (key == tree->high) {
+        global_high = vebtree_get_max(vebtree_owned_global(tree));
+        tree->high = global_high == vebtree_null ? tree->low
+            : (global_high << tree->lower_bits) | _vebtree_cluster_max(tree, global_high);
+    }
+
+    /* release the lazy subtrees again once they ran empty, the low's value stays with the parent */
+    if (vebtree_is_shrinking(tree) && vebtree_is_empty(vebtree_owned_global(tree)))
+        _free_subtrees(tree);
+}
+
+vebkey_t _vebmap_successor(VebTree* tree, uint8_t* low_value, vebkey_t key,
+                           size_t value_size, uint8_t** value)
+{
+    vebkey_t global_key, local_key, global_succ, local_max, local_succ;
+
+    /* base case for predecessor in neighbour local -> low is the successor */
+    if (tree->low != vebtree_null && key < tree->low) { *value = low_value; return tree->low; }
+
+    /* base case for lazy nodes only holding the low key */
+    if (!vebtree_has_subtrees(tree)) return vebtree_null;
+
+    global_key = vebtree_global_address(key, tree->lower_bits);
+    local_key = vebtree_local_address(key, tree->lower_bits);
+
+    /* case where a local contains the successor */
+    local_max = _vebtree_cluster_max(tree, global_key);
+    if (local_max != vebtree_null && local_key < local_max) {
+        if (vebmap_is_leaf_parent(tree)) {
+            local_succ = (global_key << tree->lower_bits)
+                | vebtree_bitwise_leaf_successor(vebtree_leaf_cluster(tree, global_key), local_key);
+            *value = vebmap_values(tree) + local_succ * value_size;
+            return local_succ;
+        }
+        return (global_key << tree->lower_bits) | _vebmap_successor(&(tree->locals[global_key]),
+            vebmap_values(tree) + global_key * value_size, local_key, value_size, value);
+    }
+
+    /* case where a neighbour contains the successor */
+    global_succ = vebtree_successor(vebtree_owned_global(tree), global_key);
+    if (global_succ == vebtree_null) return vebtree_null;
+    local_succ = _vebtree_cluster_min(tree, global_succ);
+    *value = _vebmap_local_min_value(tree, global_succ, local_succ, value_size);
+    return (global_succ << tree->lower_bits) | local_succ;
+}
+
+vebkey_t _vebmap_predecessor(VebTree* tree, uint8_t* low_value, vebkey_t key,
+                             size_t value_size, uint8_t** value)
+{
+    vebkey_t global_key, local_key, global_pred, local_min, local_pred;
+
+    /* base case for successor in neighbour local -> high is the predecessor */
+    if (tree->high != vebtree_null && key > tree->high) {
+        *value = _vebmap_value(tree, low_value, tree->high, value_size);
+        return tree->high;
+    }
+
+    /* base case for lazy nodes only holding the low key */
+    if (!vebtree_has_subtrees(tree)) return vebtree_null;
+
+    global_key = vebtree_global_address(key, tree->lower_bits);
+    local_key = vebtree_local_address(key, tree->lower_bits);
+
+    /* case where a local contains the predecessor */
+    local_min = _vebtree_cluster_min(tree, global_key);
+    if (local_min != vebtree_null && local_key > local_min) {
+        if (vebmap_is_leaf_parent(tree)) {
+            local_pred = (global_key << tree->lower_bits)
+                | vebtree_bitwise_leaf_predecessor(vebtree_leaf_cluster(tree, global_key), local_key);
+            *value = vebmap_values(tree) + local_pred * value_size;
+            return local_pred;
+        }
+        return (global_key << tree->lower_bits) | _vebmap_predecessor(&(tree->locals[global_key]),
+            vebmap_values(tree) + global_key * value_size, local_key, value_size, value);
+    }
+
+    /* case where a neighbour contains the predecessor, otherwise it's the low */
+    global_pred = vebtree_predecessor(vebtree_owned_global(tree), global_key);
+    if (global_pred == vebtree_null) {
+        if (tree->low == vebtree_null || key <= tree->low) return vebtree_null;
+        *value = low_value;
+        return tree->low;
+    }
+
+    local_pred = (global_pred << tree->lower_bits) | _vebtree_cluster_max(tree, global_pred);
+    *value = _vebmap_value(tree, low_value, local_pred, value_size);
+    return local_pred;
+}
+
+/* ===================================== *
+ *            M A P   A P I
+ * ===================================== */
+
+void* vebmap_get(VebMap* map, vebkey_t key)
+{
+    assert(key != vebtree_null && "cannot look up vebtree_null, invalid key!");
+
+    if (vebtree_is_leaf(map->tree))
+        return vebtree_bitwise_leaf_contains_key(map->tree->leaf, key)
+            ? map->root_values + key * map->value_size : NULL;
+
+    return _vebmap_value(map->tree, map->root_values, key, map->value_size);
+}
+
+void vebmap_put(VebMap* map, vebkey_t key, const void* value)
+{
+    assert(key != vebtree_null && "cannot insert vebtree_null, invalid key!");
+
+    if (vebtree_is_leaf(map->tree)) {
+        vebtree_bitwise_leaf_insert_key(map->tree->leaf, key);
+        memcpy(map->root_values + key * map->value_size, value, map->value_size);
+        return;
+    }
+
+    _vebmap_put(map->tree, map->root_values, key, (const uint8_t*)value, map->value_size);
+}
+
+bool vebmap_erase(VebMap* map, vebkey_t key)
+{
+    if (vebmap_get(map, key) == NULL) return false;
+
+    if (vebtree_is_leaf(map->tree))
+        vebtree_bitwise_leaf_delete_key(map->tree->leaf, key);
+    else
+        _vebmap_erase(map->tree, map->root_values, key, map->value_size);
+    return true;
+}
+
+vebkey_t vebmap_successor_entry(VebMap* map, vebkey_t key, void** value)
+{
+    vebkey_t succ; uint8_t* slot = NULL;
+
+    if (vebtree_is_leaf(map->tree)) {
+        succ = vebtree_bitwise_leaf_successor(map->tree->leaf, key);
+        slot = succ == vebtree_null ? NULL : map->root_values + succ * map->value_size;
+    } else {
+        succ = _vebmap_successor(map->tree, map->root_values, key, map->value_size, &slot);
+    }
+
+    *value = succ == vebtree_null ? NULL : slot;
+    return succ;
+}
+
+vebkey_t vebmap_predecessor_entry(VebMap* map, vebkey_t key, void** value)
+{
+    vebkey_t pred; uint8_t* slot = NULL;
+
+    if (vebtree_is_leaf(map->tree)) {
+        pred = vebtree_bitwise_leaf_predecessor(map->tree->leaf, key);
+        slot = pred == vebtree_null ? NULL : map->root_values + pred * map->value_size;
+    } else {
+        pred = _vebmap_predecessor(map->tree, map->root_values, key, map->value_size, &slot);
+    }
+
+    *value = pred == vebtree_null ? NULL : slot;
+    return pred;
+}
+
+/* ===================================== *
+ *             M U L T I S E T
+ * ===================================== */
+
+void vebmultiset_init(VebMultiset** new_multiset, uint8_t universe_bits, uint8_t flags)
+{
+    VebMultiset* multiset = (VebMultiset*)malloc(sizeof(VebMultiset));
+    assert(multiset != NULL && "multiset allocation failed unexpectedly!");
+    vebmap_init(&multiset->map, universe_bits, sizeof(uint32_t), flags);
+    multiset->size = 0;
+    *new_multiset = multiset;
+}
+
+void vebmultiset_free(VebMultiset* multiset)
+{
+    vebmap_free(multiset->map);
+    free(multiset);
+}
+
+void vebmultiset_insert_key(VebMultiset* multiset, vebkey_t key)
+{
+    uint32_t count = 1; uint8_t* slot = (uint8_t*)vebmap_get(multiset->map, key);
+
+    /* the counters are copied as the map's value slots aren't aligned */
+    if (slot != NULL) {
+        memcpy(&count, slot, sizeof(uint32_t));
+        assert(count < UINT32_MAX && "too many occurrences of the key, counter overflow!");
+        count++;
+        memcpy(slot, &count, sizeof(uint32_t));
+    } else {
+        vebmap_put(multiset->map, key, &count);
+    }
+
+    multiset->size++;
+}
+
+bool vebmultiset_delete_key(VebMultiset* multiset, vebkey_t key)
+{
+    uint32_t count; uint8_t* slot = (uint8_t*)vebmap_get(multiset->map, key);
+    if (slot == NULL) return false;
+
+    memcpy(&count, slot, sizeof(uint32_t));
+    if (count == 1) {
+        vebmap_erase(multiset->map, key);
+    } else {
+        count--;
+        memcpy(slot, &count, sizeof(uint32_t));
+    }
+
+    multiset->size--;
+    return true;
+}
+
+uint32_t vebmultiset_count(VebMultiset* multiset, vebkey_t key)
+{
+    uint32_t count = 0; uint8_t* slot = (uint8_t*)vebmap_get(multiset->map, key);
+    if (slot != NULL) memcpy(&count, slot, sizeof(uint32_t));
+    return count;
+}
+
+size_t vebmultiset_to_array(VebMultiset* multiset, vebkey_t output[], size_t capacity)
+{
+    size_t pos = 0; uint32_t count; vebkey_t key; void* slot;
+
+    key = vebtree_get_min(multiset->map->tree);
+    slot = key == vebtree_null ? NULL : vebmap_get(multiset->map, key);
+
+    /* the successor's counter is resolved along the same path as the successor itself */
+    while (key != vebtree_null && pos < capacity) {
+        memcpy(&count, slot, sizeof(uint32_t));
+        for (; count > 0 && pos < capacity; count--)
+            output[pos++] = key;
+        key = vebmap_successor_entry(multiset->map, key, &slot);
+    }
+
+    return pos;
+}
+
+#endif /* DOXYGEN_SKIP */
+#endif /* VEBTREES_MAP_H */
@@ -0,0 +1,272 @@
+/* MIT License
+ *
+ * Copyright (c) 2022 Marco Tröster
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VEBTREES_MMAP_H
+#define VEBTREES_MMAP_H
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "vebtrees.h"
+
+/* ===================================== *
+ *      T Y P E S   /  S T R U C T S
+ * ===================================== */
+
+/**
+ * @brief The magic bytes identifying van Emde Boas tree snapshot files.
+ */
+#define VEBTREE_IMAGE_MAGIC "VEBTREE"
+
+/**
+ * @brief The version of the snapshot file format.
+ */
+#define VEBTREE_IMAGE_VERSION 3
+
+/**
+ * @brief Header of a snapshot file, followed by the tree's nodes. The nodes are
+ * laid out depth-first like an arena tree (root, then each node's global + locals
+ * block followed by their subtrees, the locals of leaf parents being bare bitboards),
+ * referring to their subtrees by byte offsets relative to the node instead of pointers. Snapshots are only portable between
+ * builds with the same byte order and leaf size.
+ */
+typedef struct _VEB_TREE_IMAGE_HEADER {
+    char magic[8];
+    /**< The magic bytes, see VEBTREE_IMAGE_MAGIC. */
+    uint32_t version;
+    /**< The file format version, see VEBTREE_IMAGE_VERSION. */
+    uint32_t byte_order;
+    /**< The value 0x01020304 written in the byte order of the machine saving the tree. */
+    uint8_t leaf_bits;
+    /**< The universe bits of bitwise tree leafs (VEBTREE_LEAF_BITS). */
+    uint8_t node_size;
+    /**< The size of a tree node in bytes. */
+    uint16_t reserved;
+    /**< Reserved for future use, always 0. */
+    uint32_t reserved2;
+    /**< Reserved for future use, always 0. */
+    uint64_t image_size;
+    /**< The size of all nodes following the header in bytes. */
+} VebTreeImageHeader;
+
+/* ===================================== *
+ *          F U N C T I O N S
+ * ===================================== */
+
+/**
+ * @brief Save a snapshot of the given tree to a file that can be memory-mapped
+ * by vebtree_open_mmap(). Only allocated subtrees are written, so lazy trees
+ * keep their compact size.
+ *
+ * @param tree the tree to be saved
+ * @param path the file path to write the snapshot to
+ * @return a boolean whether the snapshot was written successfully
+ */
+bool vebtree_save(VebTree* tree, const char* path);
+
+/**
+ * @brief Memory-map a snapshot file written by vebtree_save() as a read-only tree.
+ * The tree is queried in place without deserializing, pages are loaded lazily by the
+ * page cache and shared between all processes mapping the same file. It supports all
+ * read-only operations (lookups, successor / predecessor, cursors, range queries)
+ * except for order statistics as the counts of VEBTREE_FLAG_COUNTS aren't saved.
+ *
+ * @param path the file path of the snapshot
+ * @return the mapped tree or NULL if the file couldn't be mapped or is no valid snapshot
+ */
+VebTree* vebtree_open_mmap(const char* path);
+
+/**
+ * @brief Unmap a tree opened by vebtree_open_mmap().
+ *
+ * @param tree the tree to be unmapped
+ */
+void vebtree_close_mmap(VebTree* tree);
+
+#ifndef DOXYGEN_SKIP
+
+/* ===================================== *
+ *          S N A P S H O T S
+ * ===================================== */
+
+#define VEBTREE_IMAGE_BYTE_ORDER 0x01020304
+#define VEBTREE_IMAGE_WRITE_BUFFER (1 << 20)
+
+/* bytes of all subtree blocks below the given node */
+size_t _vebtree_image_size(VebTree* tree)
+{
+    size_t i, size, num_locals; VebTree* locals;
+
+    if (vebtree_is_leaf(tree) || !vebtree_has_subtrees(tree))
+        return 0;
+
+    /* images don't keep any counts, so the block is the global followed by the locals */
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    locals = vebtree_locals(tree);
+    size = vebtree_subtrees_bytes(tree->upper_bits, tree->lower_bits, VEBTREE_FLAG_MAPPED)
+        + _vebtree_image_size(vebtree_global(tree));
+    if (!vebtree_has_leaf_locals(tree))
+        for (i = 0; i < num_locals; i++)
+            size += _vebtree_image_size(locals + i);
+    return size;
+}
+
+/* copy the node, referring to its subtrees block by its offset relative to the node */
+VebTree _vebtree_image_node(VebTree* node, size_t node_pos, size_t block_pos)
+{
+    VebTree copy = *node;
+    copy.allocator = 0;
+
+    if (vebtree_is_leaf(node)) {
+        copy.flags = VEBTREE_FLAG_MAPPED;
+        return copy;
+    }
+
+    copy.flags = (node->flags & ~(VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK
+        | VEBTREE_FLAG_ARENA | VEBTREE_FLAG_COUNTS | VEBTREE_FLAG_COW)) | VEBTREE_FLAG_MAPPED;
+    copy.locals_offset = 0;
+
+    /* the locals follow the global within the block */
+    if (vebtree_has_subtrees(node))
+        copy.locals_offset = (int64_t)(block_pos + sizeof(VebTree)) - (int64_t)node_pos;
+
+    return copy;
+}
+
+/* write the node's global + locals block at the given position, followed by their subtrees */
+bool _vebtree_image_write_block(FILE* file, VebTree* tree, size_t block_pos)
+{
+    size_t i, num_children, child_pos, *sizes; VebTree *child, copy; bool success = true;
+
+    /* the global comes first, directly followed by the locals, leaf clusters are
+       copied as they are (the global's subtrees follow the bitboards then) */
+    if (vebtree_has_leaf_locals(tree)) {
+        num_children = vebtree_universe_maxvalue(tree->upper_bits);
+        child_pos = block_pos + vebtree_subtrees_bytes(tree->upper_bits, tree->lower_bits, VEBTREE_FLAG_MAPPED);
+        copy = _vebtree_image_node(vebtree_global(tree), block_pos, child_pos);
+        return fwrite(&copy, sizeof(VebTree), 1, file) == 1
+            && fwrite(vebtree_locals(tree), VEBTREE_LEAF_BYTES, num_children, file) == num_children
+            && (_vebtree_image_size(vebtree_global(tree)) == 0
+                || _vebtree_image_write_block(file, vebtree_global(tree), child_pos));
+    }
+
+    num_children = 1 + vebtree_universe_maxvalue(tree->upper_bits);
+    sizes = (size_t*)malloc(num_children * sizeof(size_t));
+    assert(sizes != NULL && "snapshot block sizes allocation failed unexpectedly!");
+    #define image_child(i) ((i) == 0 ? vebtree_global(tree) : vebtree_locals(tree) + (i) - 1)
+
+    child_pos = block_pos + num_children * sizeof(VebTree);
+    for (i = 0; i < num_children && success; i++) {
+        child = image_child(i);
+        sizes[i] = _vebtree_image_size(child);
+        copy = _vebtree_image_node(child, block_pos + i * sizeof(VebTree), child_pos);
+        success = fwrite(&copy, sizeof(VebTree), 1, file) == 1;
+        child_pos += sizes[i];
+    }
+
+    child_pos = block_pos + num_children * sizeof(VebTree);
+    for (i = 0; i < num_children && success; i++) {
+        if (sizes[i] > 0)
+            success = _vebtree_image_write_block(file, image_child(i), child_pos);
+        child_pos += sizes[i];
+    }
+
+    #undef image_child
+    free(sizes);
+    return success;
+}
+
+bool vebtree_save(VebTree* tree, const char* path)
+{
+    FILE* file; VebTreeImageHeader header; VebTree root; bool success;
+    assert(!vebtree_is_sparse(tree) && "sparse trees cannot be saved as snapshot!");
+
+    memset(&header, 0, sizeof(VebTreeImageHeader));
+    memcpy(header.magic, VEBTREE_IMAGE_MAGIC, sizeof(VEBTREE_IMAGE_MAGIC));
+    header.version = VEBTREE_IMAGE_VERSION;
+    header.byte_order = VEBTREE_IMAGE_BYTE_ORDER;
+    header.leaf_bits = VEBTREE_LEAF_BITS;
+    header.node_size = sizeof(VebTree);
+    header.image_size = sizeof(VebTree) + _vebtree_image_size(tree);
+
+    file = fopen(path, "wb");
+    if (file == NULL) return false;
+    setvbuf(file, NULL, _IOFBF, VEBTREE_IMAGE_WRITE_BUFFER);
+
+    /* the root sits right behind the header, followed by its subtrees block */
+    root = _vebtree_image_node(tree, 0, sizeof(VebTree));
+    success = fwrite(&header, sizeof(VebTreeImageHeader), 1, file) == 1
+        && fwrite(&root, sizeof(VebTree), 1, file) == 1
+        && (vebtree_is_leaf(tree) || !vebtree_has_subtrees(tree)
+            || _vebtree_image_write_block(file, tree, sizeof(VebTree)));
+
+    success = fclose(file) == 0 && success;
+    return success;
+}
+
+VebTree* vebtree_open_mmap(const char* path)
+{
+    int fd; struct stat file_stat; uint8_t* data; const VebTreeImageHeader* header;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    if (fstat(fd, &file_stat) != 0
+            || (size_t)file_stat.st_size < sizeof(VebTreeImageHeader) + sizeof(VebTree)) {
+        close(fd);
+        return NULL;
+    }
+
+    /* the mapping stays valid after closing the file descriptor */
+    data = (uint8_t*)mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    header = (const VebTreeImageHeader*)data;
+    if (memcmp(header->magic, VEBTREE_IMAGE_MAGIC, sizeof(VEBTREE_IMAGE_MAGIC)) != 0
+            || header->version != VEBTREE_IMAGE_VERSION
+            || header->byte_order != VEBTREE_IMAGE_BYTE_ORDER
+            || header->leaf_bits != VEBTREE_LEAF_BITS
+            || header->node_size != sizeof(VebTree)
+            || header->image_size + sizeof(VebTreeImageHeader) != (size_t)file_stat.st_size) {
+        munmap(data, (size_t)file_stat.st_size);
+        return NULL;
+    }
+
+    return (VebTree*)(data + sizeof(VebTreeImageHeader));
+}
+
+void vebtree_close_mmap(VebTree* tree)
+{
+    VebTreeImageHeader* header;
+    assert(vebtree_is_mapped(tree) && "only mapped trees can be closed!");
+
+    header = (VebTreeImageHeader*)((uint8_t*)tree - sizeof(VebTreeImageHeader));
+    munmap(header, sizeof(VebTreeImageHeader) + header->image_size);
+}
+
+#endif /* DOXYGEN_SKIP */
+#endif /* VEBTREES_MMAP_H */
@@ -0,0 +1,313 @@
+/* MIT License
+ *
+ * Copyright (c) 2022 Marco Tröster
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef VEBTREES_PQ_H
+#define VEBTREES_PQ_H
+
+#include "vebtrees.h"
+
+/* ===================================== *
+ *      T Y P E S   /  S T R U C T S
+ * ===================================== */
+
+/**
+ * @brief Monotone-friendly priority queue on top of a van Emde Boas tree, the keys
+ * are the priorities (smallest first). Keys are unique, so callers needing equal
+ * priorities encode a tie-breaking ID into the low key bits, e.g. (deadline << 20) | id.
+ * Pushes and pops run in O(log log u) independent of the queue depth.
+ */
+typedef struct _VEB_PRIORITY_QUEUE {
+    VebTree* tree;
+    /**< The tree holding the queued keys, it must only be modified by the vebpq functions. */
+    uint64_t size;
+    /**< The number of queued keys. */
+} VebPQ;
+
+/* ===================================== *
+ *          F U N C T I O N S
+ * ===================================== */
+
+/**
+ * @brief Create a new van Emde Boas priority queue.
+ *
+ * @param queue a reference pointer that is set to the newly allocated queue
+ * @param universe_bits the universe size of the queue's keys in bits
+ * @param flags a collection of flags adjusting the tree's behavior (see vebtree_init())
+ */
+void vebpq_init(VebPQ** queue, uint8_t universe_bits, uint8_t flags);
+
+/**
+ * @brief Free the memory allocated by the given queue, including the queue itself.
+ *
+ * @param queue the queue to be freed
+ */
+void vebpq_free(VebPQ* queue);
+
+/**
+ * @brief Enqueue the given key.
+ *
+ * @param queue the queue to be pushed to
+ * @param key the key to be enqueued
+ * @return a boolean whether the key wasn't queued yet
+ */
+bool vebpq_push(VebPQ* queue, vebkey_t key);
+
+/**
+ * @brief Retrieve the smallest queued key without dequeuing it.
+ *
+ * @param queue the queue to be looked up
+ * @return the smallest key or vebtree_null if the queue is empty
+ */
+vebkey_t vebpq_peek_min(VebPQ* queue);
+
+/**
+ * @brief Dequeue the smallest key. Other than vebtree_get_min() followed by
+ * vebtree_delete_key(), the key is removed within a single walk down the
+ * minimum's path, pulling up each node's new low along the way.
+ *
+ * @param queue the queue to be popped from
+ * @return the smallest key or vebtree_null if the queue is empty
+ */
+vebkey_t vebpq_pop_min(VebPQ* queue);
+
+/**
+ * @brief Move a queued key to a smaller priority.
+ *
+ * @param queue the queue holding the key
+ * @param key the queued key to be moved
+ * @param new_key the new key, it must not be queued yet and be smaller than the key
+ */
+void vebpq_decrease_key(VebPQ* queue, vebkey_t key, vebkey_t new_key);
+
+/**
+ * @brief Dequeue all keys below the given deadline in ascending order, at most capacity
+ * many. Whole locals are drained at once, so bitwise leafs are emptied word by word
+ * instead of running a separate delete per key.
+ *
+ * @param queue the queue to be popped from
+ * @param deadline the exclusive upper bound of the keys to be dequeued
+ * @param output the array to write the dequeued keys to
+ * @param capacity the maximum amount of keys to be written
+ * @return the amount of dequeued keys
+ */
+size_t vebpq_pop_until(VebPQ* queue, vebkey_t deadline, vebkey_t output[], size_t capacity);
+
+#ifndef DOXYGEN_SKIP
+
+/* ===================================== *
+ *        P R I O R I T Y   Q U E U E
+ * ===================================== */
+
+/* clear the leaf's lowest bit and return it, vebtree_null if the leaf is empty */
+vebkey_t _vebpq_pop_leaf_min(bitboard_t* leaf)
+{
+    vebkey_t min; uint32_t word;
+
+    word = vebtree_bitwise_leaf_next_word(leaf, 0);
+    if (word == VEBTREE_LEAF_WORDS) return vebtree_null;
+    min = ((vebkey_t)word << 6) | min_bit_set(leaf[word]);
+    leaf[word] &= leaf[word] - 1;
+    return min;
+}
+
+vebkey_t _vebpq_pop_min(VebTree* tree);
+
+/* pop the minimum of the local of the given global key, leaf parents pop it from the bitboard */
+#define _vebpq_pop_local_min(tree, global_key) (vebtree_has_leaf_locals(tree)\
+    ? _vebpq_pop_leaf_min(vebtree_leaf_cluster(tree, global_key)) : _vebpq_pop_min(&((tree)->locals[global_key])))
+
+/* delete the node's minimum and return it, vebtree_null if the node is empty */
+vebkey_t _vebpq_pop_min(VebTree* tree)
+{
+    vebkey_t min, global_low;
+
+    /* base case for tree leafs -> clear the lowest bit */
+    if (vebtree_is_leaf(tree))
+        return _vebpq_pop_leaf_min(tree->leaf);
+
+    /* base case with at most one element (also covers lazy nodes without subtrees) */
+    min = tree->low;
+    if (tree->low == tree->high) { tree->low = tree->high = vebtree_null; return min; }
+
+    /* the new low is popped from the first non-empty local, the high stays
+       untouched as it equals the new low if it was the last subtree key */
+    global_low = vebtree_get_min(vebtree_owned_global(tree));
+    tree->low = (global_low << tree->lower_bits) | _vebpq_pop_local_min(tree, global_low);
+    if (vebtree_is_counting(tree))
+        _vebtree_counts_add(tree, global_low, (uint64_t)-1);
+    _vebtree_unmark_full(tree, global_low);
+
+    if (_vebtree_cluster_is_empty(tree, global_low))
+        _vebpq_pop_min(vebtree_owned_global(tree));
+
+    /* release the lazy subtrees again once they ran empty */
+    if (vebtree_is_shrinking(tree) && !vebtree_is_arena(tree) && vebtree_is_empty(vebtree_owned_global(tree)))
+        _free_subtrees(tree);
+
+    return min;
+}
+
+/* pop all keys <= limit of the leaf, draining each bitboard word at once */
+size_t _vebpq_drain_leaf(bitboard_t* leaf, vebkey_t limit, vebkey_t prefix,
+                         vebkey_t output[], size_t capacity)
+{
+    size_t pos = 0; uint32_t word; vebkey_t last_word = vebtree_leaf_word(limit);
+    bitboard_t bits, remaining;
+
+    for (word = vebtree_bitwise_leaf_next_word(leaf, 0);
+            word < VEBTREE_LEAF_WORDS && word <= last_word && pos < capacity;
+            word = vebtree_bitwise_leaf_next_word(leaf, word + 1)) {
+        bits = word < last_word || (limit & 63) == 63 ? leaf[word]
+            : leaf[word] & trailing_bits_mask((limit & 63) + 1);
+
+        for (remaining = bits; remaining != 0 && pos < capacity; remaining &= remaining - 1)
+            output[pos++] = prefix | ((vebkey_t)word << 6) | min_bit_set(remaining);
+        leaf[word] &= ~bits | remaining;
+    }
+
+    return pos;
+}
+
+/* pop all keys <= limit of the node in ascending order, the prefix is or-ed into the output keys */
+size_t _vebpq_pop_until(VebTree* tree, vebkey_t limit, vebkey_t prefix,
+                        vebkey_t output[], size_t capacity)
+{
+    size_t pos = 0, num_popped; vebkey_t global_key, global_limit, local_limit;
+
+    /* base case for tree leafs */
+    if (vebtree_is_leaf(tree))
+        return _vebpq_drain_leaf(tree->leaf, limit, prefix, output, capacity);
+
+    /* base case for empty nodes or when even the low isn't due yet */
+    if (capacity == 0 || tree->low == vebtree_null || tree->low > limit)
+        return 0;
+
+    output[pos++] = prefix | tree->low;
+    if (tree->low == tree->high) { tree->low = tree->high = vebtree_null; return pos; }
+
+    /* drain the locals in ascending order, all but the limit's own local run empty */
+    global_limit = vebtree_global_address(limit, tree->lower_bits);
+    while (pos < capacity && (global_key = vebtree_get_min(vebtree_owned_global(tree))) != vebtree_null
+            && global_key <= global_limit) {
+        local_limit = global_key < global_limit ? vebtree_universe_maxvalue(tree->lower_bits) - 1
+            : vebtree_local_address(limit, tree->lower_bits);
+        num_popped = vebtree_has_leaf_locals(tree)
+            ? _vebpq_drain_leaf(vebtree_leaf_cluster(tree, global_key), local_limit,
+                prefix | (global_key << tree->lower_bits), output + pos, capacity - pos)
+            : _vebpq_pop_until(&(tree->locals[global_key]), local_limit,
+                prefix | (global_key << tree->lower_bits), output + pos, capacity - pos);
+        pos += num_popped;
+
+        if (vebtree_is_counting(tree))
+            _vebtree_counts_add(tree, global_key, (uint64_t)0 - num_popped);
+        if (num_popped > 0) _vebtree_unmark_full(tree, global_key);
+        if (!_vebtree_cluster_is_empty(tree, global_key))
+            break;
+        _vebpq_pop_min(vebtree_owned_global(tree));
+    }
+
+    /* pull the new low out of the remaining keys, the high is either remaining as well or was popped */
+    global_key = vebtree_get_min(vebtree_owned_global(tree));
+    if (global_key == vebtree_null) {
+        tree->low = tree->high = vebtree_null;
+    } else {
+        tree->low = (global_key << tree->lower_bits) | _vebpq_pop_local_min(tree, global_key);
+        if (vebtree_is_counting(tree))
+            _vebtree_counts_add(tree, global_key, (uint64_t)-1);
+        _vebtree_unmark_full(tree, global_key);
+        if (_vebtree_cluster_is_empty(tree, global_key))
+            _vebpq_pop_min(vebtree_owned_global(tree));
+    }
+
+    /* release the lazy subtrees again once they ran empty */
+    if (vebtree_is_shrinking(tree) && !vebtree_is_arena(tree) && vebtree_is_empty(vebtree_owned_global(tree)))
+        _free_subtrees(tree);
+
+    return pos;
+}
+
+/* ===================================== *
+ *       P R I O R I T Y   Q U E U E   A P I
+ * ===================================== */
+
+void vebpq_init(VebPQ** new_queue, uint8_t universe_bits, uint8_t flags)
+{
+    VebPQ* queue = (VebPQ*)malloc(sizeof(VebPQ));
+    assert(queue != NULL && "priority queue allocation failed unexpectedly!");
+    assert(!(flags & VEBTREE_FLAG_MAPPED) && "priority queues cannot be mapped read-only!");
+    assert(!(flags & (VEBTREE_FLAG_SPARSE | VEBTREE_FLAG_COW))
+        && "priority queues pop from the locals arrays in place, they cannot be sparse or copy-on-write!");
+    vebtree_init(&queue->tree, universe_bits, flags);
+    queue->size = 0;
+    *new_queue = queue;
+}
+
+void vebpq_free(VebPQ* queue)
+{
+    vebtree_free(queue->tree);
+    free(queue);
+}
+
+bool vebpq_push(VebPQ* queue, vebkey_t key)
+{
+    assert(key != vebtree_null && "cannot push vebtree_null, invalid key!");
+    if (!_vebtree_insert_key(queue->tree, key)) return false;
+    queue->size++;
+    return true;
+}
+
+vebkey_t vebpq_peek_min(VebPQ* queue)
+{
+    return vebtree_get_min(queue->tree);
+}
+
+vebkey_t vebpq_pop_min(VebPQ* queue)
+{
+    vebkey_t min = _vebpq_pop_min(queue->tree);
+    if (min != vebtree_null) queue->size--;
+    return min;
+}
+
+void vebpq_decrease_key(VebPQ* queue, vebkey_t key, vebkey_t new_key)
+{
+    assert(new_key < key && "the new key needs to be smaller than the queued key!");
+    assert(vebtree_contains_key(queue->tree, key) && "only queued keys can be decreased!");
+    assert(!vebtree_contains_key(queue->tree, new_key) && "the new key is already queued!");
+
+    vebtree_delete_key(queue->tree, key);
+    _vebtree_insert_key(queue->tree, new_key);
+}
+
+size_t vebpq_pop_until(VebPQ* queue, vebkey_t deadline, vebkey_t output[], size_t capacity)
+{
+    size_t num_popped;
+    if (deadline == 0) return 0;
+
+    num_popped = _vebpq_pop_until(queue->tree, deadline - 1, 0, output, capacity);
+    queue->size -= num_popped;
+    return num_popped;
+}
+
+#endif /* DOXYGEN_SKIP */
+#endif /* VEBTREES_PQ_H */
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include "vebtrees_alloc.h"
+
+#define NUM_KEYS 1000000
+#define NUM_QUERIES 2000000
+
+uint64_t lcg_next(uint64_t* state)
+{
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state;
+}
+
+double elapsed_seconds(struct timespec start, struct timespec end)
+{
+    return (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/* random successor lookups, each one walking nodes spread over the whole tree */
+double benchmark_successors_in_ns(uint8_t uni_bits, uint8_t flags, const VebAllocator* allocator)
+{
+    size_t i; uint64_t state = 42; vebkey_t checksum = 0; VebTree* tree;
+    struct timespec start, end;
+
+    vebtree_init_with_allocator(&tree, uni_bits, flags, allocator);
+    for (i = 0; i < NUM_KEYS; i++)
+        vebtree_insert_key(tree, lcg_next(&state) >> (64 - uni_bits));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < NUM_QUERIES; i++)
+        checksum += vebtree_successor(tree, lcg_next(&state) >> (64 - uni_bits));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    assert(checksum != 0);
+    vebtree_free(tree);
+    return elapsed_seconds(start, end) / NUM_QUERIES * 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    VebHugePageAllocator allocator;
+    uint8_t uni_bits[2] = { 28, 32 };
+    uint8_t flags[2] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_LAZY };
+    const char* names[2] = { "fully allocated, u=28", "lazy, u=32" };
+    size_t t;
+
+    for (t = 0; t < 2; t++) {
+        printf("Veb successor (%s, 1M keys) with malloc() took %lf ns per key\n",
+               names[t], benchmark_successors_in_ns(uni_bits[t], flags[t], NULL));
+
+        /* the address space is only reserved, physical memory is taken once touched */
+        if (!vebtree_hugepage_allocator_init(&allocator, (size_t)1 << 32, true)) {
+            printf("Huge page allocator could not reserve its address space, skipping\n");
+            return 0;
+        }
+        printf("Veb successor (%s, 1M keys) on huge pages took %lf ns per key\n",
+               names[t], benchmark_successors_in_ns(uni_bits[t], flags[t], &allocator.allocator));
+        vebtree_hugepage_allocator_destroy(&allocator);
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "vebtrees_alloc.h"
+
+typedef struct _COUNTING_ALLOCATOR {
+    size_t num_allocs;
+    size_t num_frees;
+    size_t live_bytes;
+} CountingAllocator;
+
+void* counting_alloc(void* context, size_t bytes)
+{
+    CountingAllocator* counter = (CountingAllocator*)context;
+    counter->num_allocs++;
+    counter->live_bytes += bytes;
+    return malloc(bytes);
+}
+
+void counting_free(void* context, void* memory, size_t bytes)
+{
+    CountingAllocator* counter = (CountingAllocator*)context;
+    counter->num_frees++;
+    counter->live_bytes -= bytes;
+    free(memory);
+}
+
+void assert_random_keys(VebTree* tree, uint8_t uni_bits, uint64_t seed, size_t num_keys)
+{
+    size_t i; vebkey_t key, mask = uni_bits == 64 ? 0xFFFFFFFFFFFFFFFEULL : ((vebkey_t)1 << uni_bits) - 1;
+
+    for (i = 0; i < num_keys; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        key = (seed >> 7) & mask;
+        assert(vebtree_contains_key(tree, key) && "inserted key is missing!");
+        assert(vebtree_successor(tree, key) == vebtree_null || vebtree_successor(tree, key) > key);
+    }
+}
+
+void insert_random_keys(VebTree* tree, uint8_t uni_bits, uint64_t seed, size_t num_keys)
+{
+    size_t i; vebkey_t mask = uni_bits == 64 ? 0xFFFFFFFFFFFFFFFEULL : ((vebkey_t)1 << uni_bits) - 1;
+
+    for (i = 0; i < num_keys; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        vebtree_insert_key(tree, (seed >> 7) & mask);
+    }
+}
+
+void should_route_all_allocations_through_allocator()
+{
+    size_t t; VebTree *tree, *snapshot, *plain_tree; CountingAllocator counter = { 0, 0, 0 };
+    VebAllocator allocator = { counting_alloc, counting_free, NULL };
+    uint8_t uni_bits[7] = { 16, 20, 32, 64, 20, 16, 6 };
+    uint8_t flags[7] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_COUNTS, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK,
+        VEBTREE_FLAG_SPARSE, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_COW, VEBTREE_FLAG_ARENA, VEBTREE_DEFAULT_FLAGS };
+    allocator.context = &counter;
+
+    for (t = 0; t < 7; t++) {
+        vebtree_init_with_allocator(&tree, uni_bits[t], flags[t], &allocator);
+        assert(counter.num_allocs > 0 && "the root should be allocated by the allocator!");
+
+        insert_random_keys(tree, uni_bits[t], t, 5000);
+        vebtree_delete_range(tree, 0, (vebkey_t)1 << (uni_bits[t] - 1));
+
+        /* snapshots and the blocks copied by the writer come from the allocator as well */
+        snapshot = vebtree_is_cow(tree) ? vebtree_snapshot(tree) : NULL;
+        insert_random_keys(tree, uni_bits[t], t + 100, 5000);
+        assert_random_keys(tree, uni_bits[t], t + 100, 5000);
+        if (snapshot != NULL) vebtree_free(snapshot);
+
+        /* trees without allocator keep using malloc() / free() */
+        vebtree_init(&plain_tree, uni_bits[t], flags[t]);
+        insert_random_keys(plain_tree, uni_bits[t], t, 1000);
+        vebtree_free(plain_tree);
+
+        vebtree_free(tree);
+        assert(counter.num_allocs == counter.num_frees && counter.live_bytes == 0
+            && "all memory of the allocator should be released again!");
+    }
+}
+
+void should_build_trees_with_bump_allocator()
+{
+    VebTree* tree; VebBumpAllocator bump; size_t capacity = (size_t)1 << 24;
+    void* buffer = malloc(capacity);
+
+    vebtree_bump_allocator_init(&bump, buffer, capacity);
+    vebtree_init_with_allocator(&tree, 20, VEBTREE_DEFAULT_FLAGS, &bump.allocator);
+    assert(bump.used >= vebtree_memory_usage(tree) && "the whole tree should sit within the buffer!");
+
+    insert_random_keys(tree, 20, 42, 20000);
+    assert_random_keys(tree, 20, 42, 20000);
+    vebtree_free(tree);
+
+    /* the buffer is reused as a whole once the tree is gone */
+    vebtree_bump_allocator_reset(&bump);
+    vebtree_init_with_allocator(&tree, 16, VEBTREE_FLAG_ARENA, &bump.allocator);
+    insert_random_keys(tree, 16, 43, 1000);
+    assert_random_keys(tree, 16, 43, 1000);
+    vebtree_free(tree);
+    assert(bump.used == 0 && "the arena tree should be taken back as latest allocation!");
+
+    free(buffer);
+}
+
+void should_reuse_freed_blocks_of_hugepage_allocator()
+{
+    size_t t, peak_used = 0; VebTree* tree; VebHugePageAllocator allocator; bool reserved;
+
+    reserved = vebtree_hugepage_allocator_init(&allocator, (size_t)1 << 30, true);
+    assert(reserved && "the address space should be reserved!");
+    vebtree_init_with_allocator(&tree, 32, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK, &allocator.allocator);
+    assert(((uintptr_t)tree & 15) == 0 && "allocations should be aligned to 16 bytes!");
+
+    /* shrinking trees release their subtrees, so later rounds reuse the freed blocks */
+    for (t = 0; t < 3; t++) {
+        insert_random_keys(tree, 32, 7, 20000);
+        assert_random_keys(tree, 32, 7, 20000);
+        vebtree_delete_range(tree, 0, 0xFFFFFFFF);
+        assert(vebtree_is_empty(tree));
+
+        if (t == 0) peak_used = allocator.arena.used;
+        assert(allocator.arena.used == peak_used && "freed blocks should be reused!");
+    }
+
+    vebtree_free(tree);
+    vebtree_hugepage_allocator_destroy(&allocator);
+}
+
+int main(int argc, char** argv)
+{
+    should_route_all_allocations_through_allocator();
+    should_build_trees_with_bump_allocator();
+    should_reuse_freed_blocks_of_hugepage_allocator();
+    return 0;
+}
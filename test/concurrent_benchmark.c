@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include "vebtrees_concurrent.h"
+
+/* ====================================================
+ *              M I X E D   W O R K L O A D
+ * ==================================================== */
+
+#define UNIVERSE_BITS 24
+#define SHARD_BITS 8
+#define MAX_THREADS 8
+
+typedef struct _WORKLOAD {
+    VebTree* tree;
+    /**< The tree guarded by a single global mutex (baseline). */
+    pthread_mutex_t* mutex;
+    /**< The global mutex of the baseline tree. */
+    VebShardedTree* sharded_tree;
+    /**< The sharded tree, used when it's not NULL. */
+    size_t num_ops;
+    /**< The amount of operations to be run by each thread. */
+    uint64_t seed;
+    /**< The random seed of the thread's key sequence. */
+} Workload;
+
+uint64_t xorshift64(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* 10% inserts, 10% deletes, 40% contains, 40% successor */
+void* run_mixed_workload(void* workload_ptr)
+{
+    size_t i; uint64_t rand, state; vebkey_t key, checksum = 0;
+    Workload* work = (Workload*)workload_ptr;
+    state = work->seed;
+
+    for (i = 0; i < work->num_ops; i++) {
+        rand = xorshift64(&state);
+        key = (rand >> 8) & (((vebkey_t)1 << UNIVERSE_BITS) - 1);
+
+        if (work->sharded_tree != NULL) {
+            switch (rand % 10) {
+                case 0: vebtree_sharded_insert_key(work->sharded_tree, key); break;
+                case 1: vebtree_sharded_delete_key(work->sharded_tree, key); break;
+                case 2: case 3: case 4: case 5:
+                    checksum += vebtree_sharded_contains_key(work->sharded_tree, key); break;
+                default: checksum += vebtree_sharded_successor(work->sharded_tree, key); break;
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(work->mutex);
+        switch (rand % 10) {
+            case 0: vebtree_insert_key(work->tree, key); break;
+            case 1: /* most keys are absent, deleting them would corrupt the tree */
+                if (vebtree_contains_key(work->tree, key)) vebtree_delete_key(work->tree, key);
+                break;
+            case 2: case 3: case 4: case 5:
+                checksum += vebtree_contains_key(work->tree, key); break;
+            default: checksum += vebtree_successor(work->tree, key); break;
+        }
+        pthread_mutex_unlock(work->mutex);
+    }
+
+    work->seed = checksum; /* keep the queries from being optimized out */
+    return NULL;
+}
+
+/* ====================================================
+ *                B E N C H M A R K
+ * ==================================================== */
+
+double elapsed_seconds(struct timespec start, struct timespec end)
+{
+    return (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+double benchmark_mixed_workload_in_mops(bool sharded, size_t num_threads, size_t ops_per_thread)
+{
+    size_t i; VebTree* tree = NULL; VebShardedTree* sharded_tree = NULL;
+    pthread_mutex_t mutex; pthread_t threads[MAX_THREADS]; Workload work[MAX_THREADS];
+    struct timespec start, end; uint64_t state = 42;
+
+    /* prefill a quarter of the universe */
+    if (sharded) vebtree_sharded_init(&sharded_tree, UNIVERSE_BITS, SHARD_BITS, VEBTREE_DEFAULT_FLAGS);
+    else vebtree_init(&tree, UNIVERSE_BITS, VEBTREE_DEFAULT_FLAGS);
+    pthread_mutex_init(&mutex, NULL);
+
+    for (i = 0; i < ((size_t)1 << (UNIVERSE_BITS - 2)); i++) {
+        vebkey_t key = xorshift64(&state) & (((vebkey_t)1 << UNIVERSE_BITS) - 1);
+        if (sharded) vebtree_sharded_insert_key(sharded_tree, key);
+        else vebtree_insert_key(tree, key);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < num_threads; i++) {
+        work[i].tree = tree;
+        work[i].mutex = &mutex;
+        work[i].sharded_tree = sharded_tree;
+        work[i].num_ops = ops_per_thread;
+        work[i].seed = 0x9E3779B97F4A7C15 * (i + 1);
+        pthread_create(&threads[i], NULL, run_mixed_workload, &work[i]);
+    }
+
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_mutex_destroy(&mutex);
+    if (sharded) vebtree_sharded_free(sharded_tree);
+    else vebtree_free(tree);
+
+    return (double)(num_threads * ops_per_thread) / elapsed_seconds(start, end) / 1e6;
+}
+
+double benchmark_init_free_in_ms(uint8_t uni_bits, uint8_t flags, size_t num_threads, size_t test_runs)
+{
+    size_t t; VebTree* tree; struct timespec start, end; double elapsed = 0;
+
+    for (t = 0; t < test_runs; t++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        vebtree_init_parallel(&tree, uni_bits, flags, num_threads);
+        vebtree_free_parallel(tree, num_threads);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed += elapsed_seconds(start, end);
+    }
+
+    return elapsed / test_runs * 1000;
+}
+
+double benchmark_bulk_insert_in_ms(uint8_t uni_bits, size_t num_keys, size_t num_threads, size_t test_runs)
+{
+    size_t i, t; VebTree* tree; vebkey_t* keys; uint64_t state = 42;
+    struct timespec start, end; double elapsed = 0;
+
+    keys = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    assert(keys != NULL && "keys array allocation failed unexpectedly!");
+    for (i = 0; i < num_keys; i++)
+        keys[i] = xorshift64(&state) & (((vebkey_t)1 << uni_bits) - 1);
+
+    for (t = 0; t < test_runs; t++) {
+        vebtree_init(&tree, uni_bits, VEBTREE_DEFAULT_FLAGS);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        vebtree_insert_keys_parallel(tree, keys, num_keys, num_threads);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed += elapsed_seconds(start, end);
+        vebtree_free(tree);
+    }
+
+    free(keys);
+    return elapsed / test_runs * 1000;
+}
+
+double benchmark_sort_in_ms(size_t num_keys, size_t num_threads, size_t test_runs)
+{
+    size_t i, t; vebkey_t *keys, *output; uint64_t state = 42;
+    struct timespec start, end; double elapsed = 0;
+
+    keys = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    output = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    assert(keys != NULL && output != NULL && "keys array allocation failed unexpectedly!");
+
+    /* clustered 64-bit IDs with duplicates */
+    for (i = 0; i < num_keys; i++)
+        keys[i] = 0x123456789ABC + xorshift64(&state) % (16 * num_keys);
+
+    for (t = 0; t < test_runs; t++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        vebtree_sort_parallel(keys, num_keys, output, VEBTREE_SORT_DEFAULT, num_threads);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        elapsed += elapsed_seconds(start, end);
+    }
+
+    for (i = 0; i < num_keys - 1; i++)
+        assert(output[i] <= output[i + 1]);
+
+    free(keys); free(output);
+    return elapsed / test_runs * 1000;
+}
+
+int main(int argc, char** argv)
+{
+    size_t num_threads, ops_per_thread = 200000;
+
+    for (num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+        printf("Veb init + free (u=24) with %zu threads took %lf milliseconds\n", num_threads,
+               benchmark_init_free_in_ms(24, VEBTREE_DEFAULT_FLAGS, num_threads, 10));
+        printf("Veb arena init + free (u=24) with %zu threads took %lf milliseconds\n", num_threads,
+               benchmark_init_free_in_ms(24, VEBTREE_FLAG_ARENA, num_threads, 10));
+        printf("Veb bulk insert (u=24, 4M keys) with %zu threads took %lf milliseconds\n", num_threads,
+               benchmark_bulk_insert_in_ms(24, (size_t)1 << 22, num_threads, 3));
+        printf("Veb sorting (4M clustered IDs) with %zu threads took %lf milliseconds\n", num_threads,
+               benchmark_sort_in_ms((size_t)1 << 22, num_threads, 3));
+    }
+
+    for (num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+        printf("Global mutex tree with %zu threads: %lf Mops/s\n", num_threads,
+               benchmark_mixed_workload_in_mops(false, num_threads, ops_per_thread));
+        printf("Sharded tree with %zu threads: %lf Mops/s\n", num_threads,
+               benchmark_mixed_workload_in_mops(true, num_threads, ops_per_thread));
+    }
+
+    return 0;
+}
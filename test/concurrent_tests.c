@@ -0,0 +1,352 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include "vebtrees_concurrent.h"
+
+#define NUM_THREADS 4
+#define KEYS_PER_THREAD 20000
+
+void should_find_keys_across_shards()
+{
+    VebShardedTree* tree;
+    vebtree_sharded_init(&tree, 24, 6, VEBTREE_DEFAULT_FLAGS);
+
+    assert(vebtree_sharded_is_empty(tree));
+    assert(vebtree_sharded_get_min(tree) == vebtree_null);
+    assert(vebtree_sharded_get_max(tree) == vebtree_null);
+    assert(vebtree_sharded_successor(tree, 0) == vebtree_null);
+    assert(vebtree_sharded_predecessor(tree, 0xFFFFFF) == vebtree_null);
+
+    /* keys of shard 0, 1, 42 and 63 (the last one) */
+    vebtree_sharded_insert_key(tree, 5);
+    vebtree_sharded_insert_key(tree, 0x40000);
+    vebtree_sharded_insert_key(tree, 0xA80123);
+    vebtree_sharded_insert_key(tree, 0xFFFFFF);
+
+    assert(!vebtree_sharded_is_empty(tree));
+    assert(vebtree_sharded_contains_key(tree, 0xA80123));
+    assert(!vebtree_sharded_contains_key(tree, 0xA80124));
+    assert(vebtree_sharded_get_min(tree) == 5);
+    assert(vebtree_sharded_get_max(tree) == 0xFFFFFF);
+
+    assert(vebtree_sharded_successor(tree, 5) == 0x40000);
+    assert(vebtree_sharded_successor(tree, 0x40000) == 0xA80123);
+    assert(vebtree_sharded_successor(tree, 0xA80123) == 0xFFFFFF);
+    assert(vebtree_sharded_successor(tree, 0xFFFFFF) == vebtree_null);
+    assert(vebtree_sharded_predecessor(tree, 0xFFFFFF) == 0xA80123);
+    assert(vebtree_sharded_predecessor(tree, 0xA80123) == 0x40000);
+    assert(vebtree_sharded_predecessor(tree, 0x40000) == 5);
+    assert(vebtree_sharded_predecessor(tree, 5) == vebtree_null);
+    assert(vebtree_sharded_predecessor(tree, 0x1000000) == 0xFFFFFF);
+
+    /* emptied shards are skipped again */
+    vebtree_sharded_delete_key(tree, 0x40000);
+    vebtree_sharded_delete_key(tree, 0xFFFFFF);
+    assert(vebtree_sharded_successor(tree, 5) == 0xA80123);
+    assert(vebtree_sharded_get_max(tree) == 0xA80123);
+
+    vebtree_sharded_delete_key(tree, 5);
+    vebtree_sharded_delete_key(tree, 0xA80123);
+    assert(vebtree_sharded_is_empty(tree));
+
+    vebtree_sharded_free(tree);
+}
+
+typedef struct _WORKER_ARGS {
+    VebShardedTree* tree;
+    size_t thread_id;
+} WorkerArgs;
+
+void* insert_interleaved_keys(void* args_ptr)
+{
+    size_t i; vebkey_t key; WorkerArgs* args = (WorkerArgs*)args_ptr;
+
+    /* each thread inserts every NUM_THREADS-th key, spread over all shards;
+       every other key is deleted again while other threads query the tree */
+    for (i = 0; i < KEYS_PER_THREAD; i++) {
+        key = (i * NUM_THREADS + args->thread_id) * 97;
+        vebtree_sharded_insert_key(args->tree, key);
+        assert(vebtree_sharded_contains_key(args->tree, key));
+        assert(vebtree_sharded_successor(args->tree, key) != key);
+
+        if (i % 2 == 1) {
+            vebtree_sharded_delete_key(args->tree, key);
+            assert(!vebtree_sharded_contains_key(args->tree, key));
+        }
+    }
+
+    return NULL;
+}
+
+void should_insert_and_delete_keys_concurrently()
+{
+    size_t i, num_keys = 0; vebkey_t key, prev_key = 0; VebShardedTree* tree;
+    pthread_t threads[NUM_THREADS]; WorkerArgs args[NUM_THREADS];
+    vebtree_sharded_init(&tree, 24, 8, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK);
+
+    for (i = 0; i < NUM_THREADS; i++) {
+        args[i].tree = tree;
+        args[i].thread_id = i;
+        pthread_create(&threads[i], NULL, insert_interleaved_keys, &args[i]);
+    }
+
+    for (i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    /* exactly the keys with even per-thread index remain, in ascending order */
+    for (key = vebtree_sharded_get_min(tree); key != vebtree_null;
+            key = vebtree_sharded_successor(tree, key)) {
+        assert(key % 97 == 0 && ((key / 97) / NUM_THREADS) % 2 == 0);
+        assert(num_keys == 0 || prev_key < key);
+        prev_key = key; num_keys++;
+    }
+
+    assert(num_keys == NUM_THREADS * KEYS_PER_THREAD / 2);
+    vebtree_sharded_free(tree);
+}
+
+void* delete_absent_keys(void* args_ptr)
+{
+    size_t i; vebkey_t key; uint64_t state; WorkerArgs* args = (WorkerArgs*)args_ptr;
+
+    /* each thread inserts its share of the even keys, while deleting random odd keys
+       that are never part of the tree, hitting the same shards as the inserts */
+    for (i = 0, state = args->thread_id; i < KEYS_PER_THREAD; i++) {
+        key = (i * NUM_THREADS + args->thread_id) * 2;
+        vebtree_sharded_insert_key(args->tree, key);
+
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        vebtree_sharded_delete_key(args->tree, ((state >> 40) % (NUM_THREADS * KEYS_PER_THREAD)) * 2 + 1);
+        assert(vebtree_sharded_contains_key(args->tree, key));
+    }
+
+    return NULL;
+}
+
+void should_ignore_deleting_absent_keys()
+{
+    size_t i, num_keys = 0; vebkey_t key; VebShardedTree* tree;
+    pthread_t threads[NUM_THREADS]; WorkerArgs args[NUM_THREADS];
+
+    /* absent keys next to present ones, in empty shards and beyond the universe */
+    vebtree_sharded_init(&tree, 20, 6, VEBTREE_DEFAULT_FLAGS);
+    vebtree_sharded_insert_key(tree, 5);
+    vebtree_sharded_delete_key(tree, 7);
+    vebtree_sharded_delete_key(tree, 0x80000);
+    vebtree_sharded_delete_key(tree, 0x100000);
+    assert(vebtree_sharded_contains_key(tree, 5) && !vebtree_sharded_is_empty(tree));
+    assert(vebtree_sharded_get_min(tree) == 5 && vebtree_sharded_get_max(tree) == 5);
+    vebtree_sharded_free(tree);
+
+    vebtree_sharded_init(&tree, 24, 8, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK);
+    for (i = 0; i < NUM_THREADS; i++) {
+        args[i].tree = tree;
+        args[i].thread_id = i;
+        pthread_create(&threads[i], NULL, delete_absent_keys, &args[i]);
+    }
+
+    for (i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    /* all even keys survived the deletions */
+    for (key = vebtree_sharded_get_min(tree); key != vebtree_null;
+            key = vebtree_sharded_successor(tree, key), num_keys++)
+        assert(key == num_keys * 2);
+
+    assert(num_keys == NUM_THREADS * KEYS_PER_THREAD);
+    vebtree_sharded_free(tree);
+}
+
+void assert_same_tree_layout(VebTree* a, VebTree* b, const uint8_t* arena_a, const uint8_t* arena_b)
+{
+    size_t i;
+
+    assert(a->universe_bits == b->universe_bits);
+    assert(a->lower_bits == b->lower_bits);
+    assert(a->flags == b->flags);
+    if (vebtree_is_leaf(a)) return;
+
+    assert(vebtree_has_subtrees(a) == vebtree_has_subtrees(b));
+    if (!vebtree_has_subtrees(a)) return;
+
+    /* arena trees need to place each subtree at the same offset */
+    if (arena_a != NULL) {
+        assert((uint8_t*)vebtree_global(a) - arena_a == (uint8_t*)vebtree_global(b) - arena_b);
+        assert((uint8_t*)a->locals - arena_a == (uint8_t*)b->locals - arena_b);
+    }
+
+    assert_same_tree_layout(vebtree_global(a), vebtree_global(b), arena_a, arena_b);
+    if (vebtree_has_leaf_locals(a)) {
+        assert(memcmp(a->locals, b->locals, ((size_t)1 << a->upper_bits) * VEBTREE_LEAF_BYTES) == 0);
+        return;
+    }
+
+    for (i = 0; i < ((size_t)1 << a->upper_bits); i++)
+        assert_same_tree_layout(&(a->locals[i]), &(b->locals[i]), arena_a, arena_b);
+}
+
+void should_init_and_free_trees_in_parallel()
+{
+    size_t i; uint8_t flags; VebTree *tree, *expected;
+
+    for (i = 0; i < 3; i++) {
+        flags = i == 0 ? VEBTREE_DEFAULT_FLAGS
+            : i == 1 ? VEBTREE_FLAG_ARENA : VEBTREE_FLAG_ARENA | VEBTREE_FLAG_COUNTS;
+        vebtree_init(&expected, 20, flags);
+        vebtree_init_parallel(&tree, 20, flags, NUM_THREADS);
+
+        assert_same_tree_layout(tree, expected,
+            flags & VEBTREE_FLAG_ARENA ? (uint8_t*)tree : NULL,
+            flags & VEBTREE_FLAG_ARENA ? (uint8_t*)expected : NULL);
+
+        vebtree_insert_key(tree, 0xABCDE);
+        vebtree_insert_key(tree, 42);
+        assert(vebtree_successor(tree, 42) == 0xABCDE);
+
+        vebtree_free(expected);
+        vebtree_free_parallel(tree, NUM_THREADS);
+    }
+}
+
+void should_bulk_insert_keys_in_parallel()
+{
+    size_t i, j, num_keys = 300000, num_unique, num_actual; uint64_t state;
+    vebkey_t *keys, *expected, *actual; VebTree *tree, *reference;
+    uint8_t flags[3] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_LAZY, VEBTREE_FLAG_COUNTS };
+    uint8_t uni_bits[3] = { 20, 24, 20 };
+
+    keys = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    expected = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    actual = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+
+    for (i = 0; i < 3; i++) {
+        /* shuffled keys with duplicates, spread across the whole universe */
+        for (j = 0, state = 12345; j < num_keys; j++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            keys[j] = (state >> 11) & (((vebkey_t)1 << uni_bits[i]) - 1);
+        }
+
+        vebtree_init(&reference, uni_bits[i], flags[i]);
+        vebtree_init_parallel(&tree, uni_bits[i], flags[i], NUM_THREADS);
+        vebtree_insert_keys(reference, keys, num_keys);
+        vebtree_insert_keys_parallel(tree, keys, num_keys, NUM_THREADS);
+
+        num_unique = vebtree_to_array(reference, expected, num_keys);
+        num_actual = vebtree_to_array(tree, actual, num_keys);
+        assert(num_actual == num_unique);
+        for (j = 0; j < num_unique; j++)
+            assert(actual[j] == expected[j]);
+        assert(vebtree_get_min(tree) == vebtree_get_min(reference));
+        assert(vebtree_get_max(tree) == vebtree_get_max(reference));
+        assert(vebtree_contains_key(tree, keys[num_keys / 2]));
+
+        if (flags[i] & VEBTREE_FLAG_COUNTS) {
+            assert(vebtree_size(tree) == num_unique);
+            for (j = 0; j < num_unique; j += 97)
+                assert(vebtree_select(tree, j) == expected[j] && vebtree_rank(tree, expected[j]) == j);
+        }
+
+        vebtree_free(reference);
+        vebtree_free_parallel(tree, NUM_THREADS);
+    }
+
+    free(keys); free(expected); free(actual);
+}
+
+int compare_keys(const void* a, const void* b)
+{
+    vebkey_t key_a = *(const vebkey_t*)a, key_b = *(const vebkey_t*)b;
+    return key_a < key_b ? -1 : (key_a > key_b ? 1 : 0);
+}
+
+void should_sort_keys_in_parallel()
+{
+    size_t i, d, num_keys = 200000, num_unique, num_sorted; uint64_t state = 3;
+    vebkey_t *keys, *expected, *actual;
+
+    keys = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    expected = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    actual = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+
+    /* clustered IDs with duplicates and random 64-bit keys */
+    for (d = 0; d < 2; d++) {
+        for (i = 0; i < num_keys; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            keys[i] = d == 0 ? 5000000000ULL + (state >> 47) : state;
+            expected[i] = keys[i];
+        }
+        qsort(expected, num_keys, sizeof(vebkey_t), compare_keys);
+
+        num_sorted = vebtree_sort_parallel(keys, num_keys, actual, VEBTREE_SORT_DEFAULT, NUM_THREADS);
+        assert(num_sorted == num_keys);
+        for (i = 0; i < num_keys; i++)
+            assert(actual[i] == expected[i]);
+
+        for (i = 1, num_unique = 1; i < num_keys; i++)
+            if (expected[i] != expected[num_unique - 1])
+                expected[num_unique++] = expected[i];
+
+        num_sorted = vebtree_sort_parallel(keys, num_keys, actual, VEBTREE_SORT_UNIQUE, NUM_THREADS);
+        assert(num_sorted == num_unique);
+        for (i = 0; i < num_unique; i++)
+            assert(actual[i] == expected[i]);
+    }
+
+    free(keys); free(expected); free(actual);
+}
+
+void* scan_snapshot(void* snapshot_ptr)
+{
+    size_t i, num_keys; vebkey_t key; VebTree* snapshot = (VebTree*)snapshot_ptr;
+
+    /* the snapshot keeps its keys while the writer modifies the tree, the
+       reader releases it on its own thread once it's done */
+    for (i = 0; i < 3; i++) {
+        for (key = vebtree_get_min(snapshot), num_keys = 0; key != vebtree_null;
+                key = vebtree_successor(snapshot, key), num_keys++)
+            assert(key % 7 == 0);
+        assert(num_keys == KEYS_PER_THREAD);
+    }
+
+    vebtree_free(snapshot);
+    return NULL;
+}
+
+void should_read_snapshots_while_writing()
+{
+    size_t i; vebkey_t key; VebTree* tree; pthread_t threads[NUM_THREADS];
+    vebtree_init(&tree, 24, VEBTREE_FLAG_COW | VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK);
+
+    for (i = 0; i < KEYS_PER_THREAD; i++)
+        vebtree_insert_key(tree, i * 7);
+
+    /* snapshots are taken by the writer, the readers don't need any locks */
+    for (i = 0; i < NUM_THREADS; i++)
+        pthread_create(&threads[i], NULL, scan_snapshot, vebtree_snapshot(tree));
+
+    for (i = 0; i < KEYS_PER_THREAD; i++) {
+        vebtree_insert_key(tree, i * 7 + 1);
+        if (i % 2 == 0) vebtree_delete_key(tree, i * 7);
+    }
+
+    for (i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0, key = vebtree_get_min(tree); key != vebtree_null; key = vebtree_successor(tree, key), i++)
+        assert(key % 7 == 1 || (key / 7) % 2 == 1);
+    assert(i == KEYS_PER_THREAD + KEYS_PER_THREAD / 2);
+    vebtree_free(tree);
+}
+
+int main(int argc, char** argv)
+{
+    should_find_keys_across_shards();
+    should_insert_and_delete_keys_concurrently();
+    should_ignore_deleting_absent_keys();
+    should_init_and_free_trees_in_parallel();
+    should_bulk_insert_keys_in_parallel();
+    should_sort_keys_in_parallel();
+    should_read_snapshots_while_writing();
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "vebtrees.h"
+#include "vebtrees.hpp"
+
+/* ====================================================
+ *                B E N C H M A R K
+ * ==================================================== */
+
+#define UNIVERSE_BITS 24
+
+std::uint64_t xorshift64(std::uint64_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+std::vector<vebkey_t> random_keys(std::size_t num_keys, std::uint64_t seed)
+{
+    std::vector<vebkey_t> keys(num_keys);
+    for (std::size_t i = 0; i < num_keys; i++)
+        keys[i] = xorshift64(seed) & (((vebkey_t)1 << UNIVERSE_BITS) - 1);
+    return keys;
+}
+
+template <typename Func>
+double measure_ns_per_query(Func&& run_queries, std::size_t num_queries)
+{
+    auto start = std::chrono::steady_clock::now();
+    vebkey_t checksum = run_queries();
+    auto end = std::chrono::steady_clock::now();
+
+    /* keep the queries from being optimized out */
+    if (checksum == 42) std::printf(" ");
+    return std::chrono::duration<double, std::nano>(end - start).count() / num_queries;
+}
+
+int main()
+{
+    std::size_t num_keys = (std::size_t)1 << 20, num_queries = (std::size_t)1 << 23;
+    std::vector<vebkey_t> keys = random_keys(num_keys, 42), queries = random_keys(num_queries, 7);
+    veb::set<UNIVERSE_BITS> set; VebTree* tree;
+
+    vebtree_init(&tree, UNIVERSE_BITS, VEBTREE_DEFAULT_FLAGS);
+    for (vebkey_t key : keys) {
+        vebtree_insert_key(tree, key);
+        set.insert(key);
+    }
+
+    std::printf("Veb tree contains (u=24, 1M keys) took %lf nanoseconds per query\n",
+        measure_ns_per_query([&]() {
+            vebkey_t sum = 0;
+            for (vebkey_t key : queries) sum += vebtree_contains_key(tree, key);
+            return sum; }, num_queries));
+    std::printf("veb::set<24> contains (1M keys) took %lf nanoseconds per query\n",
+        measure_ns_per_query([&]() {
+            vebkey_t sum = 0;
+            for (vebkey_t key : queries) sum += set.contains(key);
+            return sum; }, num_queries));
+
+    std::printf("Veb tree successor (u=24, 1M keys) took %lf nanoseconds per query\n",
+        measure_ns_per_query([&]() {
+            vebkey_t sum = 0;
+            for (vebkey_t key : queries) sum += vebtree_successor(tree, key);
+            return sum; }, num_queries));
+    std::printf("veb::set<24> successor (1M keys) took %lf nanoseconds per query\n",
+        measure_ns_per_query([&]() {
+            vebkey_t sum = 0;
+            for (vebkey_t key : queries) sum += set.successor(key);
+            return sum; }, num_queries));
+
+    std::printf("Veb tree insert + delete (u=24) took %lf nanoseconds per key\n",
+        measure_ns_per_query([&]() {
+            for (vebkey_t key : queries) vebtree_insert_key(tree, key);
+            for (vebkey_t key : queries) if (vebtree_contains_key(tree, key)) vebtree_delete_key(tree, key);
+            return vebtree_get_min(tree); }, num_queries));
+    std::printf("veb::set<24> insert + erase took %lf nanoseconds per key\n",
+        measure_ns_per_query([&]() {
+            for (vebkey_t key : queries) set.insert(key);
+            for (vebkey_t key : queries) set.erase(key);
+            return set.min(); }, num_queries));
+
+    vebtree_free(tree);
+    return 0;
+}
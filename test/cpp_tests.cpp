@@ -0,0 +1,117 @@
+#include <cassert>
+#include <cstdint>
+#include <set>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include "vebtrees.hpp"
+
+/* random keys of the universe, clustered for universes beyond 32 bits */
+template <unsigned Bits>
+veb::key_type random_key(std::uint64_t& state)
+{
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return Bits > 32 ? ((veb::set<Bits>::max_key >> 20) << 20) | (state >> 44)
+        : (state >> 11) & veb::set<Bits>::max_key;
+}
+
+template <unsigned Bits>
+void assert_same_keys(const veb::set<Bits>& set, const std::set<veb::key_type>& expected)
+{
+    std::vector<veb::key_type> keys(set.begin(), set.end());
+    std::vector<veb::key_type> reversed(set.rbegin(), set.rend());
+
+    assert(set.size() == expected.size() && set.empty() == expected.empty());
+    assert(keys.size() == expected.size() && reversed.size() == expected.size());
+    assert(std::equal(keys.begin(), keys.end(), expected.begin()));
+    assert(std::equal(reversed.begin(), reversed.end(), expected.rbegin()));
+    assert(set.min() == (expected.empty() ? veb::null : *expected.begin()));
+    assert(set.max() == (expected.empty() ? veb::null : *expected.rbegin()));
+}
+
+template <unsigned Bits>
+void should_match_std_set(std::size_t num_ops)
+{
+    veb::set<Bits> set; std::set<veb::key_type> expected;
+    std::uint64_t state = Bits; veb::key_type key, succ, pred; std::size_t i, erased, expected_erased;
+    bool inserted, expected_inserted;
+
+    for (i = 0; i < num_ops; i++) {
+        key = random_key<Bits>(state);
+        if (state % 3 != 0) {
+            inserted = set.insert(key).second;
+            expected_inserted = expected.insert(key).second;
+            assert(inserted == expected_inserted);
+        } else {
+            erased = set.erase(key);
+            expected_erased = expected.erase(key);
+            assert(erased == expected_erased);
+        }
+
+        /* compare the queries of another random key */
+        key = random_key<Bits>(state);
+        assert(set.contains(key) == (expected.count(key) == 1));
+        assert(set.find(key) == (expected.count(key) == 1 ? set.lower_bound(key) : set.end()));
+
+        succ = expected.upper_bound(key) == expected.end() ? veb::null : *expected.upper_bound(key);
+        pred = expected.lower_bound(key) == expected.begin() ? veb::null : *std::prev(expected.lower_bound(key));
+        assert(set.successor(key) == succ && set.predecessor(key) == pred);
+        assert(*set.upper_bound(key) == succ);
+        assert(*set.lower_bound(key) == (expected.lower_bound(key) == expected.end()
+            ? veb::null : *expected.lower_bound(key)));
+    }
+    assert_same_keys(set, expected);
+
+    /* erase all keys through iterators */
+    for (auto it = set.begin(); it != set.end();)
+        it = set.erase(it);
+    expected.clear();
+    assert_same_keys(set, expected);
+}
+
+void should_move_sets()
+{
+    veb::set<20> set, other; veb::key_type key;
+    for (key = 0; key < 100000; key += 7)
+        set.insert(key);
+
+    other = std::move(set);
+    assert(set.empty() && set.begin() == set.end() && !set.contains(7));
+    assert(other.size() == 14286 && other.contains(7) && other.max() == 99995);
+
+    veb::set<20> moved(std::move(other));
+    assert(other.empty() && moved.size() == 14286);
+    assert(std::distance(moved.lower_bound(50000), moved.end()) == 7143);
+
+    /* moved-from sets are reusable */
+    other.insert(3);
+    assert(other.size() == 1 && *other.begin() == 3);
+}
+
+void should_handle_universe_bounds()
+{
+    veb::set<64> set;
+    set.insert(0);
+    set.insert(veb::set<64>::max_key);
+    assert(set.successor(0) == veb::set<64>::max_key);
+    assert(set.successor(veb::set<64>::max_key) == veb::null);
+    assert(set.predecessor(veb::null) == veb::set<64>::max_key);
+    assert(*set.lower_bound(1) == veb::set<64>::max_key);
+
+    veb::set<5> tiny;
+    tiny.insert(31);
+    assert(tiny.contains(31) && !tiny.contains(32));
+    assert(tiny.predecessor(1000) == 31 && tiny.successor(31) == veb::null);
+}
+
+int main()
+{
+    should_match_std_set<6>(2000);
+    should_match_std_set<12>(20000);
+    should_match_std_set<20>(50000);
+    should_match_std_set<32>(50000);
+    should_match_std_set<64>(50000);
+    should_move_sets();
+    should_handle_universe_bounds();
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "vebtrees_map.h"
+
+#define NUM_POOL_KEYS 3000
+#define VALUE_SIZE 12
+
+int compare_keys(const void* a, const void* b)
+{
+    vebkey_t key_a = *(const vebkey_t*)a, key_b = *(const vebkey_t*)b;
+    return key_a < key_b ? -1 : (key_a > key_b ? 1 : 0);
+}
+
+/* odd-sized values derived from the key and the round they were put in */
+void make_value(uint8_t value[VALUE_SIZE], vebkey_t key, uint32_t round)
+{
+    uint64_t head = key * 0x9E3779B97F4A7C15ULL + round;
+    memcpy(value, &head, sizeof(uint64_t));
+    memcpy(value + sizeof(uint64_t), &round, sizeof(uint32_t));
+}
+
+/* compare the map against the reference entries, scanning both directions */
+void assert_same_entries(VebMap* map, const vebkey_t pool[], const bool present[],
+                         uint8_t values[][VALUE_SIZE], size_t num_keys)
+{
+    size_t i; vebkey_t key; void* value;
+
+    for (i = 0; i < num_keys; i++) {
+        value = vebmap_get(map, pool[i]);
+        assert(present[i] ? value != NULL && memcmp(value, values[i], VALUE_SIZE) == 0 : value == NULL);
+    }
+
+    key = vebtree_get_min(map->tree);
+    for (i = 0; i < num_keys; i++) {
+        if (!present[i]) continue;
+        assert(key == pool[i]);
+        assert(memcmp(vebmap_get(map, key), values[i], VALUE_SIZE) == 0);
+        key = vebmap_successor_entry(map, key, &value);
+        assert(key == vebtree_null || memcmp(value, vebmap_get(map, key), VALUE_SIZE) == 0);
+    }
+    assert(key == vebtree_null);
+
+    for (i = num_keys; i > 0; i--) {
+        if (!present[i - 1]) continue;
+        key = vebmap_predecessor_entry(map, pool[i - 1], &value);
+        assert(key == vebtree_predecessor(map->tree, pool[i - 1]));
+        assert(key == vebtree_null || memcmp(value, vebmap_get(map, key), VALUE_SIZE) == 0);
+    }
+}
+
+void should_put_get_and_erase_entries()
+{
+    size_t c, i, j, num_keys; uint64_t state = 17; uint32_t round;
+    vebkey_t *pool; bool *present, erased; uint8_t (*values)[VALUE_SIZE]; void* value; VebMap* map;
+    uint8_t uni_bits[5] = { VEBTREE_LEAF_BITS, 16, 20, 32, 64 };
+    uint8_t flags[5] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS,
+        VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK, VEBTREE_FLAG_LAZY };
+
+    pool = (vebkey_t*)malloc(NUM_POOL_KEYS * sizeof(vebkey_t));
+    present = (bool*)malloc(NUM_POOL_KEYS * sizeof(bool));
+    values = (uint8_t (*)[VALUE_SIZE])malloc(NUM_POOL_KEYS * VALUE_SIZE);
+
+    for (c = 0; c < 5; c++) {
+        /* a sorted pool of distinct keys, clustered for the 64-bit universe */
+        for (i = 0; i < NUM_POOL_KEYS; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            pool[i] = uni_bits[c] == 64 ? 0xFEDC000000000000ULL | (state >> 36)
+                : (state >> 11) & (((vebkey_t)1 << uni_bits[c]) - 1);
+        }
+        qsort(pool, NUM_POOL_KEYS, sizeof(vebkey_t), compare_keys);
+        for (i = 1, num_keys = 1; i < NUM_POOL_KEYS; i++)
+            if (pool[i] != pool[num_keys - 1])
+                pool[num_keys++] = pool[i];
+        memset(present, 0, num_keys * sizeof(bool));
+
+        vebmap_init(&map, uni_bits[c], VALUE_SIZE, flags[c]);
+        assert(vebmap_get(map, pool[0]) == NULL);
+        assert(vebmap_successor_entry(map, 0, &value) == vebtree_null);
+
+        /* random puts (overwriting values) and erases, the latter mostly hitting present keys */
+        for (round = 0; round < 8; round++) {
+            for (j = 0; j < 2 * num_keys; j++) {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                i = (state >> 33) % num_keys;
+
+                if (round % 4 == 3 || (state >> 20) % 3 == 0) {
+                    erased = vebmap_erase(map, pool[i]);
+                    assert(erased == present[i]);
+                    present[i] = false;
+                } else {
+                    make_value(values[i], pool[i], round);
+                    vebmap_put(map, pool[i], values[i]);
+                    present[i] = true;
+                }
+            }
+            assert_same_entries(map, pool, present, values, num_keys);
+        }
+
+        vebmap_free(map);
+    }
+
+    free(pool); free(present); free(values);
+}
+
+void should_store_pointers_as_values()
+{
+    VebMap* map; const char *text = "order", *other = "timer"; void* value; bool erased;
+    vebmap_init(&map, 24, sizeof(const char*), VEBTREE_DEFAULT_FLAGS);
+
+    vebmap_put(map, 100, &text);
+    vebmap_put(map, 7, &other);
+    assert(*(const char**)vebmap_get(map, 100) == text);
+    assert(vebmap_successor_entry(map, 7, &value) == 100 && *(const char**)value == text);
+    assert(vebmap_successor_entry(map, 0, &value) == 7 && *(const char**)value == other);
+    assert(vebmap_predecessor_entry(map, 100, &value) == 7 && *(const char**)value == other);
+
+    /* the values move along when the low is replaced */
+    erased = vebmap_erase(map, 7);
+    assert(erased);
+    erased = vebmap_erase(map, 7);
+    assert(!erased);
+    assert(vebmap_successor_entry(map, 0, &value) == 100 && *(const char**)value == text);
+
+    vebmap_free(map);
+}
+
+void should_count_duplicate_keys()
+{
+    size_t i, c, num_keys = 20000, num_actual; uint64_t state = 23; vebkey_t *keys, *expected, *actual;
+    VebMultiset* multiset; bool deleted;
+    uint8_t uni_bits[3] = { VEBTREE_LEAF_BITS, 12, 32 };
+    uint8_t flags[3] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK };
+
+    keys = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    expected = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    actual = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+
+    for (c = 0; c < 3; c++) {
+        vebmultiset_init(&multiset, uni_bits[c], flags[c]);
+        assert(vebmultiset_count(multiset, 1) == 0);
+        deleted = vebmultiset_delete_key(multiset, 1);
+        assert(!deleted);
+
+        /* heavy duplicates within a small key range */
+        for (i = 0; i < num_keys; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            keys[i] = (((state >> 33) % 1000) * 7) & (((vebkey_t)1 << uni_bits[c]) - 1);
+            vebmultiset_insert_key(multiset, keys[i]);
+            expected[i] = keys[i];
+        }
+        qsort(expected, num_keys, sizeof(vebkey_t), compare_keys);
+
+        assert(multiset->size == num_keys);
+        num_actual = vebmultiset_to_array(multiset, actual, num_keys);
+        assert(num_actual == num_keys);
+        for (i = 0; i < num_keys; i++)
+            assert(actual[i] == expected[i]);
+
+        /* delete the first half of the keys again, one occurrence at a time */
+        for (i = 0; i < num_keys / 2; i++) {
+            deleted = vebmultiset_delete_key(multiset, keys[i]);
+            assert(deleted);
+        }
+        for (i = 0; i < num_keys; i++)
+            expected[i] = keys[i];
+        qsort(expected + num_keys / 2, num_keys - num_keys / 2, sizeof(vebkey_t), compare_keys);
+
+        num_actual = vebmultiset_to_array(multiset, actual, num_keys);
+        assert(num_actual == num_keys - num_keys / 2);
+        for (i = num_keys / 2; i < num_keys; i++)
+            assert(actual[i - num_keys / 2] == expected[i]);
+        assert(vebmultiset_count(multiset, expected[num_keys - 1]) > 0);
+        assert(vebtree_get_max(multiset->map->tree) == expected[num_keys - 1]);
+        assert(vebtree_get_min(multiset->map->tree) == expected[num_keys / 2]);
+
+        for (i = num_keys / 2; i < num_keys; i++) {
+            deleted = vebmultiset_delete_key(multiset, keys[i]);
+            assert(deleted);
+        }
+        assert(multiset->size == 0 && vebtree_is_empty(multiset->map->tree));
+
+        vebmultiset_free(multiset);
+    }
+
+    free(keys); free(expected); free(actual);
+}
+
+int main(int argc, char** argv)
+{
+    should_put_get_and_erase_entries();
+    should_store_pointers_as_values();
+    should_count_duplicate_keys();
+    return 0;
+}
@@ -0,0 +1,475 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include "vebtrees.h"
+
+/* Micro benchmark suite, printing one CSV row per structure / universe / key distribution /
+ * operation / query pattern. Every operation is timed on its own with clock_gettime(), so the
+ * latency percentiles are per operation (the calibrated timer overhead is subtracted).
+ *
+ * usage: MicroBenchmark [--quick] [output.csv] */
+
+/* ====================================================
+ *          S T R U C T U R E S   U N D E R   T E S T
+ * ==================================================== */
+
+typedef struct _BENCH_STRUCTURE {
+    const char* name;
+    /**< The structure's name within the CSV output. */
+    bool (*supports)(uint8_t uni_bits, size_t num_keys);
+    /**< Whether the structure is benchmarked on the given universe / key count. */
+    void* (*create)(uint8_t uni_bits, size_t capacity);
+    void (*destroy)(void* set);
+    void (*insert)(void* set, vebkey_t key);
+    void (*remove)(void* set, vebkey_t key);
+    bool (*contains)(void* set, vebkey_t key);
+    vebkey_t (*successor)(void* set, vebkey_t key);
+    /**< The smallest key greater than the given key (vebtree_null if there is none). */
+    size_t (*bytes)(void* set);
+    /**< The bytes allocated by the structure. */
+} BenchStructure;
+
+/* fully allocated trees beyond 28 bits exceed the memory of small machines */
+#define MAX_FULL_TREE_BITS 28
+/* bitmap successors scan the whole gap to the next key, e.g. ~40 us per query
+   beyond the keys of a 24-bit universe, so larger bitmaps would take hours */
+#define MAX_BITMAP_BITS 24
+/* each update of a sorted array moves half of it on average */
+#define MAX_SORTED_ARRAY_UPDATES (1 << 14)
+
+bool veb_supports(uint8_t uni_bits, size_t num_keys) { (void)num_keys; return uni_bits <= MAX_FULL_TREE_BITS; }
+bool veb_lazy_supports(uint8_t uni_bits, size_t num_keys) { (void)uni_bits; (void)num_keys; return true; }
+void* veb_create(uint8_t uni_bits, size_t capacity)
+    { VebTree* tree; (void)capacity; vebtree_init(&tree, uni_bits, VEBTREE_DEFAULT_FLAGS); return tree; }
+void* veb_lazy_create(uint8_t uni_bits, size_t capacity)
+    { VebTree* tree; (void)capacity; vebtree_init(&tree, uni_bits, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK); return tree; }
+void* veb_sparse_create(uint8_t uni_bits, size_t capacity)
+    { VebTree* tree; (void)capacity; vebtree_init(&tree, uni_bits, VEBTREE_FLAG_SPARSE); return tree; }
+void veb_destroy(void* set) { vebtree_free((VebTree*)set); }
+void veb_insert(void* set, vebkey_t key) { vebtree_insert_key((VebTree*)set, key); }
+void veb_remove(void* set, vebkey_t key) { vebtree_delete_key((VebTree*)set, key); }
+bool veb_contains(void* set, vebkey_t key) { return vebtree_contains_key((VebTree*)set, key); }
+vebkey_t veb_successor(void* set, vebkey_t key) { return vebtree_successor((VebTree*)set, key); }
+size_t veb_bytes(void* set) { return vebtree_memory_usage((VebTree*)set); }
+
+typedef struct _SORTED_ARRAY {
+    vebkey_t* keys;
+    size_t size;
+    size_t capacity;
+} SortedArray;
+
+/* index of the first key greater or equal to the given key */
+size_t sorted_array_lower_bound(const SortedArray* array, vebkey_t key)
+{
+    size_t low = 0, high = array->size, mid;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (array->keys[mid] < key) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+bool sorted_array_supports(uint8_t uni_bits, size_t num_keys)
+    { (void)uni_bits; return num_keys <= MAX_SORTED_ARRAY_UPDATES; }
+
+void* sorted_array_create(uint8_t uni_bits, size_t capacity)
+{
+    SortedArray* array = (SortedArray*)malloc(sizeof(SortedArray)); (void)uni_bits;
+    assert(array != NULL && "sorted array allocation failed unexpectedly!");
+    array->keys = (vebkey_t*)malloc((capacity > 0 ? capacity : 1) * sizeof(vebkey_t));
+    assert(array->keys != NULL && "sorted array allocation failed unexpectedly!");
+    array->size = 0;
+    array->capacity = capacity;
+    return array;
+}
+
+void sorted_array_destroy(void* set) { free(((SortedArray*)set)->keys); free(set); }
+
+void sorted_array_insert(void* set, vebkey_t key)
+{
+    SortedArray* array = (SortedArray*)set; size_t pos = sorted_array_lower_bound(array, key);
+    if (pos < array->size && array->keys[pos] == key) return;
+    assert(array->size < array->capacity && "sorted array capacity exceeded!");
+    memmove(array->keys + pos + 1, array->keys + pos, (array->size - pos) * sizeof(vebkey_t));
+    array->keys[pos] = key;
+    array->size++;
+}
+
+void sorted_array_remove(void* set, vebkey_t key)
+{
+    SortedArray* array = (SortedArray*)set; size_t pos = sorted_array_lower_bound(array, key);
+    if (pos == array->size || array->keys[pos] != key) return;
+    memmove(array->keys + pos, array->keys + pos + 1, (array->size - pos - 1) * sizeof(vebkey_t));
+    array->size--;
+}
+
+bool sorted_array_contains(void* set, vebkey_t key)
+{
+    SortedArray* array = (SortedArray*)set; size_t pos = sorted_array_lower_bound(array, key);
+    return pos < array->size && array->keys[pos] == key;
+}
+
+vebkey_t sorted_array_successor(void* set, vebkey_t key)
+{
+    SortedArray* array = (SortedArray*)set; size_t pos;
+    if (key == vebtree_null) return vebtree_null;
+    pos = sorted_array_lower_bound(array, key + 1);
+    return pos < array->size ? array->keys[pos] : vebtree_null;
+}
+
+size_t sorted_array_bytes(void* set)
+    { return sizeof(SortedArray) + ((SortedArray*)set)->capacity * sizeof(vebkey_t); }
+
+typedef struct _BITMAP {
+    uint64_t* words;
+    size_t num_words;
+} Bitmap;
+
+bool bitmap_supports(uint8_t uni_bits, size_t num_keys) { (void)num_keys; return uni_bits <= MAX_BITMAP_BITS; }
+
+void* bitmap_create(uint8_t uni_bits, size_t capacity)
+{
+    Bitmap* bitmap = (Bitmap*)malloc(sizeof(Bitmap)); (void)capacity;
+    assert(bitmap != NULL && "bitmap allocation failed unexpectedly!");
+    bitmap->num_words = uni_bits > 6 ? (size_t)1 << (uni_bits - 6) : 1;
+    bitmap->words = (uint64_t*)calloc(bitmap->num_words, sizeof(uint64_t));
+    assert(bitmap->words != NULL && "bitmap allocation failed unexpectedly!");
+    return bitmap;
+}
+
+void bitmap_destroy(void* set) { free(((Bitmap*)set)->words); free(set); }
+void bitmap_insert(void* set, vebkey_t key) { ((Bitmap*)set)->words[key >> 6] |= 1ULL << (key & 63); }
+void bitmap_remove(void* set, vebkey_t key) { ((Bitmap*)set)->words[key >> 6] &= ~(1ULL << (key & 63)); }
+bool bitmap_contains(void* set, vebkey_t key) { return (((Bitmap*)set)->words[key >> 6] >> (key & 63)) & 1; }
+
+/* scan the words following the key's word until the next bit set */
+vebkey_t bitmap_successor(void* set, vebkey_t key)
+{
+    Bitmap* bitmap = (Bitmap*)set; size_t word; uint64_t bits;
+
+    if ((key & 63) < 63) {
+        bits = bitmap->words[key >> 6] & (~0ULL << ((key & 63) + 1));
+        if (bits) return (key & ~(vebkey_t)63) | trailing_zeros(bits);
+    }
+
+    for (word = (size_t)(key >> 6) + 1; word < bitmap->num_words; word++)
+        if (bitmap->words[word])
+            return ((vebkey_t)word << 6) | trailing_zeros(bitmap->words[word]);
+    return vebtree_null;
+}
+
+size_t bitmap_bytes(void* set) { return sizeof(Bitmap) + ((Bitmap*)set)->num_words * sizeof(uint64_t); }
+
+const BenchStructure structures[] = {
+    { "vebtree", veb_supports, veb_create, veb_destroy, veb_insert,
+      veb_remove, veb_contains, veb_successor, veb_bytes },
+    { "vebtree_lazy", veb_lazy_supports, veb_lazy_create, veb_destroy, veb_insert,
+      veb_remove, veb_contains, veb_successor, veb_bytes },
+    { "vebtree_sparse", veb_lazy_supports, veb_sparse_create, veb_destroy, veb_insert,
+      veb_remove, veb_contains, veb_successor, veb_bytes },
+    { "sorted_array", sorted_array_supports, sorted_array_create, sorted_array_destroy, sorted_array_insert,
+      sorted_array_remove, sorted_array_contains, sorted_array_successor, sorted_array_bytes },
+    { "bitmap", bitmap_supports, bitmap_create, bitmap_destroy, bitmap_insert,
+      bitmap_remove, bitmap_contains, bitmap_successor, bitmap_bytes },
+};
+#define NUM_STRUCTURES (sizeof(structures) / sizeof(BenchStructure))
+
+/* ====================================================
+ *         K E Y   D I S T R I B U T I O N S
+ * ==================================================== */
+
+#define DIST_DENSE 0
+#define DIST_SPARSE 1
+#define DIST_CLUSTERED 2
+#define DIST_SEQUENTIAL 3
+#define NUM_DISTRIBUTIONS 4
+#define CLUSTER_SIZE 64
+
+const char* distribution_names[NUM_DISTRIBUTIONS] = { "dense", "sparse", "clustered", "sequential" };
+
+uint64_t xorshift64(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+int compare_keys(const void* a, const void* b)
+{
+    vebkey_t key_a = *(const vebkey_t*)a, key_b = *(const vebkey_t*)b;
+    return key_a < key_b ? -1 : (key_a > key_b ? 1 : 0);
+}
+
+void shuffle_keys(vebkey_t keys[], size_t num_keys, uint64_t* state)
+{
+    size_t i, j; vebkey_t temp;
+
+    for (i = num_keys; i > 1; i--) {
+        j = xorshift64(state) % i;
+        temp = keys[i - 1]; keys[i - 1] = keys[j]; keys[j] = temp;
+    }
+}
+
+/* sort the keys and drop duplicates, returning the amount of distinct keys */
+size_t unique_keys(vebkey_t keys[], size_t num_keys)
+{
+    size_t i, num_unique = 1;
+
+    if (num_keys == 0) return 0;
+    qsort(keys, num_keys, sizeof(vebkey_t), compare_keys);
+    for (i = 1; i < num_keys; i++)
+        if (keys[i] != keys[num_unique - 1])
+            keys[num_unique++] = keys[i];
+    return num_unique;
+}
+
+/* generate up to num_keys distinct keys in insertion order, returning the actual amount:
+ * dense:      ~half of the keys within a window of 2 * num_keys at a random offset
+ * sparse:     uniformly distributed across the whole universe
+ * clustered:  runs of CLUSTER_SIZE consecutive keys at random offsets
+ * sequential: evenly spaced across the universe, inserted in ascending order */
+size_t generate_keys(vebkey_t keys[], size_t num_keys, uint8_t uni_bits, int distribution, uint64_t* state)
+{
+    size_t i, count = 0; vebkey_t universe = vebtree_universe_maxvalue(uni_bits), base, stride;
+
+    switch (distribution) {
+        case DIST_DENSE:
+            base = universe > 2 * num_keys ? xorshift64(state) % (universe - 2 * num_keys) : 0;
+            for (i = 0; i < 2 * num_keys && count < num_keys && base + i < universe; i++)
+                if (xorshift64(state) & 1)
+                    keys[count++] = base + i;
+            break;
+        case DIST_SPARSE:
+            for (count = 0; count < num_keys; count++)
+                keys[count] = xorshift64(state) & (universe - 1);
+            count = unique_keys(keys, count);
+            break;
+        case DIST_CLUSTERED:
+            while (count + CLUSTER_SIZE <= num_keys) {
+                base = xorshift64(state) % (universe - CLUSTER_SIZE + 1);
+                for (i = 0; i < CLUSTER_SIZE; i++)
+                    keys[count++] = base + i;
+            }
+            count = unique_keys(keys, count);
+            break;
+        default:
+            stride = universe / num_keys;
+            for (count = 0; count < num_keys; count++)
+                keys[count] = count * stride;
+            return count;
+    }
+
+    shuffle_keys(keys, count, state);
+    return count;
+}
+
+/* ====================================================
+ *                B E N C H M A R K
+ * ==================================================== */
+
+#define OP_INSERT 0
+#define OP_DELETE 1
+#define OP_CONTAINS 2
+#define OP_SUCCESSOR 3
+
+#define PATTERN_RANDOM 0
+#define PATTERN_PRESENT 1
+#define PATTERN_ASCENDING 2
+#define NUM_PATTERNS 3
+
+const char* pattern_names[NUM_PATTERNS] = { "random", "present", "ascending" };
+
+typedef struct _LATENCIES {
+    uint32_t* samples;
+    /**< The latency of each operation in nanoseconds. */
+    size_t num_samples;
+    /**< The amount of operations timed. */
+} Latencies;
+
+int64_t timer_overhead_ns = 0;
+
+int64_t elapsed_ns(struct timespec start, struct timespec end)
+{
+    return (int64_t)(end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+}
+
+int compare_samples(const void* a, const void* b)
+{
+    uint32_t sample_a = *(const uint32_t*)a, sample_b = *(const uint32_t*)b;
+    return sample_a < sample_b ? -1 : (sample_a > sample_b ? 1 : 0);
+}
+
+/* the median cost of two back-to-back clock_gettime() calls */
+int64_t calibrate_timer_overhead()
+{
+    size_t i, num_samples = 10001; uint32_t* samples; struct timespec start, end; int64_t overhead;
+
+    samples = (uint32_t*)malloc(num_samples * sizeof(uint32_t));
+    assert(samples != NULL && "samples allocation failed unexpectedly!");
+    for (i = 0; i < num_samples; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        samples[i] = (uint32_t)elapsed_ns(start, end);
+    }
+
+    qsort(samples, num_samples, sizeof(uint32_t), compare_samples);
+    overhead = samples[num_samples / 2];
+    free(samples);
+    return overhead;
+}
+
+void record_sample(Latencies* latencies, struct timespec start, struct timespec end)
+{
+    int64_t sample = elapsed_ns(start, end) - timer_overhead_ns;
+    latencies->samples[latencies->num_samples++] = sample > 0 ? (uint32_t)sample : 0;
+}
+
+/* time each operation on its own, returning a checksum to keep the lookups from being optimized out */
+vebkey_t run_operations(const BenchStructure* structure, void* set, int operation,
+                        const vebkey_t keys[], size_t num_keys, Latencies* latencies)
+{
+    size_t i; vebkey_t checksum = 0; struct timespec start, end;
+
+    for (i = 0; i < num_keys; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        switch (operation) {
+            case OP_INSERT: structure->insert(set, keys[i]); break;
+            case OP_DELETE: structure->remove(set, keys[i]); break;
+            case OP_CONTAINS: checksum += structure->contains(set, keys[i]); break;
+            default: checksum += structure->successor(set, keys[i]); break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        record_sample(latencies, start, end);
+    }
+
+    return checksum;
+}
+
+double percentile(const Latencies* latencies, double p)
+{
+    return latencies->samples[(size_t)(p * (latencies->num_samples - 1))];
+}
+
+void print_row(FILE* out, const char* structure, uint8_t uni_bits, int distribution, const char* operation,
+               const char* pattern, size_t num_keys, Latencies* latencies, double bytes_per_key)
+{
+    size_t i; double total = 0;
+
+    for (i = 0; i < latencies->num_samples; i++)
+        total += latencies->samples[i];
+    qsort(latencies->samples, latencies->num_samples, sizeof(uint32_t), compare_samples);
+
+    fprintf(out, "%s,%u,%s,%s,%s,%zu,%.1lf,%.0lf,%.0lf,%.0lf,%.0lf,", structure, uni_bits,
+            distribution_names[distribution], operation, pattern, num_keys, total / latencies->num_samples,
+            percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99),
+            percentile(latencies, 1.0));
+    if (bytes_per_key >= 0) fprintf(out, "%.2lf", bytes_per_key);
+    fprintf(out, "\n");
+    latencies->num_samples = 0;
+}
+
+void benchmark_structure(FILE* out, const BenchStructure* structure, uint8_t uni_bits, int distribution,
+                         const vebkey_t keys[], size_t num_keys, vebkey_t* queries[NUM_PATTERNS],
+                         Latencies* latencies, size_t init_runs)
+{
+    size_t r, p; void* set; double bytes_per_key; vebkey_t checksum = 0;
+    struct timespec start, end; const char* order;
+
+    /* init + free of an empty structure */
+    for (r = 0; r < init_runs; r++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        set = structure->create(uni_bits, num_keys);
+        structure->destroy(set);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        record_sample(latencies, start, end);
+    }
+    print_row(out, structure->name, uni_bits, distribution, "init_free", "-", num_keys, latencies, -1);
+
+    set = structure->create(uni_bits, num_keys);
+    order = distribution == DIST_SEQUENTIAL ? "ascending" : "random";
+
+    run_operations(structure, set, OP_INSERT, keys, num_keys, latencies);
+    bytes_per_key = (double)structure->bytes(set) / num_keys;
+    print_row(out, structure->name, uni_bits, distribution, "insert", order, num_keys, latencies, bytes_per_key);
+
+    for (p = 0; p < NUM_PATTERNS; p++) {
+        checksum += run_operations(structure, set, OP_CONTAINS, queries[p], num_keys, latencies);
+        print_row(out, structure->name, uni_bits, distribution, "contains",
+                  pattern_names[p], num_keys, latencies, bytes_per_key);
+    }
+
+    for (p = 0; p < NUM_PATTERNS; p++) {
+        checksum += run_operations(structure, set, OP_SUCCESSOR, queries[p], num_keys, latencies);
+        print_row(out, structure->name, uni_bits, distribution, "successor",
+                  pattern_names[p], num_keys, latencies, bytes_per_key);
+    }
+
+    /* delete the keys in insertion order, so the structure ends up empty */
+    run_operations(structure, set, OP_DELETE, keys, num_keys, latencies);
+    print_row(out, structure->name, uni_bits, distribution, "delete", order, num_keys, latencies, bytes_per_key);
+
+    structure->destroy(set);
+    assert(checksum != 0);
+}
+
+int main(int argc, char** argv)
+{
+    size_t i, s, p, num_keys, max_keys, init_runs; int a, d; uint8_t uni_bits, max_bits;
+    uint64_t state = 42; vebkey_t *keys, *queries[NUM_PATTERNS]; Latencies latencies;
+    bool quick = false; FILE* out = stdout;
+
+    for (a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--quick") == 0) quick = true;
+        else out = fopen(argv[a], "w");
+        assert(out != NULL && "output file couldn't be opened!");
+    }
+
+    /* the quick mode keeps the runtime low enough for running it along with the tests */
+    max_bits = quick ? 24 : 32;
+    max_keys = quick ? (size_t)1 << 14 : (size_t)1 << 20;
+    init_runs = 10;
+
+    keys = (vebkey_t*)malloc(max_keys * sizeof(vebkey_t));
+    for (p = 0; p < NUM_PATTERNS; p++)
+        queries[p] = (vebkey_t*)malloc(max_keys * sizeof(vebkey_t));
+    latencies.samples = (uint32_t*)malloc((max_keys > init_runs ? max_keys : init_runs) * sizeof(uint32_t));
+    latencies.num_samples = 0;
+    assert(keys != NULL && latencies.samples != NULL && "keys allocation failed unexpectedly!");
+
+    timer_overhead_ns = calibrate_timer_overhead();
+    fprintf(out, "structure,universe_bits,distribution,operation,pattern,num_keys,"
+                 "ns_per_op,p50_ns,p90_ns,p99_ns,max_ns,bytes_per_key\n");
+
+    for (uni_bits = 12; uni_bits <= max_bits; uni_bits += 4) {
+        for (d = 0; d < NUM_DISTRIBUTIONS; d++) {
+            num_keys = vebtree_universe_maxvalue(uni_bits) / 4;
+            num_keys = generate_keys(keys, num_keys < max_keys ? num_keys : max_keys, uni_bits, d, &state);
+
+            /* misses and hits across the universe, present keys only, and an ascending scan */
+            for (i = 0; i < num_keys; i++) {
+                queries[PATTERN_RANDOM][i] = xorshift64(&state) & (vebtree_universe_maxvalue(uni_bits) - 1);
+                queries[PATTERN_PRESENT][i] = keys[i];
+                queries[PATTERN_ASCENDING][i] = queries[PATTERN_RANDOM][i];
+            }
+            shuffle_keys(queries[PATTERN_PRESENT], num_keys, &state);
+            qsort(queries[PATTERN_ASCENDING], num_keys, sizeof(vebkey_t), compare_keys);
+
+            for (s = 0; s < NUM_STRUCTURES; s++)
+                if (structures[s].supports(uni_bits, num_keys))
+                    benchmark_structure(out, &structures[s], uni_bits, d, keys,
+                                        num_keys, queries, &latencies, init_runs);
+            fflush(out);
+        }
+    }
+
+    if (out != stdout) fclose(out);
+    free(keys); free(latencies.samples);
+    for (p = 0; p < NUM_PATTERNS; p++) free(queries[p]);
+    return 0;
+}
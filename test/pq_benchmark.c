@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include "vebtrees_pq.h"
+
+/* ====================================================
+ *            B I N A R Y   M I N - H E A P
+ * ==================================================== */
+
+typedef struct _BINARY_HEAP {
+    vebkey_t* keys;
+    /**< The heap-ordered keys, the children of i are at 2i+1 and 2i+2. */
+    size_t size;
+    /**< The number of queued keys. */
+} BinaryHeap;
+
+void heap_push(BinaryHeap* heap, vebkey_t key)
+{
+    size_t pos = heap->size++, parent;
+
+    for (; pos > 0 && heap->keys[parent = (pos - 1) / 2] > key; pos = parent)
+        heap->keys[pos] = heap->keys[parent];
+    heap->keys[pos] = key;
+}
+
+vebkey_t heap_pop_min(BinaryHeap* heap)
+{
+    size_t pos = 0, child; vebkey_t min = heap->keys[0], last = heap->keys[--heap->size];
+
+    while ((child = 2 * pos + 1) < heap->size) {
+        if (child + 1 < heap->size && heap->keys[child + 1] < heap->keys[child]) child++;
+        if (heap->keys[child] >= last) break;
+        heap->keys[pos] = heap->keys[child];
+        pos = child;
+    }
+
+    heap->keys[pos] = last;
+    return min;
+}
+
+/* ====================================================
+ *                B E N C H M A R K
+ * ==================================================== */
+
+#define HOLD_UNIVERSE_BITS 40
+#define HOLD_MAX_DELAY (1 << 24)
+#define DRAIN_UNIVERSE_BITS 24
+#define DRAIN_BATCH_SIZE 4096
+
+uint64_t xorshift64(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+double elapsed_seconds(struct timespec start, struct timespec end)
+{
+    return (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/* scheduler-like hold model: pop the earliest timer, re-arm it with a random delay */
+double benchmark_hold_in_ns(bool use_heap, size_t depth, size_t num_ops)
+{
+    size_t i; uint64_t state = 42; vebkey_t key, checksum = 0;
+    VebPQ* queue = NULL; BinaryHeap heap; struct timespec start, end;
+
+    heap.keys = (vebkey_t*)malloc((depth + 1) * sizeof(vebkey_t));
+    assert(heap.keys != NULL && "heap allocation failed unexpectedly!");
+    heap.size = 0;
+    vebpq_init(&queue, HOLD_UNIVERSE_BITS, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK);
+
+    for (i = 0; i < depth; i++) {
+        key = xorshift64(&state) % HOLD_MAX_DELAY;
+        if (use_heap) heap_push(&heap, key);
+        else while (!vebpq_push(queue, key)) key++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < num_ops; i++) {
+        key = use_heap ? heap_pop_min(&heap) : vebpq_pop_min(queue);
+        checksum += key;
+        key += 1 + xorshift64(&state) % HOLD_MAX_DELAY;
+        if (use_heap) heap_push(&heap, key);
+        else while (!vebpq_push(queue, key)) key++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    assert(checksum != 0);
+    free(heap.keys);
+    vebpq_free(queue);
+    return elapsed_seconds(start, end) / num_ops * 1e9;
+}
+
+/* drain a queue of random keys in deadline steps, either batched or one key at a time */
+double benchmark_drain_in_ms(int mode, size_t num_keys, vebkey_t deadline_step)
+{
+    size_t i, num_popped = 0; uint64_t state = 42; vebkey_t key, deadline, *output;
+    VebPQ* queue = NULL; BinaryHeap heap; struct timespec start, end;
+
+    output = (vebkey_t*)malloc(DRAIN_BATCH_SIZE * sizeof(vebkey_t));
+    heap.keys = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    assert(output != NULL && heap.keys != NULL && "buffer allocation failed unexpectedly!");
+    heap.size = 0;
+    vebpq_init(&queue, DRAIN_UNIVERSE_BITS, VEBTREE_DEFAULT_FLAGS);
+
+    for (i = 0; i < num_keys; i++) {
+        key = xorshift64(&state) & (((vebkey_t)1 << DRAIN_UNIVERSE_BITS) - 1);
+        if (mode == 2) heap_push(&heap, key);
+        else vebpq_push(queue, key);
+    }
+    if (mode != 2) num_keys = (size_t)queue->size;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (deadline = deadline_step; num_popped < num_keys; deadline += deadline_step) {
+        if (mode == 0) {
+            while ((i = vebpq_pop_until(queue, deadline, output, DRAIN_BATCH_SIZE)) > 0)
+                num_popped += i;
+        } else if (mode == 1) {
+            while (vebpq_peek_min(queue) < deadline) {
+                vebpq_pop_min(queue);
+                num_popped++;
+            }
+        } else {
+            while (heap.size > 0 && heap.keys[0] < deadline) {
+                heap_pop_min(&heap);
+                num_popped++;
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    assert(num_popped == num_keys);
+    free(output); free(heap.keys);
+    vebpq_free(queue);
+    return elapsed_seconds(start, end) * 1000;
+}
+
+int main(int argc, char** argv)
+{
+    size_t depth, num_ops = 1000000, num_keys = 1000000;
+
+    for (depth = 1000; depth <= 1000000; depth *= 10) {
+        printf("Veb priority queue hold (depth %zu) took %lf nanoseconds per pop + push\n",
+               depth, benchmark_hold_in_ns(false, depth, num_ops));
+        printf("Binary heap hold (depth %zu) took %lf nanoseconds per pop + push\n",
+               depth, benchmark_hold_in_ns(true, depth, num_ops));
+    }
+
+    printf("Veb priority queue batched drain (1M keys, u=24) took %lf milliseconds\n",
+           benchmark_drain_in_ms(0, num_keys, 1 << 12));
+    printf("Veb priority queue pop-min drain (1M keys, u=24) took %lf milliseconds\n",
+           benchmark_drain_in_ms(1, num_keys, 1 << 12));
+    printf("Binary heap drain (1M keys, u=24) took %lf milliseconds\n",
+           benchmark_drain_in_ms(2, num_keys, 1 << 12));
+
+    return 0;
+}
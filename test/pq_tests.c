@@ -0,0 +1,178 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "vebtrees_pq.h"
+
+#define NUM_CONFIGS 6
+#define NUM_OPS 30000
+
+const uint8_t uni_bits[NUM_CONFIGS] = { VEBTREE_LEAF_BITS, 16, 20, 20, 32, 64 };
+const uint8_t flags[NUM_CONFIGS] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS,
+    VEBTREE_FLAG_COUNTS, VEBTREE_FLAG_ARENA | VEBTREE_FLAG_COUNTS,
+    VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_COUNTS };
+
+/* random keys of the config's universe, clustered for the 64-bit universe */
+vebkey_t random_key(uint64_t* state, size_t config)
+{
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return uni_bits[config] == 64 ? 0x0123400000000000ULL | (*state >> 44)
+        : (*state >> 11) & (((vebkey_t)1 << uni_bits[config]) - 1);
+}
+
+/* the queue needs to hold exactly the keys of the reference tree */
+void assert_same_keys(VebPQ* queue, VebTree* expected)
+{
+    vebkey_t key = vebtree_get_min(expected);
+    VebCursor cursor; uint64_t size = 0;
+
+    assert(vebpq_peek_min(queue) == key);
+    assert(vebtree_get_max(queue->tree) == vebtree_get_max(expected));
+
+    /* pops drop the locals they drain from the full locals, so absent keys are found behind them */
+    vebtree_cursor_seek(&cursor, queue->tree, 0);
+    for (; key != vebtree_null; key = vebtree_successor(expected, key), size++) {
+        assert(!vebtree_cursor_end(&cursor) && cursor.key == key);
+        assert(vebtree_next_absent(queue->tree, key) == vebtree_next_absent(expected, key));
+        vebtree_cursor_next(&cursor);
+    }
+    assert(vebtree_cursor_end(&cursor));
+    assert(queue->size == size);
+
+    if (vebtree_is_leaf(queue->tree) || vebtree_is_counting(queue->tree))
+        assert(vebtree_size(queue->tree) == size);
+}
+
+void should_pop_keys_in_order()
+{
+    size_t c, i; uint64_t state = 5; vebkey_t key, popped; bool pushed; VebPQ* queue; VebTree* expected;
+
+    for (c = 0; c < NUM_CONFIGS; c++) {
+        vebpq_init(&queue, uni_bits[c], flags[c]);
+        vebtree_init(&expected, uni_bits[c], uni_bits[c] > 20 ? VEBTREE_FLAG_LAZY : VEBTREE_DEFAULT_FLAGS);
+        popped = vebpq_pop_min(queue);
+        assert(popped == vebtree_null && vebpq_peek_min(queue) == vebtree_null);
+
+        /* pushes outweigh the pops, so the queue grows while being drained */
+        for (i = 0; i < NUM_OPS; i++) {
+            key = random_key(&state, c);
+            if (key % 5 < 3) {
+                pushed = vebpq_push(queue, key);
+                assert(pushed == !vebtree_contains_key(expected, key));
+                vebtree_insert_key(expected, key);
+            } else {
+                key = vebtree_get_min(expected);
+                popped = vebpq_pop_min(queue);
+                assert(popped == key);
+                if (key != vebtree_null) vebtree_delete_key(expected, key);
+            }
+        }
+        assert_same_keys(queue, expected);
+
+        /* drain the queue completely */
+        while ((key = vebtree_get_min(expected)) != vebtree_null) {
+            popped = vebpq_pop_min(queue);
+            assert(popped == key);
+            vebtree_delete_key(expected, key);
+        }
+        assert_same_keys(queue, expected);
+        assert(vebtree_is_empty(queue->tree));
+
+        vebpq_free(queue);
+        vebtree_free(expected);
+    }
+}
+
+void should_pop_keys_below_deadline()
+{
+    size_t c, i, r, num_popped, capacity; uint64_t state = 11; vebkey_t key, deadline, *output;
+    VebPQ* queue; VebTree* expected;
+    output = (vebkey_t*)malloc(NUM_OPS * sizeof(vebkey_t));
+
+    for (c = 0; c < NUM_CONFIGS; c++) {
+        vebpq_init(&queue, uni_bits[c], flags[c]);
+        vebtree_init(&expected, uni_bits[c], uni_bits[c] > 20 ? VEBTREE_FLAG_LAZY : VEBTREE_DEFAULT_FLAGS);
+        num_popped = vebpq_pop_until(queue, vebtree_null, output, NUM_OPS);
+        assert(num_popped == 0);
+
+        for (r = 0; r < 40; r++) {
+            for (i = 0; i < NUM_OPS / 40; i++) {
+                key = random_key(&state, c);
+                vebpq_push(queue, key);
+                vebtree_insert_key(expected, key);
+            }
+
+            /* dense runs fill up whole locals, which the pops drain again */
+            key = r % 8 == 0 ? random_key(&state, c) : vebtree_null;
+            for (i = 0; key != vebtree_null && i < 600 && key + i <= vebtree_universe_maxkey(uni_bits[c]); i++) {
+                vebpq_push(queue, key + i);
+                vebtree_insert_key(expected, key + i);
+            }
+
+            /* deadlines between the keys and capacities cutting off in the middle of locals */
+            deadline = random_key(&state, c);
+            capacity = r % 3 == 0 ? (size_t)(state >> 50) % 300 : NUM_OPS;
+            num_popped = vebpq_pop_until(queue, deadline, output, capacity);
+
+            key = vebtree_get_min(expected);
+            for (i = 0; i < num_popped; i++) {
+                assert(output[i] == key && key < deadline);
+                vebtree_delete_key(expected, key);
+                key = vebtree_get_min(expected);
+            }
+            assert(num_popped == capacity || key == vebtree_null || key >= deadline);
+            assert_same_keys(queue, expected);
+        }
+
+        /* popping below the largest possible deadline empties the queue */
+        num_popped = vebpq_pop_until(queue, vebtree_null, output, NUM_OPS);
+        for (i = 0, key = vebtree_get_min(expected); i < num_popped; i++, key = vebtree_successor(expected, key))
+            assert(output[i] == key);
+        assert(key == vebtree_null);
+        assert(vebtree_is_empty(queue->tree) && queue->size == 0);
+
+        vebpq_free(queue);
+        vebtree_free(expected);
+    }
+
+    free(output);
+}
+
+void should_decrease_keys()
+{
+    size_t c, i; uint64_t state = 3; vebkey_t key, new_key; VebPQ* queue; VebTree* expected;
+
+    for (c = 1; c < NUM_CONFIGS; c++) {
+        vebpq_init(&queue, uni_bits[c], flags[c]);
+        vebtree_init(&expected, uni_bits[c], uni_bits[c] > 20 ? VEBTREE_FLAG_LAZY : VEBTREE_DEFAULT_FLAGS);
+
+        for (i = 0; i < 2000; i++) {
+            key = random_key(&state, c);
+            vebpq_push(queue, key);
+            vebtree_insert_key(expected, key);
+        }
+
+        /* move random keys down to a free smaller key */
+        for (i = 0; i < 2000; i++) {
+            key = vebtree_successor(expected, random_key(&state, c));
+            if (key == vebtree_null || key == 0) continue;
+            new_key = key - 1 - random_key(&state, c) % key;
+            if (vebtree_contains_key(expected, new_key)) continue;
+
+            vebpq_decrease_key(queue, key, new_key);
+            vebtree_delete_key(expected, key);
+            vebtree_insert_key(expected, new_key);
+        }
+        assert_same_keys(queue, expected);
+
+        vebpq_free(queue);
+        vebtree_free(expected);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    should_pop_keys_in_order();
+    should_pop_keys_below_deadline();
+    should_decrease_keys();
+    return 0;
+}
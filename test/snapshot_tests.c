@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "vebtrees_mmap.h"
+
+#define SNAPSHOT_PATH "vebtree_snapshot_test.bin"
+
+void assert_same_keys(VebTree* tree, VebTree* mapped, vebkey_t max_key, vebkey_t step)
+{
+    vebkey_t key, mapped_key, queries[64], successors[64]; size_t i; VebCursor cursor, mapped_cursor;
+
+    assert(vebtree_get_min(tree) == vebtree_get_min(mapped));
+    assert(vebtree_get_max(tree) == vebtree_get_max(mapped));
+
+    for (key = 0; key <= max_key - step; key += step) {
+        assert(vebtree_contains_key(tree, key) == vebtree_contains_key(mapped, key));
+        assert(vebtree_successor(tree, key) == vebtree_successor(mapped, key));
+        assert(vebtree_predecessor(tree, key) == vebtree_predecessor(mapped, key));
+    }
+
+    /* batched lookups resolve the mapped subtrees the same way */
+    for (key = 0, i = 0; i < 64; key += step, i++) queries[i] = key & max_key;
+    vebtree_successors(mapped, queries, 64, successors);
+    for (i = 0; i < 64; i++)
+        assert(successors[i] == vebtree_successor(tree, queries[i]));
+
+    key = vebtree_cursor_seek(&cursor, tree, 0);
+    mapped_key = vebtree_cursor_seek(&mapped_cursor, mapped, 0);
+    assert(mapped_key == key);
+    while (key != vebtree_null) {
+        key = vebtree_cursor_next(&cursor);
+        mapped_key = vebtree_cursor_next(&mapped_cursor);
+        assert(mapped_key == key);
+    }
+}
+
+void should_save_and_map_trees()
+{
+    size_t i, t; uint64_t state = 99; VebTree *tree, *mapped; bool saved;
+    uint8_t uni_bits[4] = { VEBTREE_LEAF_BITS, 16, 20, 32 };
+    uint8_t flags[4] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_ARENA, VEBTREE_FLAG_LAZY };
+
+    for (t = 0; t < 4; t++) {
+        vebtree_init(&tree, uni_bits[t], flags[t]);
+
+        for (i = 0; i < 5000; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            vebtree_insert_key(tree, (state >> 11) & (((vebkey_t)1 << uni_bits[t]) - 1));
+        }
+
+        saved = vebtree_save(tree, SNAPSHOT_PATH);
+        assert(saved);
+        mapped = vebtree_open_mmap(SNAPSHOT_PATH);
+        assert(mapped != NULL && vebtree_is_mapped(mapped));
+
+        assert_same_keys(tree, mapped, ((vebkey_t)1 << uni_bits[t]) - 1,
+            uni_bits[t] > 20 ? 0xFFFF3 : 1);
+
+        vebtree_close_mmap(mapped);
+        vebtree_free(tree);
+    }
+
+    remove(SNAPSHOT_PATH);
+}
+
+void should_save_empty_tree()
+{
+    VebTree *tree, *mapped; bool saved;
+    vebtree_init(&tree, 32, VEBTREE_FLAG_LAZY);
+
+    saved = vebtree_save(tree, SNAPSHOT_PATH);
+    assert(saved);
+    mapped = vebtree_open_mmap(SNAPSHOT_PATH);
+    assert(mapped != NULL);
+    assert(vebtree_is_empty(mapped));
+    assert(vebtree_successor(mapped, 0) == vebtree_null);
+
+    vebtree_close_mmap(mapped);
+    vebtree_free(tree);
+    remove(SNAPSHOT_PATH);
+}
+
+void should_reject_invalid_snapshots()
+{
+    FILE* file; VebTree* mapped;
+
+    mapped = vebtree_open_mmap("does_not_exist.bin");
+    assert(mapped == NULL);
+
+    file = fopen(SNAPSHOT_PATH, "wb");
+    fprintf(file, "definitely not a van Emde Boas tree snapshot file");
+    fclose(file);
+    mapped = vebtree_open_mmap(SNAPSHOT_PATH);
+    assert(mapped == NULL);
+
+    remove(SNAPSHOT_PATH);
+}
+
+int main(int argc, char** argv)
+{
+    should_save_and_map_trees();
+    should_save_empty_tree();
+    should_reject_invalid_snapshots();
+    return 0;
+}
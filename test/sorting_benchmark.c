@@ -4,18 +4,19 @@
 #include <assert.h>
 #include <time.h>
 #include <string.h>
-#include "vebtrees.h"
+#include "vebtrees_map.h"
 
 /* ====================================================
  *         V A N   E M D E   B O A S   S O R T
  * ==================================================== */
 
-void sort_veb_succ(const uint64_t keys[], size_t num_keys, uint64_t output[])
+void sort_veb_succ_with_flags(
+    const uint64_t keys[], size_t num_keys, uint64_t output[], uint8_t flags)
 {
     size_t i; VebTree* tree; uint8_t uni_bits;
 
     uni_bits = vebtree_required_universe_bits(num_keys);
-    vebtree_init(&tree, uni_bits, VEBTREE_DEFAULT_FLAGS);
+    vebtree_init(&tree, uni_bits, flags);
 
     for (i = 0; i < num_keys; i++)
         vebtree_insert_key(tree, keys[i]);
@@ -27,6 +28,79 @@ void sort_veb_succ(const uint64_t keys[], size_t num_keys, uint64_t output[])
     vebtree_free(tree);
 }
 
+void sort_veb_succ(const uint64_t keys[], size_t num_keys, uint64_t output[])
+{
+    sort_veb_succ_with_flags(keys, num_keys, output, VEBTREE_DEFAULT_FLAGS);
+}
+
+void sort_veb_succ_arena(const uint64_t keys[], size_t num_keys, uint64_t output[])
+{
+    sort_veb_succ_with_flags(keys, num_keys, output, VEBTREE_FLAG_ARENA);
+}
+
+void sort_veb_bulk_succ(const uint64_t keys[], size_t num_keys, uint64_t output[])
+{
+    size_t i; VebTree* tree; uint8_t uni_bits;
+
+    uni_bits = vebtree_required_universe_bits(num_keys);
+    vebtree_init(&tree, uni_bits, VEBTREE_DEFAULT_FLAGS);
+    vebtree_insert_keys(tree, keys, num_keys);
+
+    output[0] = vebtree_get_min(tree);
+    for (i = 1; i < num_keys; i++)
+        output[i] = vebtree_successor(tree, output[i-1]);
+
+    vebtree_free(tree);
+}
+
+void sort_veb_cursor(const uint64_t keys[], size_t num_keys, uint64_t output[])
+{
+    size_t i; VebTree* tree; VebCursor cursor; uint8_t uni_bits;
+
+    uni_bits = vebtree_required_universe_bits(num_keys);
+    vebtree_init(&tree, uni_bits, VEBTREE_DEFAULT_FLAGS);
+
+    for (i = 0; i < num_keys; i++)
+        vebtree_insert_key(tree, keys[i]);
+
+    output[0] = vebtree_cursor_seek(&cursor, tree, 0);
+    for (i = 1; i < num_keys; i++)
+        output[i] = vebtree_cursor_next(&cursor);
+
+    vebtree_free(tree);
+}
+
+void sort_veb_bulk_export(const uint64_t keys[], size_t num_keys, uint64_t output[])
+{
+    VebTree* tree; uint8_t uni_bits;
+
+    uni_bits = vebtree_required_universe_bits(num_keys);
+    vebtree_init(&tree, uni_bits, VEBTREE_DEFAULT_FLAGS);
+    vebtree_insert_keys(tree, keys, num_keys);
+    vebtree_to_array(tree, output, num_keys);
+    vebtree_free(tree);
+}
+
+void sort_veb_library(const uint64_t keys[], size_t num_keys, uint64_t output[])
+{
+    vebtree_sort(keys, num_keys, output, VEBTREE_SORT_DEFAULT);
+}
+
+void sort_veb_multiset(const uint64_t keys[], size_t num_keys, uint64_t output[])
+{
+    size_t i; VebMultiset* multiset; vebkey_t max_key = 1;
+
+    for (i = 0; i < num_keys; i++)
+        max_key = keys[i] > max_key ? keys[i] : max_key;
+
+    vebmultiset_init(&multiset, vebtree_required_universe_bits(max_key), VEBTREE_DEFAULT_FLAGS);
+    for (i = 0; i < num_keys; i++)
+        vebmultiset_insert_key(multiset, keys[i]);
+
+    vebmultiset_to_array(multiset, output, num_keys);
+    vebmultiset_free(multiset);
+}
+
 /* ====================================================
  *                Q U I C K   S O R T
  * ==================================================== */
@@ -104,15 +178,318 @@ double benchmark_sort_algo_in_ms(
     return elapsed / test_runs * 1000;
 }
 
+uint64_t lcg_next(uint64_t* state)
+{
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state;
+}
+
+/* dense keys with ~4 duplicates per key on average, e.g. event timestamps */
+double benchmark_sort_duplicates_in_ms(
+    void (*sort_func)(const uint64_t*, size_t, uint64_t*),
+    size_t num_keys, size_t test_runs)
+{
+    size_t i, t; uint64_t *keys, *sorted_keys, state;
+    clock_t start, end; double elapsed = 0;
+
+    keys = malloc(sizeof(vebkey_t) * num_keys);
+    sorted_keys = malloc(sizeof(vebkey_t) * num_keys);
+    assert(keys != NULL && sorted_keys != NULL && "keys array allocation failed unexpectedly!");
+
+    for (t = 0; t < test_runs; t++)
+    {
+        for (i = 0, state = t; i < num_keys; i++)
+            keys[i] = (lcg_next(&state) >> 16) % (num_keys / 4);
+
+        start = clock();
+        (*sort_func)(keys, num_keys, sorted_keys);
+        end = clock();
+
+        for (i = 0; i < num_keys-1; i++)
+            assert(sorted_keys[i] <= sorted_keys[i+1]);
+
+        elapsed += ((double)end - start) / CLOCKS_PER_SEC;
+    }
+
+    free(keys); free(sorted_keys);
+    return elapsed / test_runs * 1000;
+}
+
+/* 64-bit IDs with duplicates, either clustered within a range of 16x the key count
+   far off zero (e.g. auto-increment IDs) or spread across the whole 64-bit range */
+double benchmark_sort_ids_in_ms(
+    void (*sort_func)(const uint64_t*, size_t, uint64_t*),
+    size_t num_keys, bool clustered, size_t test_runs)
+{
+    size_t i, t; uint64_t *keys, *sorted_keys, state;
+    clock_t start, end; double elapsed = 0;
+
+    keys = malloc(sizeof(vebkey_t) * num_keys);
+    sorted_keys = malloc(sizeof(vebkey_t) * num_keys);
+    assert(keys != NULL && sorted_keys != NULL && "keys array allocation failed unexpectedly!");
+
+    for (t = 0; t < test_runs; t++)
+    {
+        for (i = 0, state = t; i < num_keys; i++)
+            keys[i] = clustered ? 0x123456789ABC + lcg_next(&state) % (16 * num_keys) : lcg_next(&state);
+
+        start = clock();
+        (*sort_func)(keys, num_keys, sorted_keys);
+        end = clock();
+
+        for (i = 0; i < num_keys-1; i++)
+            assert(sorted_keys[i] <= sorted_keys[i+1]);
+
+        elapsed += ((double)end - start) / CLOCKS_PER_SEC;
+    }
+
+    free(keys); free(sorted_keys);
+    return elapsed / test_runs * 1000;
+}
+
+double benchmark_init_free_in_ms(uint8_t uni_bits, uint8_t flags, size_t test_runs)
+{
+    size_t t; VebTree* tree;
+    clock_t start, end; double elapsed = 0;
+
+    for (t = 0; t < test_runs; t++)
+    {
+        start = clock();
+        vebtree_init(&tree, uni_bits, flags);
+        vebtree_free(tree);
+        end = clock();
+        elapsed += ((double)end - start) / CLOCKS_PER_SEC;
+    }
+
+    return elapsed / test_runs * 1000;
+}
+
+/* random lookups on a tree exceeding the caches, either one by one or in batches */
+double benchmark_lookups_in_ns(uint8_t uni_bits, bool successors, bool batched)
+{
+    size_t i, num_keys = (size_t)1 << 20, num_queries = (size_t)1 << 22, batch_size = 256;
+    uint64_t state = 42; VebTree* tree; vebkey_t *queries, *output, checksum = 0; bool* contained;
+    clock_t start, end;
+
+    queries = malloc(sizeof(vebkey_t) * num_queries);
+    output = malloc(sizeof(vebkey_t) * num_queries);
+    contained = malloc(sizeof(bool) * num_queries);
+    assert(queries != NULL && output != NULL && contained != NULL && "query arrays allocation failed unexpectedly!");
+
+    vebtree_init(&tree, uni_bits, VEBTREE_DEFAULT_FLAGS);
+    for (i = 0; i < num_keys; i++)
+        vebtree_insert_key(tree, lcg_next(&state) >> (64 - uni_bits));
+    for (i = 0; i < num_queries; i++)
+        queries[i] = lcg_next(&state) >> (64 - uni_bits);
+
+    start = clock();
+    if (batched && successors)
+        for (i = 0; i < num_queries; i += batch_size)
+            vebtree_successors(tree, queries + i, batch_size, output + i);
+    else if (batched)
+        for (i = 0; i < num_queries; i += batch_size)
+            vebtree_contains_keys(tree, queries + i, batch_size, contained + i);
+    else if (successors)
+        for (i = 0; i < num_queries; i++)
+            output[i] = vebtree_successor(tree, queries[i]);
+    else
+        for (i = 0; i < num_queries; i++)
+            contained[i] = vebtree_contains_key(tree, queries[i]);
+    end = clock();
+
+    /* keep the queries from being optimized out */
+    for (i = 0; i < num_queries; i++)
+        checksum += successors ? output[i] : contained[i];
+    assert(checksum != 0);
+
+    vebtree_free(tree);
+    free(queries); free(output); free(contained);
+    return ((double)end - start) / CLOCKS_PER_SEC / num_queries * 1e9;
+}
+
+/* bytes of a fully allocated tree, laid out like an arena tree */
+double fully_allocated_size_in_mib(uint8_t uni_bits, uint8_t flags)
+{
+    VebTree root;
+    _vebtree_init_node(&root, uni_bits, flags, true);
+    return (double)(sizeof(VebTree) + _vebtree_arena_size(uni_bits, root.lower_bits, flags)) / (1 << 20);
+}
+
+/* bytes of the same tree if the locals of leaf parents were full 32 byte leaf nodes */
+size_t node_locals_arena_size(uint8_t uni_bits, uint8_t flags, bool is_root)
+{
+    VebTree node; size_t num_locals, counts_bytes, full_bytes;
+    _vebtree_init_node(&node, uni_bits, flags, is_root);
+    if (vebtree_is_leaf(&node))
+        return 0;
+
+    num_locals = vebtree_universe_maxvalue(node.upper_bits);
+    counts_bytes = flags & VEBTREE_FLAG_COUNTS ? sizeof(uint64_t) : 0;
+    full_bytes = vebtree_tracks_full(flags)
+        ? sizeof(VebTree) + node_locals_arena_size(node.upper_bits, flags, false) : 0;
+    return sizeof(VebTree) + num_locals * (sizeof(VebTree) + counts_bytes) + full_bytes
+        + node_locals_arena_size(node.upper_bits, vebtree_global_flags(flags), false)
+        + num_locals * node_locals_arena_size(node.lower_bits, flags, false);
+}
+
+/* intersect two random trees, either per key (successor scan + probing) or by set operation */
+double benchmark_intersect_in_ms(uint8_t uni_bits, size_t num_keys, bool per_key, size_t test_runs)
+{
+    size_t i, t; uint64_t state = 42; vebkey_t key; VebTree *tree_a, *tree_b, *result;
+    clock_t start, end; double elapsed = 0;
+
+    vebtree_init(&tree_a, uni_bits, VEBTREE_DEFAULT_FLAGS);
+    vebtree_init(&tree_b, uni_bits, VEBTREE_DEFAULT_FLAGS);
+    for (i = 0; i < num_keys; i++) {
+        vebtree_insert_key(tree_a, lcg_next(&state) >> (64 - uni_bits));
+        vebtree_insert_key(tree_b, lcg_next(&state) >> (64 - uni_bits));
+    }
+
+    for (t = 0; t < test_runs; t++)
+    {
+        start = clock();
+        if (per_key) {
+            vebtree_init(&result, uni_bits, VEBTREE_DEFAULT_FLAGS);
+            for (key = vebtree_get_min(tree_a); key != vebtree_null; key = vebtree_successor(tree_a, key))
+                if (vebtree_contains_key(tree_b, key))
+                    vebtree_insert_key(result, key);
+        } else {
+            vebtree_init_intersection(&result, tree_a, tree_b);
+        }
+        end = clock();
+        elapsed += ((double)end - start) / CLOCKS_PER_SEC;
+        vebtree_free(result);
+    }
+
+    vebtree_free(tree_a); vebtree_free(tree_b);
+    return elapsed / test_runs * 1000;
+}
+
+double benchmark_range_update_in_ms(uint8_t uni_bits, size_t num_keys, bool per_key, size_t test_runs)
+{
+    size_t t; vebkey_t key, low = 12345; VebTree* tree;
+    clock_t start, end; double elapsed = 0;
+
+    vebtree_init(&tree, uni_bits, VEBTREE_DEFAULT_FLAGS);
+
+    for (t = 0; t < test_runs; t++)
+    {
+        start = clock();
+        if (per_key) {
+            for (key = low; key < low + num_keys; key++) vebtree_insert_key(tree, key);
+            for (key = low; key < low + num_keys; key++) vebtree_delete_key(tree, key);
+        } else {
+            vebtree_insert_range(tree, low, low + num_keys - 1);
+            vebtree_delete_range(tree, low, low + num_keys - 1);
+        }
+        end = clock();
+        elapsed += ((double)end - start) / CLOCKS_PER_SEC;
+    }
+
+    vebtree_free(tree);
+    return elapsed / test_runs * 1000;
+}
+
+double benchmark_alloc_lowest_free_in_ns(uint8_t uni_bits, uint8_t flags, size_t num_taken, size_t num_allocs)
+{
+    size_t i; vebkey_t key; VebTree* tree;
+    clock_t start, end;
+
+    /* the lowest keys are taken, so each allocation needs to skip them */
+    vebtree_init(&tree, uni_bits, flags);
+    vebtree_insert_range(tree, 0, num_taken - 1);
+
+    start = clock();
+    for (i = 0; i < num_allocs; i++) {
+        key = vebtree_alloc_lowest_free(tree);
+        vebtree_delete_key(tree, key);
+    }
+    end = clock();
+
+    vebtree_free(tree);
+    return ((double)end - start) / CLOCKS_PER_SEC / num_allocs * 1e9;
+}
+
 int main(int argc, char** argv)
 {
     size_t num_keys = 500000, test_runs = 100;
 
+    printf("Veb tree node takes %zu bytes, a fully allocated tree (u=24 / u=28) takes %lf / %lf MiB\n",
+           sizeof(VebTree), fully_allocated_size_in_mib(24, VEBTREE_DEFAULT_FLAGS),
+           fully_allocated_size_in_mib(28, VEBTREE_DEFAULT_FLAGS));
+    printf("Storing the leaf clusters as leaf nodes instead would take %lf / %lf MiB\n",
+           (double)(sizeof(VebTree) + node_locals_arena_size(24, VEBTREE_DEFAULT_FLAGS, true)) / (1 << 20),
+           (double)(sizeof(VebTree) + node_locals_arena_size(28, VEBTREE_DEFAULT_FLAGS, true)) / (1 << 20));
+
+    printf("Veb init + free (u=24) took %lf milliseconds\n",
+           benchmark_init_free_in_ms(24, VEBTREE_DEFAULT_FLAGS, 10));
+
+    printf("Veb arena init + free (u=24) took %lf milliseconds\n",
+           benchmark_init_free_in_ms(24, VEBTREE_FLAG_ARENA, 10));
+
     printf("Veb sorting took %lf milliseconds\n",
            benchmark_sort_algo_in_ms(&sort_veb_succ, num_keys, test_runs));
 
+    printf("Veb arena sorting took %lf milliseconds\n",
+           benchmark_sort_algo_in_ms(&sort_veb_succ_arena, num_keys, test_runs));
+
+    printf("Veb bulk insert sorting took %lf milliseconds\n",
+           benchmark_sort_algo_in_ms(&sort_veb_bulk_succ, num_keys, test_runs));
+
+    printf("Veb cursor sorting took %lf milliseconds\n",
+           benchmark_sort_algo_in_ms(&sort_veb_cursor, num_keys, test_runs));
+
+    printf("Veb bulk insert + export sorting took %lf milliseconds\n",
+           benchmark_sort_algo_in_ms(&sort_veb_bulk_export, num_keys, test_runs));
+
+    printf("Veb library sorting took %lf milliseconds\n",
+           benchmark_sort_algo_in_ms(&sort_veb_library, num_keys, test_runs));
+
     printf("Quicksort took %lf milliseconds\n",
            benchmark_sort_algo_in_ms(&quick_sort, num_keys, test_runs));
 
+    printf("Veb library sorting clustered 64-bit IDs took %lf milliseconds\n",
+           benchmark_sort_ids_in_ms(&sort_veb_library, num_keys, true, test_runs / 10));
+
+    printf("Quicksort sorting clustered 64-bit IDs took %lf milliseconds\n",
+           benchmark_sort_ids_in_ms(&quick_sort, num_keys, true, test_runs / 10));
+
+    printf("Veb library sorting random 64-bit IDs took %lf milliseconds\n",
+           benchmark_sort_ids_in_ms(&sort_veb_library, num_keys, false, test_runs / 10));
+
+    printf("Quicksort sorting random 64-bit IDs took %lf milliseconds\n",
+           benchmark_sort_ids_in_ms(&quick_sort, num_keys, false, test_runs / 10));
+
+    printf("Veb multiset sorting keys with duplicates took %lf milliseconds\n",
+           benchmark_sort_duplicates_in_ms(&sort_veb_multiset, num_keys, test_runs / 10));
+
+    printf("Veb library sorting keys with duplicates took %lf milliseconds\n",
+           benchmark_sort_duplicates_in_ms(&sort_veb_library, num_keys, test_runs / 10));
+
+    printf("Quicksort sorting keys with duplicates took %lf milliseconds\n",
+           benchmark_sort_duplicates_in_ms(&quick_sort, num_keys, test_runs / 10));
+
+    printf("Veb intersection (u=24, 4M keys each) took %lf milliseconds\n",
+           benchmark_intersect_in_ms(24, (size_t)1 << 22, false, 10));
+
+    printf("Veb per-key intersection (u=24, 4M keys each) took %lf milliseconds\n",
+           benchmark_intersect_in_ms(24, (size_t)1 << 22, true, 10));
+
+    printf("Veb range insert + delete (u=24, 1M keys) took %lf milliseconds\n",
+           benchmark_range_update_in_ms(24, (size_t)1 << 20, false, 100));
+
+    printf("Veb per-key insert + delete (u=24, 1M keys) took %lf milliseconds\n",
+           benchmark_range_update_in_ms(24, (size_t)1 << 20, true, 10));
+
+    printf("Veb alloc lowest free + free (u=24, 1M keys taken) took %lf ns, with counts %lf ns\n",
+           benchmark_alloc_lowest_free_in_ns(24, VEBTREE_DEFAULT_FLAGS, (size_t)1 << 20, 1000),
+           benchmark_alloc_lowest_free_in_ns(24, VEBTREE_FLAG_COUNTS, (size_t)1 << 20, 100000));
+
+    printf("Veb contains (u=28, 1M keys) took %lf ns per key, batched %lf ns per key\n",
+           benchmark_lookups_in_ns(28, false, false), benchmark_lookups_in_ns(28, false, true));
+
+    printf("Veb successor (u=28, 1M keys) took %lf ns per key, batched %lf ns per key\n",
+           benchmark_lookups_in_ns(28, true, false), benchmark_lookups_in_ns(28, true, true));
+
     return 0;
 }
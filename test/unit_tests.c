@@ -1,15 +1,22 @@
+#include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include <assert.h>
 #include "vebtrees.h"
 
 void assert_empty_bitwise_leaf(VebTree* tree)
 {
+    size_t i;
     assert(vebtree_is_leaf(tree));
-    assert(tree->low == 0);
-    assert(tree->global == NULL);
+    assert(vebtree_is_empty(tree));
+    assert(tree->universe_bits <= VEBTREE_LEAF_BITS);
+    for (i = 0; i < VEBTREE_LEAF_WORDS; i++)
+        assert(tree->leaf[i] == 0);
+
+#if VEBTREE_LEAF_WORDS == 1
     assert(tree->locals == NULL);
-    assert(tree->universe_bits <= 6);
     assert(tree->high == vebtree_null);
+#endif
 }
 
 void should_create_fully_alloc_tree_u4096()
@@ -18,10 +25,50 @@ void should_create_fully_alloc_tree_u4096()
     vebtree_init(&tree, 12, 0);
 
     assert(vebtree_is_empty(tree));
-    assert_empty_bitwise_leaf(tree->global);
+    assert(tree->lower_bits == VEBTREE_LEAF_BITS);
+    assert(vebtree_has_leaf_locals(tree));
+    assert_empty_bitwise_leaf(vebtree_global(tree));
+
+    /* the locals of leaf parents are bare bitboards right behind the global,
+       followed by the (leaf) tree of full locals */
+    for (i = 0; i < ((size_t)1 << tree->upper_bits); i++)
+        assert(vebtree_bitwise_leaf_is_empty(vebtree_leaf_cluster(tree, i)));
+    assert_empty_bitwise_leaf(vebtree_full_locals(tree));
+    assert(vebtree_memory_usage(tree) == vebtree_root_bytes(tree) + 2 * sizeof(VebTree)
+        + ((size_t)1 << tree->upper_bits) * VEBTREE_LEAF_WORDS * sizeof(bitboard_t));
+
+    vebtree_free(tree);
+}
+
+void should_scan_bitwise_leaf_across_words()
+{
+    VebTree* tree; vebkey_t max_key;
+    vebtree_init(&tree, VEBTREE_LEAF_BITS, 0);
+    max_key = ((vebkey_t)1 << VEBTREE_LEAF_BITS) - 1;
+    assert(vebtree_is_leaf(tree));
+
+    assert(vebtree_bitwise_leaf_successor(tree->leaf, 0) == vebtree_null);
+    assert(vebtree_bitwise_leaf_predecessor(tree->leaf, max_key) == vebtree_null);
+
+    vebtree_insert_key(tree, 0);
+    vebtree_insert_key(tree, 62);
+    vebtree_insert_key(tree, max_key);
+
+    assert(vebtree_get_min(tree) == 0);
+    assert(vebtree_get_max(tree) == max_key);
+    assert(vebtree_bitwise_leaf_successor(tree->leaf, 0) == 62);
+    assert(vebtree_bitwise_leaf_successor(tree->leaf, 62) == max_key);
+    assert(vebtree_bitwise_leaf_successor(tree->leaf, max_key) == vebtree_null);
+    assert(vebtree_bitwise_leaf_predecessor(tree->leaf, max_key) == 62);
+    assert(vebtree_bitwise_leaf_predecessor(tree->leaf, 62) == 0);
+    assert(vebtree_bitwise_leaf_predecessor(tree->leaf, 0) == vebtree_null);
 
-    for (i = 0; i < 64; i++)
-        assert_empty_bitwise_leaf(&(tree->locals[i]));
+    vebtree_delete_key(tree, 0);
+    assert(vebtree_get_min(tree) == 62);
+    vebtree_delete_key(tree, max_key);
+    assert(vebtree_get_max(tree) == 62);
+    vebtree_delete_key(tree, 62);
+    assert(vebtree_is_empty(tree));
 
     vebtree_free(tree);
 }
@@ -79,10 +126,931 @@ void should_delete_from_fully_alloc_tree_u4096()
     vebtree_free(tree);
 }
 
+void should_insert_and_delete_in_arena_tree_u65536()
+{
+    size_t i; VebTree* tree;
+    vebtree_init(&tree, 16, VEBTREE_FLAG_ARENA);
+    assert(vebtree_is_empty(tree));
+    assert((uint8_t*)vebtree_global(tree) == (uint8_t*)tree + VEBTREE_ROOT_BYTES);
+
+    for (i = 0; i < 65536; i += 3)
+        vebtree_insert_key(tree, i);
+
+    for (i = 0; i < 65536; i++)
+        assert(vebtree_contains_key(tree, i) == (i % 3 == 0));
+    for (i = 0; i < 65533; i += 3)
+        assert(vebtree_successor(tree, i) == i + 3);
+
+    for (i = 0; i < 65536; i += 3)
+        vebtree_delete_key(tree, i);
+
+    assert(vebtree_is_empty(tree));
+    vebtree_free(tree);
+}
+
+void should_insert_and_delete_sparse_keys_in_lazy_tree_u32()
+{
+    size_t i; VebTree* tree; vebkey_t key;
+    vebtree_init(&tree, 32, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK);
+    assert(vebtree_is_empty(tree));
+    assert(tree->locals == NULL);
+
+    for (i = 0; i < 1000; i++) {
+        key = (vebkey_t)i * 4294967 + 7;
+        assert(!vebtree_contains_key(tree, key));
+        vebtree_insert_key(tree, key);
+        assert(vebtree_contains_key(tree, key));
+    }
+
+    assert(vebtree_get_min(tree) == 7);
+    assert(vebtree_get_max(tree) == (vebkey_t)999 * 4294967 + 7);
+    for (i = 0; i < 999; i++)
+        assert(vebtree_successor(tree, (vebkey_t)i * 4294967 + 7)
+            == (vebkey_t)(i + 1) * 4294967 + 7);
+    assert(vebtree_successor(tree, vebtree_get_max(tree)) == vebtree_null);
+
+    for (i = 0; i < 1000; i++) {
+        key = (vebkey_t)i * 4294967 + 7;
+        vebtree_delete_key(tree, key);
+        assert(!vebtree_contains_key(tree, key));
+    }
+
+    assert(vebtree_is_empty(tree));
+    assert(tree->locals == NULL);
+    vebtree_free(tree);
+}
+
+void should_insert_into_lazy_tree_u64()
+{
+    VebTree* tree;
+    vebtree_init(&tree, 64, VEBTREE_FLAG_LAZY);
+
+    vebtree_insert_key(tree, 0xFFFFFFFFFFFFFFFE);
+    vebtree_insert_key(tree, 0x8000000000000000);
+    vebtree_insert_key(tree, 42);
+    vebtree_insert_key(tree, 42);
+
+    assert(vebtree_contains_key(tree, 42));
+    assert(!vebtree_contains_key(tree, 43));
+    assert(vebtree_get_min(tree) == 42);
+    assert(vebtree_get_max(tree) == 0xFFFFFFFFFFFFFFFE);
+    assert(vebtree_successor(tree, 42) == 0x8000000000000000);
+    assert(vebtree_successor(tree, 0x8000000000000000) == 0xFFFFFFFFFFFFFFFE);
+
+    vebtree_delete_key(tree, 42);
+    assert(vebtree_get_min(tree) == 0x8000000000000000);
+    assert(!vebtree_contains_key(tree, 42));
+
+    vebtree_free(tree);
+}
+
+void assert_trees_equal(VebTree* tree, VebTree* exp_tree, vebkey_t max_key)
+{
+    vebkey_t key;
+    assert(vebtree_get_min(tree) == vebtree_get_min(exp_tree));
+    assert(vebtree_get_max(tree) == vebtree_get_max(exp_tree));
+    for (key = 0; key < max_key; key++) {
+        assert(vebtree_contains_key(tree, key) == vebtree_contains_key(exp_tree, key));
+        assert(vebtree_successor(tree, key) == vebtree_successor(exp_tree, key));
+    }
+}
+
+/* the locals marked as full need to be full, recursing into all nodes tracking their full locals */
+void assert_full_locals(VebTree* tree)
+{
+    size_t i, num_locals; vebkey_t global_key; VebTree* full;
+    if (vebtree_is_leaf(tree) || !vebtree_has_subtrees(tree) || !vebtree_tracks_full(tree->flags))
+        return;
+
+    full = vebtree_full_locals(tree);
+    for (global_key = vebtree_get_min(full); global_key != vebtree_null; global_key = vebtree_successor(full, global_key))
+        assert(_vebtree_cluster_is_full(tree, global_key) && "local marked as full has absent keys!");
+
+    assert_full_locals(vebtree_global(tree));
+    assert_full_locals(full);
+    if (vebtree_has_leaf_locals(tree)) return;
+    num_locals = vebtree_universe_maxvalue(tree->upper_bits);
+    for (i = 0; i < num_locals; i++) assert_full_locals(&(tree->locals[i]));
+}
+
+void should_bulk_insert_sorted_and_unsorted_keys()
+{
+    size_t i, num_keys = 3000; vebkey_t keys[3000];
+    VebTree *sorted_tree, *unsorted_tree, *exp_tree;
+    vebtree_init(&sorted_tree, 16, VEBTREE_DEFAULT_FLAGS);
+    vebtree_init(&unsorted_tree, 16, VEBTREE_FLAG_LAZY);
+    vebtree_init(&exp_tree, 16, VEBTREE_DEFAULT_FLAGS);
+
+    /* sorted keys with duplicates, the dense run at the front fills up whole clusters */
+    for (i = 0; i < num_keys; i++) {
+        keys[i] = (vebkey_t)(i < 600 ? i : i * i / 151);
+        vebtree_insert_key(exp_tree, keys[i]);
+    }
+
+    vebtree_insert_keys(sorted_tree, keys, num_keys);
+    assert_trees_equal(sorted_tree, exp_tree, 65535);
+    assert_full_locals(sorted_tree);
+
+    /* the same keys in reverse order */
+    for (i = 0; i < num_keys / 2; i++) {
+        keys[num_keys-1-i] ^= keys[i];
+        keys[i] ^= keys[num_keys-1-i];
+        keys[num_keys-1-i] ^= keys[i];
+    }
+
+    vebtree_insert_keys(unsorted_tree, keys, num_keys);
+    assert_trees_equal(unsorted_tree, exp_tree, 65535);
+    assert_full_locals(unsorted_tree);
+
+    for (i = 0; i < num_keys; i++) {
+        vebtree_delete_key(unsorted_tree, keys[i]);
+        assert(!vebtree_contains_key(unsorted_tree, keys[i]));
+    }
+    assert(vebtree_is_empty(unsorted_tree));
+
+    vebtree_free(sorted_tree);
+    vebtree_free(unsorted_tree);
+    vebtree_free(exp_tree);
+}
+
+void should_bulk_insert_sparse_keys_into_lazy_tree_u32()
+{
+    size_t i, num_keys = 3000; vebkey_t keys[3000], key, exp_key;
+    VebTree *sorted_tree, *unsorted_tree, *exp_tree;
+    vebtree_init(&sorted_tree, 32, VEBTREE_FLAG_LAZY);
+    vebtree_init(&unsorted_tree, 32, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK);
+    vebtree_init(&exp_tree, 32, VEBTREE_FLAG_LAZY);
+
+    /* pseudo-random keys with a few duplicates */
+    for (i = 0, key = 12345; i < num_keys; i++) {
+        key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+        keys[i] = i % 10 == 9 ? keys[i - 1] : key >> 32;
+        vebtree_insert_key(exp_tree, keys[i]);
+    }
+    vebtree_insert_keys(unsorted_tree, keys, num_keys);
+
+    /* sorted keys with duplicates of the smallest key */
+    for (i = 0, key = vebtree_get_min(exp_tree); i < num_keys; i++) {
+        keys[i] = key;
+        if (i > 2 && vebtree_successor(exp_tree, key) != vebtree_null)
+            key = vebtree_successor(exp_tree, key);
+    }
+    vebtree_insert_keys(sorted_tree, keys, num_keys);
+
+    exp_key = vebtree_get_min(exp_tree);
+    assert(vebtree_get_min(sorted_tree) == exp_key);
+    assert(vebtree_get_min(unsorted_tree) == exp_key);
+    while (exp_key != vebtree_null) {
+        assert(vebtree_contains_key(sorted_tree, exp_key));
+        assert(vebtree_contains_key(unsorted_tree, exp_key));
+        key = exp_key;
+        exp_key = vebtree_successor(exp_tree, key);
+        assert(vebtree_successor(sorted_tree, key) == exp_key);
+        assert(vebtree_successor(unsorted_tree, key) == exp_key);
+    }
+
+    vebtree_free(sorted_tree);
+    vebtree_free(unsorted_tree);
+    vebtree_free(exp_tree);
+}
+
+void should_find_predecessors_in_fully_alloc_and_lazy_trees()
+{
+    size_t i; vebkey_t key, exp_pred; VebTree *tree, *lazy_tree;
+    vebtree_init(&tree, 16, VEBTREE_DEFAULT_FLAGS);
+    vebtree_init(&lazy_tree, 16, VEBTREE_FLAG_LAZY);
+
+    assert(vebtree_predecessor(tree, 1000) == vebtree_null);
+    assert(vebtree_predecessor(lazy_tree, 1000) == vebtree_null);
+
+    for (i = 0, key = 7; i < 2000; i++) {
+        key = (key * 1103515245 + 12345) % 65536;
+        vebtree_insert_key(tree, key);
+        vebtree_insert_key(lazy_tree, key);
+    }
+
+    for (key = 0, exp_pred = vebtree_null; key < 65536; key++) {
+        assert(vebtree_predecessor(tree, key) == exp_pred);
+        assert(vebtree_predecessor(lazy_tree, key) == exp_pred);
+        if (vebtree_contains_key(tree, key)) exp_pred = key;
+    }
+
+    vebtree_free(tree);
+    vebtree_free(lazy_tree);
+}
+
+void should_scan_tree_with_cursor()
+{
+    size_t i, num_keys; vebkey_t key, keys[2000]; VebTree* tree; VebCursor cursor;
+    vebtree_init(&tree, 20, VEBTREE_FLAG_LAZY);
+
+    key = vebtree_cursor_seek(&cursor, tree, 0);
+    assert(key == vebtree_null);
+    assert(vebtree_cursor_end(&cursor));
+
+    for (i = 0, key = 3; i < 2000; i++) {
+        key = (key * 1103515245 + 12345) % 1048576;
+        vebtree_insert_key(tree, key);
+    }
+
+    /* scan forward from the smallest key */
+    num_keys = vebtree_to_array(tree, keys, 2000);
+    for (i = 0, key = vebtree_cursor_seek(&cursor, tree, 0); i < num_keys; i++) {
+        assert(key == keys[i]);
+        assert(key == (i == 0 ? vebtree_get_min(tree) : vebtree_successor(tree, keys[i-1])));
+        key = vebtree_cursor_next(&cursor);
+    }
+    assert(key == vebtree_null && vebtree_cursor_end(&cursor));
+
+    /* scan backward from the greatest key */
+    for (i = num_keys, key = vebtree_cursor_seek_last(&cursor, tree); i > 0; i--) {
+        assert(key == keys[i-1]);
+        key = vebtree_cursor_prev(&cursor);
+    }
+    assert(key == vebtree_null && vebtree_cursor_end(&cursor));
+
+    /* seek to keys in between, then step around */
+    for (i = 1; i < num_keys; i++) {
+        key = vebtree_cursor_seek(&cursor, tree, keys[i-1] + 1);
+        assert(key == keys[i]);
+        key = vebtree_cursor_prev(&cursor);
+        assert(key == keys[i-1]);
+        key = vebtree_cursor_next(&cursor);
+        assert(key == keys[i]);
+        key = vebtree_cursor_seek(&cursor, tree, keys[i]);
+        assert(key == keys[i]);
+    }
+    key = vebtree_cursor_seek(&cursor, tree, keys[num_keys-1] + 1);
+    assert(key == vebtree_null);
+
+    num_keys = vebtree_to_array(tree, keys, 10);
+    assert(num_keys == 10);
+    assert(keys[0] == vebtree_get_min(tree));
+    vebtree_free(tree);
+}
+
+void should_answer_floor_ceiling_and_range_queries()
+{
+    size_t i, num_keys; vebkey_t keys[16]; VebTree* tree;
+    vebtree_init(&tree, 32, VEBTREE_FLAG_LAZY);
+
+    assert(vebtree_floor(tree, 100) == vebtree_null);
+    assert(vebtree_ceiling(tree, 100) == vebtree_null);
+    num_keys = vebtree_range(tree, 0, 0xFFFFFFFF, keys, 16);
+    assert(num_keys == 0);
+
+    for (i = 1; i <= 10; i++)
+        vebtree_insert_key(tree, i * 100000);
+
+    assert(vebtree_floor(tree, 99999) == vebtree_null);
+    assert(vebtree_floor(tree, 100000) == 100000);
+    assert(vebtree_floor(tree, 250000) == 200000);
+    assert(vebtree_floor(tree, 0xFFFFFFFF) == 1000000);
+    assert(vebtree_ceiling(tree, 0) == 100000);
+    assert(vebtree_ceiling(tree, 300000) == 300000);
+    assert(vebtree_ceiling(tree, 300001) == 400000);
+    assert(vebtree_ceiling(tree, 1000001) == vebtree_null);
+
+    num_keys = vebtree_range(tree, 250000, 600000, keys, 16);
+    assert(num_keys == 4);
+    for (i = 0; i < 4; i++)
+        assert(keys[i] == (i + 3) * 100000);
+    num_keys = vebtree_range(tree, 0, 0xFFFFFFFF, keys, 3);
+    assert(num_keys == 3);
+    assert(keys[2] == 300000);
+    num_keys = vebtree_range(tree, 100001, 199999, keys, 16);
+    assert(num_keys == 0);
+    num_keys = vebtree_range(tree, 1000000, 1000000, keys, 16);
+    assert(num_keys == 1);
+
+    vebtree_free(tree);
+}
+
+void should_answer_batched_lookups()
+{
+    size_t c, i, num_queries = 3001; uint64_t state = 13; VebTree* tree;
+    vebkey_t *queries, *successors; bool* contained;
+    uint8_t uni_bits[6] = { VEBTREE_LEAF_BITS, 12, 20, 26, 32, 64 };
+    uint8_t flags[6] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS,
+        VEBTREE_FLAG_ARENA, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK, VEBTREE_FLAG_LAZY };
+
+    queries = (vebkey_t*)malloc(num_queries * sizeof(vebkey_t));
+    successors = (vebkey_t*)malloc(num_queries * sizeof(vebkey_t));
+    contained = (bool*)malloc(num_queries * sizeof(bool));
+
+    for (c = 0; c < 6; c++) {
+        vebtree_init(&tree, uni_bits[c], flags[c]);
+        vebtree_contains_keys(tree, queries, 0, contained);
+
+        /* every other query hits an inserted key, clustered keys for the 64-bit universe */
+        for (i = 0; i < num_queries; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            queries[i] = uni_bits[c] == 64 ? 0xABC0000000000000ULL | (state >> 40)
+                : (state >> 11) & (((vebkey_t)1 << uni_bits[c]) - 1);
+            if (i % 2 == 0) vebtree_insert_key(tree, queries[i]);
+        }
+
+        vebtree_contains_keys(tree, queries, num_queries, contained);
+        vebtree_successors(tree, queries, num_queries, successors);
+        for (i = 0; i < num_queries; i++) {
+            assert(contained[i] == vebtree_contains_key(tree, queries[i]));
+            assert(successors[i] == vebtree_successor(tree, queries[i]));
+        }
+
+        vebtree_free(tree);
+    }
+
+    free(queries); free(successors); free(contained);
+}
+
+int compare_keys(const void* a, const void* b)
+{
+    vebkey_t key_a = *(const vebkey_t*)a, key_b = *(const vebkey_t*)b;
+    return key_a < key_b ? -1 : (key_a > key_b ? 1 : 0);
+}
+
+void should_sort_arbitrary_keys_with_duplicates()
+{
+    size_t i, d, num_keys = 100000, num_unique, num_sorted; uint64_t state = 7;
+    vebkey_t *keys, *expected, *actual;
+
+    keys = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    expected = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    actual = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+
+    /* dense IDs far off zero, sparse 64-bit keys, heavy duplicates, equal keys, few keys */
+    for (d = 0; d < 5; d++) {
+        size_t n = d == 4 ? 20 : num_keys;
+        for (i = 0; i < n; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            keys[i] = d == 0 ? 1000000000000ULL + (state >> 40)
+                : d == 1 ? state
+                : d == 2 ? 0xFFFFFFFFFFFFFF00ULL + (state >> 57)
+                : d == 3 ? 42 : (state >> 60);
+        }
+        if (d == 1) { keys[0] = 0; keys[1] = 0xFFFFFFFFFFFFFFFF; keys[2] = keys[3]; }
+
+        for (i = 0; i < n; i++)
+            expected[i] = keys[i];
+        qsort(expected, n, sizeof(vebkey_t), compare_keys);
+
+        num_sorted = vebtree_sort(keys, n, actual, VEBTREE_SORT_DEFAULT);
+        assert(num_sorted == n);
+        for (i = 0; i < n; i++)
+            assert(actual[i] == expected[i]);
+
+        for (i = 1, num_unique = 1; i < n; i++)
+            if (expected[i] != expected[num_unique - 1])
+                expected[num_unique++] = expected[i];
+
+        num_sorted = vebtree_sort(keys, n, actual, VEBTREE_SORT_UNIQUE);
+        assert(num_sorted == num_unique);
+        for (i = 0; i < num_unique; i++)
+            assert(actual[i] == expected[i]);
+    }
+
+    num_sorted = vebtree_sort(keys, 0, actual, VEBTREE_SORT_DEFAULT);
+    assert(num_sorted == 0);
+    free(keys); free(expected); free(actual);
+}
+
+/* check the result against the operation's predicate on the keys of both source trees */
+void assert_set_operation(VebTree* result, VebTree* tree_a, VebTree* tree_b, int operation)
+{
+    size_t t; vebkey_t key, prev_key = vebtree_null; VebTree* sources[2]; bool in_a, in_b, expected;
+    sources[0] = tree_a; sources[1] = tree_b;
+
+    for (key = vebtree_get_min(result); key != vebtree_null; key = vebtree_successor(result, key)) {
+        in_a = vebtree_contains_key(tree_a, key);
+        in_b = vebtree_contains_key(tree_b, key);
+        assert(operation == 0 ? in_a || in_b : operation == 1 ? in_a && in_b : in_a && !in_b);
+        assert(vebtree_predecessor(result, key) == prev_key);
+        prev_key = key;
+    }
+    assert(vebtree_get_max(result) == prev_key);
+    assert_full_locals(result);
+
+    for (t = 0; t < 2; t++) {
+        for (key = vebtree_get_min(sources[t]); key != vebtree_null; key = vebtree_successor(sources[t], key)) {
+            in_a = vebtree_contains_key(tree_a, key);
+            in_b = vebtree_contains_key(tree_b, key);
+            expected = operation == 0 ? in_a || in_b : operation == 1 ? in_a && in_b : in_a && !in_b;
+            assert(vebtree_contains_key(result, key) == expected);
+        }
+    }
+}
+
+void should_combine_trees_with_set_operations()
+{
+    size_t c, i, op; uint64_t state = 11; vebkey_t key; VebTree *tree_a, *tree_b, *result;
+    uint8_t uni_bits[5] = { VEBTREE_LEAF_BITS, 16, 20, 32, 24 };
+    uint8_t flags_a[5] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_ARENA,
+        VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK, VEBTREE_DEFAULT_FLAGS };
+    uint8_t flags_b[5] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS,
+        VEBTREE_FLAG_LAZY, VEBTREE_FLAG_LAZY };
+
+    /* overlapping keys with some clusters being exclusive to one of the trees,
+       the last config combines differently split trees (full vs. lazy) */
+    for (c = 0; c < 5; c++) {
+        vebtree_init(&tree_a, uni_bits[c], flags_a[c]);
+        vebtree_init(&tree_b, uni_bits[c], flags_b[c]);
+
+        for (i = 0; i < (uni_bits[c] <= 16 ? 20 : 3000); i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            key = (state >> 11) & (((vebkey_t)1 << uni_bits[c]) - 1);
+            if (i % 3 != 1) vebtree_insert_key(tree_a, key & ~(vebkey_t)0xFF);
+            if (i % 3 != 0) vebtree_insert_key(tree_b, key);
+            if (i % 5 == 0) vebtree_insert_key(tree_b, key & ~(vebkey_t)0xFF);
+        }
+
+        for (op = 0; op < 3; op++) {
+            if (op == 0) vebtree_init_union(&result, tree_a, tree_b);
+            else if (op == 1) vebtree_init_intersection(&result, tree_a, tree_b);
+            else vebtree_init_difference(&result, tree_a, tree_b);
+            assert_set_operation(result, tree_a, tree_b, op);
+
+            /* combining a tree with itself or an empty tree */
+            vebtree_union(result, result);
+            assert_set_operation(result, result, result, 1);
+            vebtree_free(result);
+        }
+
+        vebtree_init(&result, uni_bits[c], flags_a[c]);
+        vebtree_union(result, tree_a);
+        vebtree_difference(result, tree_a);
+        assert(vebtree_is_empty(result));
+        vebtree_union(result, tree_b);
+        vebtree_intersect(result, tree_a);
+        assert_set_operation(result, tree_b, tree_a, 1);
+        vebtree_intersect(result, tree_a);
+        assert_set_operation(result, tree_b, tree_a, 1);
+        vebtree_free(result);
+
+        vebtree_free(tree_a);
+        vebtree_free(tree_b);
+    }
+}
+
+/* compare the order statistics against the keys exported in ascending order */
+void assert_order_statistics(VebTree* tree, vebkey_t keys[], size_t capacity)
+{
+    size_t i, num_keys = vebtree_to_array(tree, keys, capacity);
+
+    assert(vebtree_size(tree) == num_keys);
+    assert(vebtree_select(tree, num_keys) == vebtree_null);
+    for (i = 0; i < num_keys; i++) {
+        assert(vebtree_select(tree, i) == keys[i]);
+        assert(vebtree_rank(tree, keys[i]) == i);
+        if (i + 1 == num_keys || keys[i] + 1 < keys[i + 1])
+            assert(vebtree_rank(tree, keys[i] + 1) == i + 1);
+    }
+}
+
+void should_rank_and_select_keys()
+{
+    size_t c, i; uint64_t state = 5; vebkey_t key, *keys, *bulk_keys; VebTree *tree, *other;
+    uint8_t uni_bits[5] = { VEBTREE_LEAF_BITS, 16, 20, 32, 64 };
+    uint8_t flags[5] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_ARENA,
+        VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK, VEBTREE_FLAG_LAZY };
+
+    keys = (vebkey_t*)malloc(20000 * sizeof(vebkey_t));
+    bulk_keys = (vebkey_t*)malloc(5000 * sizeof(vebkey_t));
+
+    for (c = 0; c < 5; c++) {
+        vebtree_init(&tree, uni_bits[c], flags[c] | VEBTREE_FLAG_COUNTS);
+        assert(vebtree_size(tree) == 0);
+        assert(vebtree_rank(tree, 42) == 0);
+        assert(vebtree_select(tree, 0) == vebtree_null);
+
+        /* random keys with duplicates, then delete every third one again */
+        for (i = 0; i < 5000; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            key = uni_bits[c] == 64 ? 0xABCD000000000000ULL | (state >> 40)
+                : (state >> 11) & (((vebkey_t)1 << uni_bits[c]) - 1);
+            vebtree_insert_key(tree, key & ~(vebkey_t)3);
+            vebtree_insert_key(tree, key & ~(vebkey_t)3);
+            bulk_keys[i] = key | 1;
+        }
+        assert_order_statistics(tree, keys, 20000);
+
+        for (i = 0; i < 5000; i += 3)
+            if (vebtree_contains_key(tree, bulk_keys[i] & ~(vebkey_t)3))
+                vebtree_delete_key(tree, bulk_keys[i] & ~(vebkey_t)3);
+        assert_order_statistics(tree, keys, 20000);
+
+        /* counts of bulk inserted trees and set operations */
+        vebtree_init(&other, uni_bits[c], flags[c] | VEBTREE_FLAG_COUNTS);
+        vebtree_insert_keys(other, bulk_keys, 5000);
+        assert_order_statistics(other, keys, 20000);
+
+        vebtree_union(other, tree);
+        assert_order_statistics(other, keys, 20000);
+        vebtree_difference(other, tree);
+        assert_order_statistics(other, keys, 20000);
+        vebtree_union(other, tree);
+        vebtree_intersect(other, tree);
+        assert_order_statistics(other, keys, 20000);
+
+        vebtree_free(other);
+        vebtree_free(tree);
+    }
+
+    free(keys); free(bulk_keys);
+}
+
+void should_report_memory_usage()
+{
+    size_t i, full_bytes, root_bytes; VebTree *tree, *arena, *lazy; FILE* file; char line[128];
+
+    /* arenas lay out the trees of full locals upfront, fully allocated trees once their locals fill up */
+    vebtree_init(&tree, 20, VEBTREE_DEFAULT_FLAGS);
+    vebtree_init(&arena, 20, VEBTREE_FLAG_ARENA);
+    full_bytes = vebtree_memory_usage(tree);
+    assert(full_bytes > ((size_t)1 << 20) / 8);
+    assert(vebtree_memory_usage(arena) > full_bytes);
+    vebtree_insert_range(tree, 0, ((vebkey_t)1 << 20) - 1);
+    assert(vebtree_memory_usage(arena) == vebtree_memory_usage(tree));
+
+    /* lazy trees grow with their keys and shrink back to their root */
+    vebtree_init(&lazy, 32, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK);
+    root_bytes = vebtree_memory_usage(lazy);
+    for (i = 0; i < 1000; i++) vebtree_insert_key(lazy, i * 997);
+    assert(vebtree_memory_usage(lazy) > root_bytes);
+    for (i = 0; i < 1000; i++) vebtree_delete_key(lazy, i * 997);
+    assert(vebtree_memory_usage(lazy) == root_bytes);
+
+    file = tmpfile();
+    assert(file != NULL && "temp file creation failed unexpectedly!");
+    vebtree_stats_dump(tree, file);
+    rewind(file);
+    assert(fgets(line, sizeof(line), file) != NULL && strcmp(line, "universe_bits 20\n") == 0);
+    fclose(file);
+
+#ifdef VEBTREE_STATS
+    /* the counters track calls on the root, including the allocations of lazy subtrees */
+    assert(vebtree_stats(tree)->allocated_bytes == vebtree_memory_usage(tree));
+    assert(vebtree_stats(arena)->allocations == 1);
+    assert(vebtree_stats(vebtree_global(tree)) == NULL);
+
+    for (i = 0; i < 1000; i++) vebtree_insert_key(lazy, i * 997);
+    assert(vebtree_stats(lazy)->allocated_bytes == vebtree_memory_usage(lazy));
+    for (i = 0; i < 1000; i++) assert(vebtree_successor(lazy, i * 997) == (i < 999 ? (i + 1) * 997 : vebtree_null));
+    assert(vebtree_stats(lazy)->calls[VEBTREE_OP_INSERT] == 2000);
+    assert(vebtree_stats(lazy)->calls[VEBTREE_OP_SUCCESSOR] == 1000);
+    assert(vebtree_stats(lazy)->leaf_hits[VEBTREE_OP_SUCCESSOR] > 0);
+
+    for (i = 0; i < 1000; i++) vebtree_delete_key(lazy, i * 997);
+    assert(vebtree_stats(lazy)->frees > 0);
+    assert(vebtree_stats(lazy)->allocated_bytes == vebtree_memory_usage(lazy));
+    assert(vebtree_stats(lazy)->peak_bytes > vebtree_stats(lazy)->allocated_bytes);
+
+    vebtree_stats_reset(lazy);
+    assert(vebtree_stats(lazy)->calls[VEBTREE_OP_DELETE] == 0);
+    assert(vebtree_stats(lazy)->allocated_bytes == vebtree_memory_usage(lazy));
+#endif
+
+    vebtree_free(tree); vebtree_free(arena); vebtree_free(lazy);
+}
+
+void should_insert_and_delete_keys_in_sparse_tree_u64()
+{
+    size_t i, num_keys = 20000, num_unique, num_output; uint64_t state = 21; vebkey_t *keys, *sorted, *output;
+    vebkey_t key; VebTree *tree, *other; VebCursor cursor; size_t root_bytes;
+
+    keys = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    sorted = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+    output = (vebkey_t*)malloc(num_keys * sizeof(vebkey_t));
+
+    /* raw 64-bit hashes mixed with clustered timestamps and the universe's bounds */
+    for (i = 0; i < num_keys; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        keys[i] = i % 2 == 0 ? state >> 1 : 0x5F0000000000ULL + (state >> 50);
+    }
+    keys[0] = 0; keys[1] = 0xFFFFFFFFFFFFFFFE;
+
+    for (i = 0; i < num_keys; i++) sorted[i] = keys[i];
+    qsort(sorted, num_keys, sizeof(vebkey_t), compare_keys);
+    for (i = 1, num_unique = 1; i < num_keys; i++)
+        if (sorted[i] != sorted[num_unique - 1])
+            sorted[num_unique++] = sorted[i];
+
+    vebtree_init(&tree, 64, VEBTREE_FLAG_SPARSE);
+    root_bytes = vebtree_memory_usage(tree);
+    vebtree_insert_keys(tree, keys, num_keys);
+
+    assert(vebtree_get_min(tree) == 0 && vebtree_get_max(tree) == 0xFFFFFFFFFFFFFFFE);
+    for (i = 0; i < num_unique; i++) {
+        assert(vebtree_contains_key(tree, sorted[i]));
+        assert(vebtree_successor(tree, sorted[i]) == (i + 1 < num_unique ? sorted[i + 1] : vebtree_null));
+        assert(vebtree_predecessor(tree, sorted[i]) == (i > 0 ? sorted[i - 1] : vebtree_null));
+        if (i + 1 < num_unique && sorted[i] + 1 < sorted[i + 1]) {
+            assert(!vebtree_contains_key(tree, sorted[i] + 1));
+            assert(vebtree_successor(tree, sorted[i] + 1) == sorted[i + 1]);
+        }
+    }
+
+    /* the memory grows with the keys, not with the 64-bit universe */
+    assert(vebtree_memory_usage(tree) < num_unique * 512);
+    num_output = vebtree_to_array(tree, output, num_keys);
+    assert(num_output == num_unique);
+    for (i = 0; i < num_unique; i++) assert(output[i] == sorted[i]);
+    key = vebtree_cursor_seek(&cursor, tree, sorted[100] + 1);
+    assert(key == sorted[101]);
+    key = vebtree_cursor_prev(&cursor);
+    assert(key == sorted[100]);
+
+    /* sparse trees are combined with other trees key by key */
+    vebtree_init(&other, 64, VEBTREE_FLAG_LAZY);
+    vebtree_insert_key(other, sorted[5]);
+    vebtree_insert_key(other, 0x1234);
+    vebtree_intersect(other, tree);
+    assert(vebtree_get_min(other) == sorted[5] && vebtree_get_max(other) == sorted[5]);
+    vebtree_free(other);
+
+    for (i = 0; i < num_unique; i += 2) vebtree_delete_key(tree, sorted[i]);
+    for (i = 0; i < num_unique; i++) {
+        assert(vebtree_contains_key(tree, sorted[i]) == (i % 2 == 1));
+        if (i % 2 == 1)
+            assert(vebtree_successor(tree, sorted[i]) == (i + 2 < num_unique ? sorted[i + 2] : vebtree_null));
+    }
+
+#ifdef VEBTREE_STATS
+    assert(vebtree_stats(tree)->allocated_bytes == vebtree_memory_usage(tree));
+#endif
+
+    /* all clusters are released again once they ran empty */
+    for (i = 1; i < num_unique; i += 2) vebtree_delete_key(tree, sorted[i]);
+    assert(vebtree_is_empty(tree));
+    assert(vebtree_memory_usage(tree) == root_bytes);
+
+    vebtree_free(tree);
+    free(keys); free(sorted); free(output);
+}
+
+void assert_same_keys(VebTree* tree, VebTree* exp_tree)
+{
+    vebkey_t key, exp_key;
+    for (key = vebtree_get_min(tree), exp_key = vebtree_get_min(exp_tree); exp_key != vebtree_null;
+            key = vebtree_successor(tree, key), exp_key = vebtree_successor(exp_tree, exp_key))
+        assert(key == exp_key);
+    assert(key == vebtree_null);
+}
+
+void should_keep_snapshots_consistent_while_modifying()
+{
+    size_t i, t; uint64_t state = 33; vebkey_t key, mask; VebTree *tree, *snapshot, *snapshot2, *exp_tree, *exp_tree2;
+    uint8_t uni_bits[4] = { 20, 32, 64, 6 };
+    uint8_t flags[4] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK,
+        VEBTREE_FLAG_SPARSE, VEBTREE_DEFAULT_FLAGS };
+
+    for (t = 0; t < 4; t++) {
+        mask = uni_bits[t] == 64 ? 0xFFFFFFFFFFFFFFFEULL : ((vebkey_t)1 << uni_bits[t]) - 1;
+        vebtree_init(&tree, uni_bits[t], flags[t] | VEBTREE_FLAG_COW);
+        vebtree_init(&exp_tree, uni_bits[t], flags[t]);
+
+        for (i = 0; i < 5000; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            vebtree_insert_key(tree, (state >> 7) & mask);
+            vebtree_insert_key(exp_tree, (state >> 7) & mask);
+        }
+
+        /* the snapshot keeps the keys at the time of the snapshot */
+        snapshot = vebtree_snapshot(tree);
+        vebtree_init_union(&exp_tree2, exp_tree, exp_tree);
+        for (i = 0; i < 5000; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            key = (state >> 7) & mask;
+            if (i % 2 == 0) { vebtree_insert_key(tree, key); vebtree_insert_key(exp_tree, key); }
+            key = vebtree_successor(exp_tree, key) != vebtree_null ? vebtree_successor(exp_tree, key) : key;
+            if (i % 3 == 0 && vebtree_contains_key(exp_tree, key)) {
+                vebtree_delete_key(tree, key);
+                vebtree_delete_key(exp_tree, key);
+            }
+        }
+
+        assert_same_keys(snapshot, exp_tree2);
+        assert_same_keys(tree, exp_tree);
+        assert_full_locals(snapshot);
+        assert_full_locals(tree);
+
+        /* snapshots can be freed in any order, the other trees keep their keys */
+        snapshot2 = vebtree_snapshot(tree);
+        vebtree_free(snapshot);
+        vebtree_insert_key(tree, 1);
+        vebtree_delete_key(snapshot2, vebtree_get_max(snapshot2));
+        assert(vebtree_get_max(snapshot2) != vebtree_get_max(tree));
+        vebtree_free(snapshot2);
+
+        vebtree_insert_key(exp_tree, 1);
+        assert_same_keys(tree, exp_tree);
+        vebtree_free(tree); vebtree_free(exp_tree); vebtree_free(exp_tree2);
+    }
+}
+
+void should_copy_only_the_modified_path_of_snapshots()
+{
+    size_t full_bytes; VebTree *tree, *snapshot;
+
+    vebtree_init(&tree, 20, VEBTREE_FLAG_COW);
+    full_bytes = vebtree_memory_usage(tree);
+    snapshot = vebtree_snapshot(tree);
+
+    vebtree_insert_key(tree, 42);
+    vebtree_insert_key(tree, 4242);
+    assert(vebtree_contains_key(tree, 4242) && !vebtree_contains_key(snapshot, 4242));
+
+#ifdef VEBTREE_STATS
+    /* both keys copied the blocks along their paths, not the whole tree (the root's
+       block makes up ~10% of the tree as the leaf clusters are bare bitboards) */
+    assert(vebtree_stats(tree)->allocated_bytes - full_bytes < full_bytes / 8);
+#endif
+
+    vebtree_free(snapshot);
+    assert(vebtree_memory_usage(tree) == full_bytes);
+    vebtree_free(tree);
+}
+
+void should_insert_and_delete_key_ranges()
+{
+    size_t i, t; uint64_t state = 77; vebkey_t key, low, high, mask;
+    VebTree *tree, *exp_tree, *snapshot, *exp_snapshot; size_t root_bytes;
+    uint8_t uni_bits[6] = { 20, 32, 20, 64, 24, 6 };
+    uint8_t flags[6] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK, VEBTREE_FLAG_COUNTS,
+        VEBTREE_FLAG_SPARSE, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK | VEBTREE_FLAG_COW, VEBTREE_DEFAULT_FLAGS };
+
+    for (t = 0; t < 6; t++) {
+        mask = uni_bits[t] == 64 ? 0xFFFFFFFFFFFFFFFEULL : ((vebkey_t)1 << uni_bits[t]) - 1;
+        vebtree_init(&tree, uni_bits[t], flags[t]);
+        vebtree_init(&exp_tree, uni_bits[t], flags[t] & ~VEBTREE_FLAG_COW);
+        root_bytes = vebtree_memory_usage(tree);
+        snapshot = NULL;
+
+        for (i = 0; i < 400; i++) {
+            /* the snapshot keeps the keys at the time of the snapshot */
+            if (i == 200 && vebtree_is_cow(tree)) {
+                snapshot = vebtree_snapshot(tree);
+                vebtree_init_union(&exp_snapshot, exp_tree, exp_tree);
+            }
+
+            /* mostly short ranges within a few leafs, sometimes ranges spanning many clusters */
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            low = (state >> 7) & mask;
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            high = low + (state >> 40) % (i % 10 == 0 ? 20000 : 300);
+            high = high > mask || high < low ? mask : high;
+
+            if (i % 3 != 2) {
+                vebtree_insert_range(tree, low, high);
+                for (key = low; key <= high; key++) vebtree_insert_key(exp_tree, key);
+            } else {
+                vebtree_delete_range(tree, low, high);
+                for (key = low; key <= high; key++)
+                    if (vebtree_contains_key(exp_tree, key)) vebtree_delete_key(exp_tree, key);
+            }
+            assert(vebtree_get_min(tree) == vebtree_get_min(exp_tree) && "unexpected low after range update!");
+            assert(vebtree_get_max(tree) == vebtree_get_max(exp_tree) && "unexpected high after range update!");
+        }
+
+        assert_same_keys(tree, exp_tree);
+        assert_full_locals(tree);
+        if (vebtree_is_counting(tree)) {
+            assert(vebtree_size(tree) == vebtree_size(exp_tree) && "unexpected size after range updates!");
+            for (key = 0; key <= mask; key += 997)
+                assert(vebtree_rank(tree, key) == vebtree_rank(exp_tree, key) && "unexpected rank after range updates!");
+        }
+
+        if (snapshot != NULL) {
+            assert_same_keys(snapshot, exp_snapshot);
+            assert_full_locals(snapshot);
+            vebtree_free(snapshot); vebtree_free(exp_snapshot);
+        }
+
+        /* deleting the whole universe empties the tree, shrinking trees release their subtrees */
+        vebtree_delete_range(tree, 0, mask);
+        assert(vebtree_is_empty(tree) && "tree should be empty after deleting all keys!");
+        if (flags[t] & VEBTREE_FLAG_SHRINK)
+            assert(vebtree_memory_usage(tree) == root_bytes && "empty shrinking tree still holds subtrees!");
+
+        vebtree_free(tree); vebtree_free(exp_tree);
+    }
+}
+
+vebkey_t expected_next_absent(VebTree* tree, vebkey_t key, vebkey_t max_key)
+{
+    while (vebtree_contains_key(tree, key)) if (key++ == max_key) return vebtree_null;
+    return key;
+}
+
+vebkey_t expected_prev_absent(VebTree* tree, vebkey_t key)
+{
+    while (vebtree_contains_key(tree, key)) if (key-- == 0) return vebtree_null;
+    return key;
+}
+
+void should_find_absent_keys_and_alloc_lowest_free()
+{
+    size_t i, t; uint64_t state = 55; vebkey_t key, low, high, max_key, exp_key, first_free, snapshot_free;
+    vebkey_t next_absent, prev_absent, allocated; VebTree *tree, *snapshot;
+    uint8_t uni_bits[9] = { 20, 20, 32, 64, 24, 6, 4, 20, 32 };
+    uint8_t flags[9] = { VEBTREE_DEFAULT_FLAGS, VEBTREE_FLAG_COUNTS, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_COUNTS,
+        VEBTREE_FLAG_SPARSE, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_COW, VEBTREE_DEFAULT_FLAGS, VEBTREE_DEFAULT_FLAGS,
+        VEBTREE_FLAG_ARENA, VEBTREE_FLAG_LAZY | VEBTREE_FLAG_SHRINK };
+
+    for (t = 0; t < 9; t++) {
+        max_key = uni_bits[t] == 64 ? 0xFFFFFFFFFFFFFFFEULL : ((vebkey_t)1 << uni_bits[t]) - 1;
+        vebtree_init(&tree, uni_bits[t], flags[t]);
+        next_absent = vebtree_next_absent(tree, 0);
+        prev_absent = vebtree_prev_absent(tree, max_key);
+        assert(next_absent == 0 && prev_absent == max_key);
+
+        /* taken runs of keys with a few holes, starting at 0 like an ID allocator */
+        vebtree_insert_range(tree, 0, max_key > 100000 ? 100000 : max_key / 2);
+        for (i = 0; i < 200; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            low = (state >> 7) & (max_key > 0x3FFFF ? 0x3FFFF : max_key);
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            high = low + (state >> 40) % 5000;
+            high = high > max_key ? max_key : high;
+            if (i % 4 == 3) vebtree_delete_key(tree, low);
+            else vebtree_insert_range(tree, low, high);
+        }
+        assert_full_locals(tree);
+        snapshot = vebtree_is_cow(tree) ? vebtree_snapshot(tree) : NULL;
+        snapshot_free = snapshot != NULL ? vebtree_next_absent(snapshot, 0) : vebtree_null;
+
+        for (i = 0; i < 2000; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            key = (state >> 7) & (max_key > 0x7FFFF ? 0x7FFFF : max_key);
+            next_absent = vebtree_next_absent(tree, key);
+            assert(next_absent == expected_next_absent(tree, key, max_key) && "unexpected next absent key!");
+            prev_absent = vebtree_prev_absent(tree, key);
+            assert(prev_absent == expected_prev_absent(tree, key) && "unexpected previous absent key!");
+        }
+
+        /* each allocation takes the lowest free key, freed keys are taken again first */
+        for (i = 0, first_free = 0; i < 3000; i++) {
+            exp_key = expected_next_absent(tree, first_free, max_key);
+            allocated = vebtree_alloc_lowest_free(tree);
+            assert(allocated == exp_key && "unexpected allocated key!");
+            if (exp_key == vebtree_null) break;
+            assert(vebtree_contains_key(tree, exp_key) && "allocated key should be part of the tree!");
+            first_free = exp_key;
+            if (i % 5 == 4 && vebtree_contains_key(tree, exp_key / 2)) {
+                vebtree_delete_key(tree, exp_key / 2);
+                first_free = exp_key / 2;
+            }
+        }
+
+        assert_full_locals(tree);
+
+        /* the snapshot keeps its keys while allocating from the tree */
+        if (snapshot != NULL) {
+            next_absent = vebtree_next_absent(snapshot, 0);
+            assert(next_absent == snapshot_free && "snapshot was modified by allocations!");
+        }
+        if (vebtree_is_counting(tree)) {
+            next_absent = vebtree_next_absent(tree, 0);
+            assert(vebtree_rank(tree, next_absent) == next_absent);
+        }
+
+        /* full universes don't have any absent keys */
+        if (uni_bits[t] <= 6) {
+            vebtree_insert_range(tree, 0, max_key);
+            next_absent = vebtree_next_absent(tree, 0);
+            prev_absent = vebtree_prev_absent(tree, max_key);
+            assert(next_absent == vebtree_null && prev_absent == vebtree_null);
+            allocated = vebtree_alloc_lowest_free(tree);
+            assert(allocated == vebtree_null);
+        }
+
+        if (snapshot != NULL) vebtree_free(snapshot);
+        vebtree_free(tree);
+    }
+}
+
 int main(int argc, char** argv)
 {
     should_create_fully_alloc_tree_u4096();
+    should_scan_bitwise_leaf_across_words();
     should_insert_into_fully_alloc_tree_u4096();
     should_delete_from_fully_alloc_tree_u4096();
+    should_insert_and_delete_in_arena_tree_u65536();
+    should_insert_and_delete_sparse_keys_in_lazy_tree_u32();
+    should_insert_into_lazy_tree_u64();
+    should_bulk_insert_sorted_and_unsorted_keys();
+    should_bulk_insert_sparse_keys_into_lazy_tree_u32();
+    should_find_predecessors_in_fully_alloc_and_lazy_trees();
+    should_scan_tree_with_cursor();
+    should_answer_floor_ceiling_and_range_queries();
+    should_answer_batched_lookups();
+    should_sort_arbitrary_keys_with_duplicates();
+    should_combine_trees_with_set_operations();
+    should_rank_and_select_keys();
+    should_report_memory_usage();
+    should_insert_and_delete_keys_in_sparse_tree_u64();
+    should_keep_snapshots_consistent_while_modifying();
+    should_copy_only_the_modified_path_of_snapshots();
+    should_insert_and_delete_key_ranges();
+    should_find_absent_keys_and_alloc_lowest_free();
     return 0;
 }